@@ -0,0 +1,83 @@
+// *****************************************************************************
+    // include project headers
+    #include "AlignedBuffer.hpp"
+    
+    // include OS headers for aligned allocation
+    #if defined(__WIN32__) || defined(_WIN32) || defined(_WIN64)
+      #define ALIGNED_BUFFER_WINDOWS
+      #include <malloc.h>       // [ Windows ] Memory allocation
+    #else
+      #include <stdlib.h>       // [ POSIX ] Memory allocation
+    #endif
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      ALIGNED BUFFER: INSTANCE HANDLING
+// =============================================================================
+
+
+AlignedBuffer::AlignedBuffer()
+{
+    Data = nullptr;
+    Size = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+AlignedBuffer::~AlignedBuffer()
+{
+    Release();
+}
+
+
+// =============================================================================
+//      ALIGNED BUFFER: MEMORY HANDLING
+// =============================================================================
+
+
+bool AlignedBuffer::Allocate( size_t Bytes, size_t Alignment )
+{
+    Release();
+    
+    // an empty buffer needs no memory
+    if( Bytes == 0 )
+      return true;
+      
+    // alignment must be at least that of a pointer
+    if( Alignment < sizeof( void* ) )
+      Alignment = sizeof( void* );
+      
+    #if defined(ALIGNED_BUFFER_WINDOWS)
+      Data = _aligned_malloc( Bytes, Alignment );
+    #else
+      if( posix_memalign( &Data, Alignment, Bytes ) != 0 )
+        Data = nullptr;
+    #endif
+    
+    if( !Data )
+      return false;
+      
+    Size = Bytes;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void AlignedBuffer::Release()
+{
+    if( Data )
+    {
+        #if defined(ALIGNED_BUFFER_WINDOWS)
+          _aligned_free( Data );
+        #else
+          free( Data );
+        #endif
+    }
+    
+    Data = nullptr;
+    Size = 0;
+}
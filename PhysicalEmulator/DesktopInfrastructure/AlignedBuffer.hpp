@@ -0,0 +1,44 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef ALIGNEDBUFFER_HPP
+    #define ALIGNEDBUFFER_HPP
+    
+    // include C/C++ headers
+    #include <cstddef>          // [ ANSI C ] Standard definitions
+// *****************************************************************************
+
+
+// =============================================================================
+//      ALIGNED MEMORY BUFFER
+// =============================================================================
+
+
+// A single block of memory that starts at a multiple of
+// the requested alignment (which must be a power of 2).
+// Unlike a vector, its contents are not initialized and
+// it is never reallocated, so pointers into it stay valid
+// until it is released
+class AlignedBuffer
+{
+    public:
+    
+        // allocated memory
+        void* Data;
+        size_t Size;
+        
+    public:
+    
+        // instance handling
+        AlignedBuffer();
+       ~AlignedBuffer();
+       
+        // returns false if memory cannot be allocated
+        bool Allocate( size_t Bytes, size_t Alignment );
+        void Release();
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
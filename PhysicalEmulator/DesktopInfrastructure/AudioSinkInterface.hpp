@@ -0,0 +1,60 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef AUDIOSINKINTERFACE_HPP
+    #define AUDIOSINKINTERFACE_HPP
+    
+    // include infrastructure headers
+    #include "SoundBlockRing.hpp"
+// *****************************************************************************
+
+
+// =============================================================================
+//      COMMON INTERFACE FOR AUDIO SINKS
+// =============================================================================
+
+
+// An audio sink plays the sound generated by the emulator
+// on some output. Sound is taken from a ring of blocks, in
+// which the emulation thread is the only producer and the
+// sink the only consumer. All these methods are called from
+// the emulation thread; the sink may use the ring from its
+// own thread, but never while playback is stopped, so that
+// the ring can then be emptied and refilled
+class AudioSinkInterface
+{
+    public:
+    
+        // instance handling
+        virtual ~AudioSinkInterface() {}
+        
+        // handling the output device
+        virtual void Open( SoundBlockRing& SourceRing ) = 0;
+        virtual void Close() = 0;
+        virtual bool IsOpen() = 0;
+        
+        // playback control; resuming also ensures that
+        // sound is playing if it was stopped by some event
+        virtual void Start() = 0;
+        virtual void Stop() = 0;
+        virtual void Pause() = 0;
+        virtual void Resume() = 0;
+        
+        // called after each block written to the ring
+        virtual void NotifyBlockWritten() = 0;
+        
+        // number of blocks to write before starting
+        virtual unsigned GetStartingBlocks() = 0;
+        
+        // true if sound is played at the rate of a device,
+        // so the rate it is generated at has to follow it
+        virtual bool FollowsDeviceClock() = 0;
+        
+        // output volume, from 0 (silence) to 1
+        virtual void SetGain( float NewGain ) = 0;
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
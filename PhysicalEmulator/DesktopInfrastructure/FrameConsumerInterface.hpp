@@ -0,0 +1,47 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef FRAMECONSUMERINTERFACE_HPP
+    #define FRAMECONSUMERINTERFACE_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include C/C++ headers
+    #include <cstdint>      // [ ANSI C ] Standard integer types
+// *****************************************************************************
+
+
+// =============================================================================
+//      COMMON INTERFACE FOR FRAME CONSUMERS
+// =============================================================================
+
+
+// Anything that needs the emulator images once they are
+// drawn (screenshots, frame hashing, video capture...)
+// can receive them by implementing this interface. Frames
+// are delivered from a worker thread, a few frames after
+// they were drawn, so implementations must not use GL
+class FrameConsumerInterface
+{
+    public:
+    
+        // instance handling
+        virtual ~FrameConsumerInterface() {}
+        
+        // pixels are 640x360 and the first row is the
+        // screen top; they are only valid during the call.
+        // The same frame number can be received again if
+        // the emulator did not produce any new frames
+        virtual void ProcessFrame( const GPUColor* Pixels, uint64_t FrameNumber ) = 0;
+        
+        // consumers that cannot miss any frame make
+        // readback wait for them instead of dropping
+        // frames, even if this stalls the GL thread
+        virtual bool NeedsAllFrames() { return false; }
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
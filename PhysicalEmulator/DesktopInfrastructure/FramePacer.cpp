@@ -0,0 +1,169 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "FramePacer.hpp"
+    #include "LogStream.hpp"
+    
+    // include C/C++ headers
+    #include <cmath>            // [ ANSI C ] Mathematics
+    #include <algorithm>        // [ C++ STL ] Algorithms
+    
+    // include OS headers for sleeping
+    #if defined(__WIN32__) || defined(_WIN32) || defined(_WIN64)
+      #define FRAME_PACER_WINDOWS
+    #else
+      #include <time.h>         // [ POSIX ] Time functions
+      #include <errno.h>        // [ POSIX ] Error codes
+    #endif
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      FRAME PACER: INSTANCE HANDLING
+// =============================================================================
+
+
+FramePacer::FramePacer()
+{
+    CounterFrequency = SDL_GetPerformanceFrequency();
+    SpinMargin = PACER_MAX_SPIN_MARGIN;
+    
+    TargetFrameTime = 1.0 / 60;
+    LastFrameTimestamp = 0;
+    ResetStatistics();
+    
+    ReportEnabled = false;
+}
+
+// -----------------------------------------------------------------------------
+
+void FramePacer::ResetStatistics()
+{
+    MeasuredFrames = 0;
+    LateFrames = 0;
+    SumFrameTimes = 0;
+    SumSquaredFrameTimes = 0;
+    MaxFrameDeviation = 0;
+    TotalSleptTime = 0;
+    TotalSpunTime = 0;
+}
+
+
+// =============================================================================
+//      FRAME PACER: WAITING
+// =============================================================================
+
+
+void FramePacer::SleepFor( double Seconds )
+{
+    #if defined(FRAME_PACER_WINDOWS)
+    
+      // SDL already requests 1 ms timer resolution
+      SDL_Delay( (Uint32)(Seconds * 1000) );
+      
+    #elif defined(__linux__)
+    
+      // use an absolute deadline so that
+      // interruptions don't extend the wait
+      timespec Deadline;
+      clock_gettime( CLOCK_MONOTONIC, &Deadline );
+      
+      long long Nanoseconds = Deadline.tv_nsec + (long long)(Seconds * 1e9);
+      Deadline.tv_sec += Nanoseconds / 1000000000;
+      Deadline.tv_nsec = Nanoseconds % 1000000000;
+      
+      while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &Deadline, nullptr ) == EINTR ) {}
+      
+    #else
+    
+      timespec Remaining;
+      Remaining.tv_sec = (time_t)Seconds;
+      Remaining.tv_nsec = (long)((Seconds - Remaining.tv_sec) * 1e9);
+      
+      while( nanosleep( &Remaining, &Remaining ) == -1 && errno == EINTR ) {}
+      
+    #endif
+}
+
+// -----------------------------------------------------------------------------
+
+void FramePacer::WaitFor( double Seconds )
+{
+    Uint64 StartTimestamp = SDL_GetPerformanceCounter();
+    Uint64 Deadline = StartTimestamp + (Uint64)(Seconds * CounterFrequency);
+    
+    // PART 1: sleep for most of the time
+    double SleepTime = Seconds - SpinMargin;
+    
+    if( SleepTime > 0 )
+    {
+        SleepFor( SleepTime );
+        
+        // learn how much the OS oversleeps; the margin
+        // follows the worst cases and decays slowly
+        double SleptTime = double( SDL_GetPerformanceCounter() - StartTimestamp ) / CounterFrequency;
+        double Oversleep = SleptTime - SleepTime;
+        SpinMargin = max( SpinMargin * 0.99, Oversleep * 1.5 );
+        SpinMargin = min( max( SpinMargin, PACER_MIN_SPIN_MARGIN ), PACER_MAX_SPIN_MARGIN );
+        TotalSleptTime += SleptTime;
+    }
+    
+    // PART 2: spin until the deadline, but let
+    // other threads run while there is time
+    Uint64 SpinStart = SDL_GetPerformanceCounter();
+    Uint64 CurrentTimestamp = SpinStart;
+    Uint64 YieldLimit = (Uint64)(PACER_YIELD_LIMIT * CounterFrequency);
+    
+    while( CurrentTimestamp < Deadline )
+    {
+        if( Deadline - CurrentTimestamp > YieldLimit )
+          SDL_Delay( 0 );
+          
+        CurrentTimestamp = SDL_GetPerformanceCounter();
+    }
+    
+    TotalSpunTime += double( CurrentTimestamp - SpinStart ) / CounterFrequency;
+}
+
+
+// =============================================================================
+//      FRAME PACER: FRAME TIME STATISTICS
+// =============================================================================
+
+
+void FramePacer::RegisterFrame()
+{
+    Uint64 CurrentTimestamp = SDL_GetPerformanceCounter();
+    double FrameTime = double( CurrentTimestamp - LastFrameTimestamp ) / CounterFrequency;
+    LastFrameTimestamp = CurrentTimestamp;
+    
+    if( !ReportEnabled || FrameTime > PACER_MAX_FRAME_TIME )
+      return;
+      
+    MeasuredFrames++;
+    SumFrameTimes += FrameTime;
+    SumSquaredFrameTimes += FrameTime * FrameTime;
+    MaxFrameDeviation = max( MaxFrameDeviation, fabs( FrameTime - TargetFrameTime ) );
+    
+    if( FrameTime > 1.5 * TargetFrameTime )
+      LateFrames++;
+      
+    if( MeasuredFrames < PACER_REPORT_FRAMES )
+      return;
+      
+    double AverageTime = SumFrameTimes / MeasuredFrames;
+    double Variance = max( 0.0, SumSquaredFrameTimes / MeasuredFrames - AverageTime * AverageTime );
+    double WaitedTime = TotalSleptTime + TotalSpunTime;
+    double SpunPercentage = (WaitedTime > 0? 100.0 * TotalSpunTime / WaitedTime : 0);
+    
+    LOG( "Frame time: average " << (1000 * AverageTime) << " ms"
+         << ", jitter " << (1000 * sqrt( Variance )) << " ms"
+         << ", max deviation " << (1000 * MaxFrameDeviation) << " ms"
+         << ", late frames " << LateFrames
+         << ", spinning " << SpunPercentage << "% of wait time"
+         << " (margin " << (1000000 * SpinMargin) << " us)" );
+         
+    ResetStatistics();
+}
@@ -0,0 +1,87 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef FRAMEPACER_HPP
+    #define FRAMEPACER_HPP
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>           // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR FRAME PACING
+// =============================================================================
+
+
+// waits are slept until this margin before the deadline,
+// and the rest is spun; the margin adapts to the worst
+// oversleep seen recently, within these limits (seconds)
+#define PACER_MIN_SPIN_MARGIN  0.0002
+#define PACER_MAX_SPIN_MARGIN  0.0020
+
+// under this remaining time we spin without yielding
+#define PACER_YIELD_LIMIT      0.0001
+
+// frame time statistics are reported after this many
+// frames; longer intervals are pauses and are ignored
+#define PACER_REPORT_FRAMES    600
+#define PACER_MAX_FRAME_TIME   0.25
+
+
+// =============================================================================
+//      CLASS FOR FRAME PACING
+// =============================================================================
+
+
+// Waits for the next frame without keeping a core busy:
+// the thread sleeps until shortly before the deadline and
+// only spins for the last few hundred microseconds. It
+// also measures the jitter of the intervals between frames
+class FramePacer
+{
+    public:
+    
+        // timing
+        Uint64 CounterFrequency;
+        double SpinMargin;
+        
+        // measured frame intervals
+        double TargetFrameTime;
+        Uint64 LastFrameTimestamp;
+        unsigned MeasuredFrames;
+        unsigned LateFrames;
+        double SumFrameTimes;
+        double SumSquaredFrameTimes;
+        double MaxFrameDeviation;
+        
+        // measured waits
+        double TotalSleptTime;
+        double TotalSpunTime;
+        
+        // configuration
+        bool ReportEnabled;
+        
+    private:
+    
+        void SleepFor( double Seconds );
+        void ResetStatistics();
+        
+    public:
+    
+        // instance handling
+        FramePacer();
+        
+        // waits as precisely as possible
+        void WaitFor( double Seconds );
+        
+        // called once per shown frame; when enabled, it
+        // periodically logs a report of frame times
+        void RegisterFrame();
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -0,0 +1,137 @@
+// *****************************************************************************
+    // include project headers
+    #include "HashFunctions.hpp"
+    
+    // include C/C++ headers
+    #include <cstring>          // [ ANSI C ] Strings
+// *****************************************************************************
+
+
+// =============================================================================
+//      AUXILIARY FUNCTIONS FOR XXH64
+// =============================================================================
+
+
+const uint64_t XXH64Prime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t XXH64Prime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t XXH64Prime3 = 0x165667B19E3779F9ULL;
+const uint64_t XXH64Prime4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t XXH64Prime5 = 0x27D4EB2F165667C5ULL;
+
+// -----------------------------------------------------------------------------
+
+inline uint64_t RotateLeft( uint64_t Value, int Bits )
+{
+    return (Value << Bits) | (Value >> (64 - Bits));
+}
+
+// -----------------------------------------------------------------------------
+
+// reads are done with memcpy to allow any alignment
+// (values are read as little endian, like all hosts
+// supported by the emulator)
+inline uint64_t Read64( const uint8_t* Position )
+{
+    uint64_t Value;
+    memcpy( &Value, Position, 8 );
+    return Value;
+}
+
+// -----------------------------------------------------------------------------
+
+inline uint32_t Read32( const uint8_t* Position )
+{
+    uint32_t Value;
+    memcpy( &Value, Position, 4 );
+    return Value;
+}
+
+// -----------------------------------------------------------------------------
+
+inline uint64_t XXH64Round( uint64_t Accumulator, uint64_t Input )
+{
+    Accumulator += Input * XXH64Prime2;
+    Accumulator = RotateLeft( Accumulator, 31 );
+    return Accumulator * XXH64Prime1;
+}
+
+// -----------------------------------------------------------------------------
+
+inline uint64_t XXH64MergeRound( uint64_t Accumulator, uint64_t Value )
+{
+    Accumulator ^= XXH64Round( 0, Value );
+    return Accumulator * XXH64Prime1 + XXH64Prime4;
+}
+
+
+// =============================================================================
+//      HASH FUNCTIONS
+// =============================================================================
+
+
+// The 4 accumulators are independent from each other, so
+// the CPU can run their rounds in parallel. This is fast
+// enough to hash a full frame in a small fraction of a ms
+uint64_t HashXXH64( const void* Data, size_t Size, uint64_t Seed )
+{
+    const uint8_t* Position = (const uint8_t*)Data;
+    const uint8_t* End = Position + Size;
+    uint64_t Hash;
+    
+    if( Size >= 32 )
+    {
+        uint64_t Accumulator1 = Seed + XXH64Prime1 + XXH64Prime2;
+        uint64_t Accumulator2 = Seed + XXH64Prime2;
+        uint64_t Accumulator3 = Seed;
+        uint64_t Accumulator4 = Seed - XXH64Prime1;
+        
+        for( ; End - Position >= 32; Position += 32 )
+        {
+            Accumulator1 = XXH64Round( Accumulator1, Read64( Position ) );
+            Accumulator2 = XXH64Round( Accumulator2, Read64( Position + 8 ) );
+            Accumulator3 = XXH64Round( Accumulator3, Read64( Position + 16 ) );
+            Accumulator4 = XXH64Round( Accumulator4, Read64( Position + 24 ) );
+        }
+        
+        Hash = RotateLeft( Accumulator1, 1 ) + RotateLeft( Accumulator2, 7 )
+             + RotateLeft( Accumulator3, 12 ) + RotateLeft( Accumulator4, 18 );
+             
+        Hash = XXH64MergeRound( Hash, Accumulator1 );
+        Hash = XXH64MergeRound( Hash, Accumulator2 );
+        Hash = XXH64MergeRound( Hash, Accumulator3 );
+        Hash = XXH64MergeRound( Hash, Accumulator4 );
+    }
+    
+    else
+      Hash = Seed + XXH64Prime5;
+      
+    Hash += (uint64_t)Size;
+    
+    // process the remaining bytes
+    for( ; End - Position >= 8; Position += 8 )
+    {
+        Hash ^= XXH64Round( 0, Read64( Position ) );
+        Hash = RotateLeft( Hash, 27 ) * XXH64Prime1 + XXH64Prime4;
+    }
+    
+    if( End - Position >= 4 )
+    {
+        Hash ^= (uint64_t)Read32( Position ) * XXH64Prime1;
+        Hash = RotateLeft( Hash, 23 ) * XXH64Prime2 + XXH64Prime3;
+        Position += 4;
+    }
+    
+    for( ; Position < End; Position++ )
+    {
+        Hash ^= (*Position) * XXH64Prime5;
+        Hash = RotateLeft( Hash, 11 ) * XXH64Prime1;
+    }
+    
+    // final mix of all bits
+    Hash ^= Hash >> 33;
+    Hash *= XXH64Prime2;
+    Hash ^= Hash >> 29;
+    Hash *= XXH64Prime3;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
@@ -0,0 +1,25 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef HASHFUNCTIONS_HPP
+    #define HASHFUNCTIONS_HPP
+    
+    // include C/C++ headers
+    #include <cstdint>          // [ ANSI C ] Standard integer types
+    #include <cstddef>          // [ ANSI C ] Standard definitions
+// *****************************************************************************
+
+
+// =============================================================================
+//      HASH FUNCTIONS
+// =============================================================================
+
+
+// non-cryptographic 64-bit hash (XXH64 algorithm); a
+// previous hash can be given as seed to chain blocks
+uint64_t HashXXH64( const void* Data, size_t Size, uint64_t Seed = 0 );
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
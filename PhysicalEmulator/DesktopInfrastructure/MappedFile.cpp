@@ -0,0 +1,224 @@
+// *****************************************************************************
+    // include project headers
+    #include "MappedFile.hpp"
+    
+    // include OS headers for file mapping
+    #if defined(__WIN32__) || defined(_WIN32) || defined(_WIN64)
+      #define MAPPED_FILE_WINDOWS
+      #include <windows.h>
+    #else
+      #include <sys/mman.h>     // [ POSIX ] Memory mapping
+      #include <sys/stat.h>     // [ POSIX ] File status
+      #include <fcntl.h>        // [ POSIX ] File control
+      #include <unistd.h>       // [ POSIX ] Standard symbols
+    #endif
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      MAPPED FILE: INSTANCE HANDLING
+// =============================================================================
+
+
+MappedFile::MappedFile()
+{
+    Data = nullptr;
+    Size = 0;
+    
+    #if defined(MAPPED_FILE_WINDOWS)
+      FileHandle = INVALID_HANDLE_VALUE;
+      MappingHandle = nullptr;
+    #else
+      FileDescriptor = -1;
+    #endif
+}
+
+// -----------------------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+
+// =============================================================================
+//      MAPPED FILE: OPENING AND CLOSING
+// =============================================================================
+
+
+bool MappedFile::Open( const string& FilePath )
+{
+    Close();
+    
+    #if defined(MAPPED_FILE_WINDOWS)
+    
+      FileHandle = CreateFileA( FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+                                
+      if( FileHandle == INVALID_HANDLE_VALUE )
+        return false;
+        
+      LARGE_INTEGER FileSize;
+      
+      if( !GetFileSizeEx( (HANDLE)FileHandle, &FileSize ) )
+      {
+          Close();
+          return false;
+      }
+      
+      Size = (size_t)FileSize.QuadPart;
+      
+      // empty files cannot be mapped, but they are valid
+      if( Size == 0 )
+        return true;
+        
+      MappingHandle = CreateFileMappingA( (HANDLE)FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+      
+      if( MappingHandle )
+        Data = (const uint8_t*)MapViewOfFile( (HANDLE)MappingHandle, FILE_MAP_READ, 0, 0, 0 );
+        
+    #else
+    
+      FileDescriptor = open( FilePath.c_str(), O_RDONLY );
+      
+      if( FileDescriptor < 0 )
+        return false;
+        
+      struct stat FileStatus;
+      
+      if( fstat( FileDescriptor, &FileStatus ) != 0 || !S_ISREG( FileStatus.st_mode ) )
+      {
+          Close();
+          return false;
+      }
+      
+      Size = (size_t)FileStatus.st_size;
+      
+      // empty files cannot be mapped, but they are valid
+      if( Size == 0 )
+        return true;
+        
+      void* Mapping = mmap( nullptr, Size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0 );
+      
+      if( Mapping != MAP_FAILED )
+      {
+          Data = (const uint8_t*)Mapping;
+          madvise( Mapping, Size, MADV_SEQUENTIAL );
+      }
+      
+    #endif
+    
+    if( !Data )
+    {
+        Close();
+        return false;
+    }
+    
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void MappedFile::Close()
+{
+    #if defined(MAPPED_FILE_WINDOWS)
+    
+      if( Data ) UnmapViewOfFile( Data );
+      if( MappingHandle ) CloseHandle( (HANDLE)MappingHandle );
+      if( FileHandle != INVALID_HANDLE_VALUE ) CloseHandle( (HANDLE)FileHandle );
+      MappingHandle = nullptr;
+      FileHandle = INVALID_HANDLE_VALUE;
+      
+    #else
+    
+      if( Data ) munmap( (void*)Data, Size );
+      if( FileDescriptor >= 0 ) close( FileDescriptor );
+      FileDescriptor = -1;
+      
+    #endif
+    
+    Data = nullptr;
+    Size = 0;
+}
+
+
+// =============================================================================
+//      MAPPED FILE: HINTS FOR THE OS
+// =============================================================================
+
+
+// the OS starts reading the range in the background
+// (this is only a hint, and it can be ignored)
+void MappedFile::PrefetchRange( size_t Offset, size_t Length )
+{
+    if( !Data || Offset >= Size )
+      return;
+      
+    Length = (Length < Size - Offset)? Length : (Size - Offset);
+    
+    #if defined(MAPPED_FILE_WINDOWS)
+    
+      // not available in older Windows versions, so it is
+      // loaded at runtime and otherwise ignored
+      typedef BOOL (WINAPI *PrefetchFunction)( HANDLE, ULONG_PTR, void*, ULONG );
+      HMODULE Kernel = GetModuleHandleA( "kernel32.dll" );
+      PrefetchFunction Prefetch = Kernel? (PrefetchFunction)GetProcAddress( Kernel, "PrefetchVirtualMemory" ) : nullptr;
+      
+      if( Prefetch )
+      {
+          struct { void* Address; SIZE_T Bytes; } Range = { (void*)(Data + Offset), Length };
+          Prefetch( GetCurrentProcess(), 1, &Range, 0 );
+      }
+      
+    #else
+    
+      // madvise needs a page-aligned start
+      size_t PageSize = (size_t)sysconf( _SC_PAGESIZE );
+      size_t AlignedOffset = Offset - (Offset % PageSize);
+      madvise( (void*)(Data + AlignedOffset), Length + (Offset - AlignedOffset), MADV_WILLNEED );
+      
+    #endif
+}
+
+// -----------------------------------------------------------------------------
+
+// pages in the range are dropped from memory, and will be
+// read again from the file if accessed. Only pages fully
+// inside the range are affected, so that neighbour data
+// stays in memory
+void MappedFile::ReleaseRange( size_t Offset, size_t Length )
+{
+    if( !Data || Offset >= Size )
+      return;
+      
+    Length = (Length < Size - Offset)? Length : (Size - Offset);
+    
+    #if defined(MAPPED_FILE_WINDOWS)
+      size_t PageSize = 4096;
+    #else
+      size_t PageSize = (size_t)sysconf( _SC_PAGESIZE );
+    #endif
+    
+    size_t FirstPage = ((Offset + PageSize - 1) / PageSize) * PageSize;
+    size_t EndPage = ((Offset + Length) / PageSize) * PageSize;
+    
+    if( EndPage <= FirstPage )
+      return;
+      
+    #if defined(MAPPED_FILE_WINDOWS)
+    
+      // unlocking pages that were not locked is documented
+      // to remove them from the process working set
+      VirtualUnlock( (void*)(Data + FirstPage), EndPage - FirstPage );
+      
+    #else
+    
+      // the mapping is never written, so the pages are
+      // just discarded and the file is not modified
+      madvise( (void*)(Data + FirstPage), EndPage - FirstPage, MADV_DONTNEED );
+      
+    #endif
+}
@@ -0,0 +1,58 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef MAPPEDFILE_HPP
+    #define MAPPEDFILE_HPP
+    
+    // include C/C++ headers
+    #include <string>           // [ C++ STL ] Strings
+    #include <cstdint>          // [ ANSI C ] Standard integer types
+    #include <cstddef>          // [ ANSI C ] Standard definitions
+// *****************************************************************************
+
+
+// =============================================================================
+//      READ-ONLY MAPPED FILE
+// =============================================================================
+
+
+// Maps a whole file in memory, so that its contents can
+// be used directly with no intermediate copies. Pages are
+// read by the OS when first accessed; ranges that will be
+// needed soon can be requested in advance, so that the
+// reading overlaps with other work
+class MappedFile
+{
+    public:
+    
+        // mapped contents
+        const uint8_t* Data;
+        size_t Size;
+        
+        // OS handles
+        #if defined(__WIN32__) || defined(_WIN32) || defined(_WIN64)
+          void* FileHandle;
+          void* MappingHandle;
+        #else
+          int FileDescriptor;
+        #endif
+        
+    public:
+    
+        // instance handling
+        MappedFile();
+       ~MappedFile();
+       
+        // returns false if the file cannot be mapped
+        bool Open( const std::string& FilePath );
+        void Close();
+        
+        // hints for the OS
+        void PrefetchRange( size_t Offset, size_t Length );
+        void ReleaseRange( size_t Offset, size_t Length );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
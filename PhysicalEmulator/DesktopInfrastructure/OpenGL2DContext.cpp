@@ -5,6 +5,18 @@
     // include project headers
     #include "OpenGL2DContext.hpp"
     #include "LogStream.hpp"
+    #include "HashFunctions.hpp"
+    
+    // include C/C++ headers
+    #include <vector>           // [ C++ STL ] Vectors
+    #include <map>              // [ C++ STL ] Maps
+    #include <fstream>          // [ C++ STL ] File streams
+    #include <cstring>          // [ ANSI C ] Strings
+    
+    // not defined in older EGL headers
+    #if defined(ENABLE_HEADLESS_GL) && !defined(EGL_PLATFORM_SURFACELESS_MESA)
+      #define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+    #endif
     
     // declare used namespaces
     using namespace std;
@@ -113,6 +125,47 @@ const string FragmentShaderCode =
     "}                                                                               \n";
 
 
+// =============================================================================
+//      FRAMEBUFFER READBACK THREAD
+// =============================================================================
+
+
+// Each time a read frame is posted, the thread copies it
+// out of GL memory and then passes it to all consumers.
+// The source is released before consumers are called, so
+// that the GL thread can recycle it as soon as possible
+int FramebufferReadbackThread( void* Parameters )
+{
+    OpenGL2DContext* Context = (OpenGL2DContext*)Parameters;
+    const unsigned RowBytes = 4 * Constants::ScreenWidth;
+    
+    while( true )
+    {
+        SDL_SemWait( Context->ReadbackSemaphore );
+        
+        if( Context->ReadbackExitFlag )
+          break;
+          
+        // GL stores rows bottom to top, so
+        // flip them while copying
+        for( int y = 0; y < Constants::ScreenHeight; y++ )
+        {
+            const uint8_t* SourceRow = Context->ReadbackSource + (Constants::ScreenHeight - 1 - y) * RowBytes;
+            memcpy( &Context->ReadbackPixels[ y * Constants::ScreenWidth ], SourceRow, RowBytes );
+        }
+        
+        SDL_AtomicSet( &Context->ReadbackSourceInUse, 0 );
+        
+        for( FrameConsumerInterface* Consumer: Context->FrameConsumers )
+          Consumer->ProcessFrame( &Context->ReadbackPixels[ 0 ], Context->ReadbackSourceFrame );
+          
+        SDL_AtomicSet( &Context->ReadbackThreadBusy, 0 );
+    }
+    
+    return 0;
+}
+
+
 // =============================================================================
 //      OPENGL 2D CONTEXT: INSTANCE HANDLING
 // =============================================================================
@@ -131,10 +184,57 @@ OpenGL2DContext::OpenGL2DContext()
     FBColorTextureID = 0;
     FramebufferWidth = 0;
     FramebufferHeight = 0;
+    SpeculativeFramebufferID = 0;
+    SpeculativeColorTextureID = 0;
+    UploadPixels.resize( 3 * Constants::ScreenPixels );
     
     // SDL & OpenGL contexts not created yet
     Window = nullptr;
     OpenGLContext = nullptr;
+    
+    // shader programs are not cached by default
+    GetProgramBinary = nullptr;
+    ProgramBinary = nullptr;
+    ProgramParameteri = nullptr;
+    
+    // GPU timing is not enabled
+    GPUTimingEnabled = false;
+    TimingNeedsDisjointCheck = false;
+    TimingFrame = 0;
+    ActiveTimedPhase = -1;
+    GenQueries = nullptr;
+    DeleteQueries = nullptr;
+    BeginQuery = nullptr;
+    EndQuery = nullptr;
+    GetQueryObjectuiv = nullptr;
+    GetQueryObjectui64v = nullptr;
+    
+    #if defined(ENABLE_HEADLESS_GL)
+      HeadlessDisplay = EGL_NO_DISPLAY;
+      HeadlessContext = EGL_NO_CONTEXT;
+    #endif
+    
+    // framebuffer readback is not enabled
+    ReadbackEnabled = false;
+    ReadbackUsesPBOs = false;
+    ReadbackDropsFrames = true;
+    memset( ReadbackPBOs, 0, sizeof( ReadbackPBOs ) );
+    memset( ReadbackFences, 0, sizeof( ReadbackFences ) );
+    NextReadbackBuffer = 0;
+    MappedReadbackBuffer = -1;
+    ReadbackFrameCounter = 0;
+    DroppedReadbackFrames = 0;
+    FenceSync = nullptr;
+    ClientWaitSync = nullptr;
+    DeleteSync = nullptr;
+    
+    ReadbackThread = nullptr;
+    ReadbackSemaphore = nullptr;
+    SDL_AtomicSet( &ReadbackSourceInUse, 0 );
+    SDL_AtomicSet( &ReadbackThreadBusy, 0 );
+    ReadbackExitFlag = false;
+    ReadbackSource = nullptr;
+    ReadbackSourceFrame = 0;
 }
 
 // -----------------------------------------------------------------------------
@@ -215,6 +315,10 @@ void OpenGL2DContext::CreateOpenGLWindow()
     if( !gladLoadGLLoader( (GLADloadproc)SDL_GL_GetProcAddress ) )
       THROW( "There was an error initializing GLAD" );
     
+    LoadProgramBinaryFunctions( (GLADloadproc)SDL_GL_GetProcAddress );
+    LoadTimerQueryFunctions( (GLADloadproc)SDL_GL_GetProcAddress );
+    LoadSyncFunctions( (GLADloadproc)SDL_GL_GetProcAddress );
+    
     // log the version name for the received OpenGL context
     string OpenGLVersionName = (const char *)glGetString(GL_VERSION);
     LOG( "Started OpenGL version " + OpenGLVersionName );
@@ -256,6 +360,111 @@ void OpenGL2DContext::CreateOpenGLWindow()
 
 // -----------------------------------------------------------------------------
 
+// Creates a context that can only render to our framebuffer,
+// without any window. It uses Mesa's surfaceless platform, so
+// it needs no display server or GPU (it works with llvmpipe)
+void OpenGL2DContext::CreateHeadlessContext()
+{
+    #if !defined(ENABLE_HEADLESS_GL)
+    
+      THROW( "This program was built without support for headless OpenGL" );
+      
+    #else
+    
+      LOG_SCOPE( "Creating headless OpenGL context" );
+      
+      // check that the surfaceless platform is available
+      const char* ClientExtensions = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+      
+      if( !ClientExtensions || !strstr( ClientExtensions, "EGL_MESA_platform_surfaceless" ) )
+        THROW( "EGL does not support the surfaceless platform" );
+        
+      PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+        
+      if( !GetPlatformDisplay )
+        THROW( "Cannot find function eglGetPlatformDisplayEXT" );
+        
+      // initialize EGL on that platform
+      LOG( "Initializing EGL" );
+      HeadlessDisplay = GetPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, nullptr, nullptr );
+      EGLint EGLMajorVersion = 0, EGLMinorVersion = 0;
+      
+      if( HeadlessDisplay == EGL_NO_DISPLAY || !eglInitialize( HeadlessDisplay, &EGLMajorVersion, &EGLMinorVersion ) )
+        THROW( "Cannot initialize EGL display" );
+        
+      LOG( "Started EGL version " << EGLMajorVersion << "." << EGLMinorVersion );
+      
+      // request the same OpenGL versions as for windows
+      #ifdef __arm__
+        EGLenum RequestedAPI = EGL_OPENGL_ES_API;
+        EGLint RenderableType = EGL_OPENGL_ES2_BIT;
+        EGLint RequestedMajorVersion = 2;
+      #else
+        EGLenum RequestedAPI = EGL_OPENGL_API;
+        EGLint RenderableType = EGL_OPENGL_BIT;
+        EGLint RequestedMajorVersion = 3;
+      #endif
+      
+      if( !eglBindAPI( RequestedAPI ) )
+        THROW( "Cannot select OpenGL API in EGL" );
+        
+      // configurations in this platform only support pbuffers
+      EGLint ConfigAttributes[] =
+      {
+          EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+          EGL_RENDERABLE_TYPE, RenderableType,
+          EGL_RED_SIZE, 8,
+          EGL_GREEN_SIZE, 8,
+          EGL_BLUE_SIZE, 8,
+          EGL_NONE
+      };
+      
+      EGLConfig Config;
+      EGLint NumberOfConfigs = 0;
+      
+      if( !eglChooseConfig( HeadlessDisplay, ConfigAttributes, &Config, 1, &NumberOfConfigs ) || NumberOfConfigs < 1 )
+        THROW( "Cannot find a suitable EGL configuration" );
+        
+      // create the context and use it with no surface
+      LOG( "Creating OpenGL context" );
+      EGLint ContextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, RequestedMajorVersion, EGL_NONE };
+      HeadlessContext = eglCreateContext( HeadlessDisplay, Config, EGL_NO_CONTEXT, ContextAttributes );
+      
+      if( HeadlessContext == EGL_NO_CONTEXT )
+        THROW( "OpenGL context cannot be created: EGL error " + to_string( eglGetError() ) );
+        
+      if( !eglMakeCurrent( HeadlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, HeadlessContext ) )
+        THROW( "Cannot activate OpenGL context without a surface" );
+        
+      LOG( "Initializing GLAD" );
+      
+      if( !gladLoadGLLoader( (GLADloadproc)eglGetProcAddress ) )
+        THROW( "There was an error initializing GLAD" );
+        
+      LoadProgramBinaryFunctions( (GLADloadproc)eglGetProcAddress );
+      LoadTimerQueryFunctions( (GLADloadproc)eglGetProcAddress );
+      LoadSyncFunctions( (GLADloadproc)eglGetProcAddress );
+      
+      // show basic OpenGL information
+      LOG( "Started OpenGL version " << (char*)glGetString( GL_VERSION ) );
+      LOG( "OpenGL renderer: " << (char*)glGetString( GL_RENDERER ) );
+      LOG( "GLSL version: " << (char*)glGetString( GL_SHADING_LANGUAGE_VERSION ) );
+      
+      // there is no screen, so our only size is the framebuffer's
+      WindowWidth  = Constants::ScreenWidth;
+      WindowHeight = Constants::ScreenHeight;
+      glViewport( 0, 0, WindowWidth, WindowHeight );
+      
+      // same as for windows
+      glDisable( GL_SCISSOR_TEST );
+      glEnable( GL_TEXTURE_2D );
+      
+    #endif
+}
+
+// -----------------------------------------------------------------------------
+
 void OpenGL2DContext::CreateFramebuffer()
 {
     LOG_SCOPE( "Creating Framebuffer" );
@@ -343,6 +552,17 @@ bool OpenGL2DContext::CompileShaderProgram()
     
     ClearOpenGLErrors();
     
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // PART 0: Use a previous binary of the same program, if available
+    uint64_t SourceHash = HashXXH64( VertexShaderCode.data(), VertexShaderCode.size() );
+    SourceHash = HashXXH64( FragmentShaderCode.data(), FragmentShaderCode.size(), SourceHash );
+    
+    if( LoadCachedProgram( ShaderProgramID, SourceHash ) )
+    {
+        LOG( "Shader program loaded from cache! ID = " << ShaderProgramID );
+        return true;
+    }
+    
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     // PART 1: Compile our vertex shader
     VertexShaderID = glCreateShader( GL_VERTEX_SHADER );
@@ -401,6 +621,12 @@ bool OpenGL2DContext::CompileShaderProgram()
     ShaderProgramID = glCreateProgram();
     glAttachShader( ShaderProgramID, VertexShaderID );
     glAttachShader( ShaderProgramID, FragmentShaderID );
+    
+    // some drivers need to know in advance
+    // that we will ask for the program binary
+    if( ProgramParameteri && !ShaderCachePath.empty() )
+      ProgramParameteri( ShaderProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+      
     glLinkProgram( ShaderProgramID );
     
     glGetProgramiv( ShaderProgramID, GL_LINK_STATUS, &Success );
@@ -429,6 +655,8 @@ bool OpenGL2DContext::CompileShaderProgram()
     glDeleteShader( VertexShaderID );
     glDeleteShader( FragmentShaderID );
     
+    // save it for the next time
+    SaveCachedProgram( ShaderProgramID, SourceHash );
     return true;
 }
 
@@ -570,12 +798,225 @@ void OpenGL2DContext::CreateWhiteTexture()
 
 void OpenGL2DContext::Destroy()
 {
+    // these need the GL context to release their objects
+    DisableReadback();
+    DisableGPUTiming();
+    
     // destroy in reverse order
     if( OpenGLContext )
       SDL_GL_DeleteContext( OpenGLContext );
     
     if( Window )
       SDL_DestroyWindow( Window );
+      
+    #if defined(ENABLE_HEADLESS_GL)
+    
+      if( HeadlessContext != EGL_NO_CONTEXT )
+        eglDestroyContext( HeadlessDisplay, HeadlessContext );
+        
+      if( HeadlessDisplay != EGL_NO_DISPLAY )
+        eglTerminate( HeadlessDisplay );
+        
+      HeadlessContext = EGL_NO_CONTEXT;
+      HeadlessDisplay = EGL_NO_DISPLAY;
+      
+    #endif
+}
+
+
+// =============================================================================
+//      OPENGL 2D CONTEXT: SHADER PROGRAM CACHE
+// =============================================================================
+
+
+// reads all entries in a cache file, as long as it was
+// written for the same driver; returns false otherwise
+bool ReadShaderCache( const string& FilePath, uint64_t DriverHash, map< uint64_t, ShaderCacheEntry >& Entries, map< uint64_t, vector< uint8_t > >& Binaries )
+{
+    ifstream InputFile;
+    InputFile.open( FilePath, ios_base::binary );
+    
+    if( InputFile.fail() )
+      return false;
+      
+    ShaderCacheHeader Header;
+    InputFile.read( (char*)&Header, sizeof(ShaderCacheHeader) );
+    
+    if( InputFile.fail() || memcmp( Header.Signature, SHADER_CACHE_SIGNATURE, 8 ) )
+      return false;
+      
+    if( Header.Version != SHADER_CACHE_VERSION || Header.DriverHash != DriverHash )
+      return false;
+      
+    for( unsigned i = 0; i < Header.NumberOfEntries; i++ )
+    {
+        ShaderCacheEntry Entry;
+        InputFile.read( (char*)&Entry, sizeof(ShaderCacheEntry) );
+        
+        // an incomplete file is just ignored
+        if( InputFile.fail() || Entry.BinaryLength == 0 || Entry.BinaryLength > (64 << 20) )
+          return false;
+          
+        vector< uint8_t >& Binary = Binaries[ Entry.SourceHash ];
+        Binary.resize( Entry.BinaryLength );
+        InputFile.read( (char*)&Binary[ 0 ], Entry.BinaryLength );
+        
+        if( InputFile.fail() )
+          return false;
+          
+        Entries[ Entry.SourceHash ] = Entry;
+    }
+    
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// loaded in the same way as GLAD, since they are not in
+// our GLAD profiles; GLES drivers may only have OES names
+void OpenGL2DContext::LoadProgramBinaryFunctions( GLADloadproc Loader )
+{
+    GetProgramBinary = (GetProgramBinaryFunction)Loader( "glGetProgramBinary" );
+    ProgramBinary = (ProgramBinaryFunction)Loader( "glProgramBinary" );
+    ProgramParameteri = (ProgramParameteriFunction)Loader( "glProgramParameteri" );
+    
+    if( !GetProgramBinary || !ProgramBinary )
+    {
+        GetProgramBinary = (GetProgramBinaryFunction)Loader( "glGetProgramBinaryOES" );
+        ProgramBinary = (ProgramBinaryFunction)Loader( "glProgramBinaryOES" );
+    }
+    
+    // loaders can give functions the driver does not
+    // support, so also check that some format exists
+    GLint NumberOfFormats = 0;
+    glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &NumberOfFormats );
+    ClearOpenGLErrors();
+    
+    if( !GetProgramBinary || !ProgramBinary || NumberOfFormats <= 0 )
+    {
+        LOG( "Shader program binaries are not supported" );
+        GetProgramBinary = nullptr;
+        ProgramBinary = nullptr;
+        ProgramParameteri = nullptr;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// binaries are only valid for the same driver version
+uint64_t OpenGL2DContext::GetDriverHash()
+{
+    string DriverName = string( (const char*)glGetString( GL_VENDOR ) ) + "\n"
+                      + string( (const char*)glGetString( GL_RENDERER ) ) + "\n"
+                      + string( (const char*)glGetString( GL_VERSION ) );
+                      
+    return HashXXH64( DriverName.data(), DriverName.size() );
+}
+
+// -----------------------------------------------------------------------------
+
+// on success a new linked program is given; the driver can
+// still reject a binary, and then we need to compile it
+bool OpenGL2DContext::LoadCachedProgram( GLuint& ProgramID, uint64_t SourceHash )
+{
+    if( ShaderCachePath.empty() || !ProgramBinary )
+      return false;
+      
+    map< uint64_t, ShaderCacheEntry > Entries;
+    map< uint64_t, vector< uint8_t > > Binaries;
+    
+    if( !ReadShaderCache( ShaderCachePath, GetDriverHash(), Entries, Binaries ) )
+      return false;
+      
+    if( !Entries.count( SourceHash ) )
+      return false;
+      
+    ShaderCacheEntry& Entry = Entries[ SourceHash ];
+    GLuint NewProgramID = glCreateProgram();
+    ProgramBinary( NewProgramID, Entry.BinaryFormat, &Binaries[ SourceHash ][ 0 ], Entry.BinaryLength );
+    
+    GLint Success = 0;
+    glGetProgramiv( NewProgramID, GL_LINK_STATUS, &Success );
+    ClearOpenGLErrors();
+    
+    if( !Success )
+    {
+        LOG( "Cached shader program was rejected by the driver" );
+        glDeleteProgram( NewProgramID );
+        return false;
+    }
+    
+    ProgramID = NewProgramID;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// other programs already in the cache are kept
+void OpenGL2DContext::SaveCachedProgram( GLuint ProgramID, uint64_t SourceHash )
+{
+    if( ShaderCachePath.empty() || !GetProgramBinary )
+      return;
+      
+    // obtain the program binary
+    GLint BinaryLength = 0;
+    glGetProgramiv( ProgramID, GL_PROGRAM_BINARY_LENGTH, &BinaryLength );
+    
+    if( BinaryLength <= 0 )
+    {
+        ClearOpenGLErrors();
+        return;
+    }
+    
+    vector< uint8_t > Binary( BinaryLength );
+    GLenum BinaryFormat = 0;
+    GetProgramBinary( ProgramID, BinaryLength, &BinaryLength, &BinaryFormat, &Binary[ 0 ] );
+    
+    if( glGetError() != GL_NO_ERROR || BinaryLength <= 0 )
+      return;
+      
+    // add it to the previous entries
+    uint64_t DriverHash = GetDriverHash();
+    map< uint64_t, ShaderCacheEntry > Entries;
+    map< uint64_t, vector< uint8_t > > Binaries;
+    
+    if( !ReadShaderCache( ShaderCachePath, DriverHash, Entries, Binaries ) )
+    {
+        Entries.clear();
+        Binaries.clear();
+    }
+    
+    Entries[ SourceHash ] = ShaderCacheEntry{ SourceHash, BinaryFormat, (uint32_t)BinaryLength };
+    Binary.resize( BinaryLength );
+    Binaries[ SourceHash ] = Binary;
+    
+    // rewrite the whole file
+    ofstream OutputFile;
+    OutputFile.open( ShaderCachePath, ios_base::binary | ios_base::trunc );
+    
+    // this is not an error: just stop using the cache,
+    // so that it is not reported again for each program
+    if( OutputFile.fail() )
+    {
+        LOG( "Shader cache file \"" << ShaderCachePath << "\" cannot be written, programs will not be cached" );
+        ShaderCachePath.clear();
+        return;
+    }
+    
+    ShaderCacheHeader Header;
+    memcpy( Header.Signature, SHADER_CACHE_SIGNATURE, 8 );
+    Header.Version = SHADER_CACHE_VERSION;
+    Header.NumberOfEntries = Entries.size();
+    Header.DriverHash = DriverHash;
+    OutputFile.write( (const char*)&Header, sizeof(ShaderCacheHeader) );
+    
+    for( auto& Pair: Entries )
+    {
+        OutputFile.write( (const char*)&Pair.second, sizeof(ShaderCacheEntry) );
+        OutputFile.write( (const char*)&Binaries[ Pair.first ][ 0 ], Pair.second.BinaryLength );
+    }
+    
+    LOG( "Shader program saved to cache (" << BinaryLength << " bytes)" );
 }
 
 
@@ -614,6 +1055,89 @@ void OpenGL2DContext::SetFullScreen()
 }
 
 
+// =============================================================================
+//      OPENGL 2D CONTEXT: HANDLING TEXTURES
+// =============================================================================
+
+
+unsigned OpenGL2DContext::CreateTexture( void* Pixels, unsigned Width, unsigned Height )
+{
+    // create a new OpenGL texture and select it
+    GLuint TextureID;
+    glGenTextures( 1, &TextureID );
+    glBindTexture( GL_TEXTURE_2D, TextureID );
+    
+    // check correct texture ID
+    if( !TextureID )
+      THROW( "OpenGL failed to generate a new texture" );
+      
+    // clear OpenGL errors
+    glGetError();
+    
+    // (1) first we build an empty texture of the extented size
+    glTexImage2D
+    (
+        GL_TEXTURE_2D,              // texture is a 2D rectangle
+        0,                          // level of detail (0 = normal size)
+        GL_RGBA,                    // color components in the texture
+        Constants::GPUTextureSize,  // texture width in pixels
+        Constants::GPUTextureSize,  // texture height in pixels
+        0,                          // border width (must be 0 or 1)
+        GL_RGBA,                    // color components in the source
+        GL_UNSIGNED_BYTE,           // each color component is a byte
+        nullptr                     // buffer storing the texture data
+    );
+    
+    // check correct conversion
+    if( glGetError() != GL_NO_ERROR )
+      THROW( "Could not create an empty OpenGL texture" );
+      
+    // (2) then we modify the part of our image
+    glTexSubImage2D
+    (
+        GL_TEXTURE_2D,       // texture is a 2D rectangle
+        0,                   // level of detail (0 = normal size)
+        0,                   // x offset
+        0,                   // y offset
+        Width,               // image width in pixels
+        Height,              // image height in pixels
+        GL_RGBA,             // color components in the source
+        GL_UNSIGNED_BYTE,    // each color component is a byte
+        Pixels               // buffer storing the texture data
+    );
+    
+    // check correct conversion
+    if( glGetError() != GL_NO_ERROR )
+      THROW( "Could not copy the loaded SDL image to the OpenGL texture" );
+      
+    // textures must be scaled using only nearest neighbour
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );         
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    
+    // out-of-texture coordinates must clamp, not wrap
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    
+    return TextureID;
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::DestroyTexture( unsigned TextureID )
+{
+    GLuint DeletedID = TextureID;
+    glDeleteTextures( 1, &DeletedID );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::BindTexture( unsigned TextureID )
+{
+    glBindTexture( GL_TEXTURE_2D, TextureID );
+    glEnable( GL_TEXTURE_2D );
+}
+
+
 // =============================================================================
 //      OPENGL 2D CONTEXT: FRAMEBUFFER RENDER FUNCTIONS
 // =============================================================================
@@ -647,6 +1171,77 @@ void OpenGL2DContext::RenderToFramebuffer()
 
 // -----------------------------------------------------------------------------
 
+void OpenGL2DContext::FinishFrame()
+{
+    // ensure that all commands run in
+    // the current frame are drawn
+    glFlush();
+}
+
+// -----------------------------------------------------------------------------
+
+// created on first use, like the main framebuffer
+void OpenGL2DContext::CreateSpeculativeFramebuffer()
+{
+    glGenTextures( 1, &SpeculativeColorTextureID );
+    glBindTexture( GL_TEXTURE_2D, SpeculativeColorTextureID );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB8, FramebufferWidth, FramebufferHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, 0 );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    
+    glGenFramebuffers( 1, &SpeculativeFramebufferID );
+    glBindFramebuffer( GL_FRAMEBUFFER, SpeculativeFramebufferID );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, SpeculativeColorTextureID, 0 );
+    
+    if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+      THROW( "Cannot create a framebuffer for speculative frames" );
+      
+    GLenum ColorBuffers[ 1 ] = { GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers( 1, ColorBuffers );
+}
+
+// -----------------------------------------------------------------------------
+
+// swaps keep the render target selected, since
+// the GPU may be drawing when they are called
+void OpenGL2DContext::SwapFramebuffers()
+{
+    swap( FramebufferID, SpeculativeFramebufferID );
+    swap( FBColorTextureID, SpeculativeColorTextureID );
+    glBindFramebuffer( GL_FRAMEBUFFER, FramebufferID );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::BeginSpeculativeDrawing()
+{
+    if( !SpeculativeFramebufferID )
+      CreateSpeculativeFramebuffer();
+      
+    // copy the current contents to the other
+    // framebuffer, which becomes the active one
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, FramebufferID );
+    glBindFramebuffer( GL_DRAW_FRAMEBUFFER, SpeculativeFramebufferID );
+    
+    glBlitFramebuffer
+    (
+        0, 0, Constants::ScreenWidth, Constants::ScreenHeight,
+        0, 0, Constants::ScreenWidth, Constants::ScreenHeight,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST
+    );
+    
+    SwapFramebuffers();
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::EndSpeculativeDrawing()
+{
+    SwapFramebuffers();
+}
+
+// -----------------------------------------------------------------------------
+
 void OpenGL2DContext::DrawFramebufferOnScreen()
 {
     // 2 framebuffers can be bound for reading and
@@ -666,6 +1261,619 @@ void OpenGL2DContext::DrawFramebufferOnScreen()
     );    
 }
 
+// -----------------------------------------------------------------------------
+
+// used to show images rendered outside of OpenGL:
+// the given pixels (640x360, first row is the screen
+// top) replace the contents of our framebuffer
+void OpenGL2DContext::UploadFramebuffer( const GPUColor* Pixels )
+{
+    // our framebuffer texture stores rows bottom to top,
+    // and has no alpha channel, so convert pixels first
+    uint8_t* RGBPixel = &UploadPixels[ 0 ];
+    
+    for( int y = Constants::ScreenHeight - 1; y >= 0; y-- )
+    {
+        const GPUColor* SourcePixel = &Pixels[ y * Constants::ScreenWidth ];
+        
+        for( int x = 0; x < Constants::ScreenWidth; x++ )
+        {
+            *(RGBPixel++) = SourcePixel->R;
+            *(RGBPixel++) = SourcePixel->G;
+            *(RGBPixel++) = SourcePixel->B;
+            SourcePixel++;
+        }
+    }
+    
+    // now replace the visible area of the texture
+    glBindTexture( GL_TEXTURE_2D, FBColorTextureID );
+    
+    glTexSubImage2D
+    (
+        GL_TEXTURE_2D,              // texture is a 2D rectangle
+        0,                          // level of detail (0 = normal size)
+        0,                          // x offset
+        0,                          // y offset
+        Constants::ScreenWidth,     // image width in pixels
+        Constants::ScreenHeight,    // image height in pixels
+        GL_RGB,                     // color components in the source
+        GL_UNSIGNED_BYTE,           // each color component is a byte
+        &UploadPixels[ 0 ]          // buffer storing the texture data
+    );
+}
+
+// -----------------------------------------------------------------------------
+
+// the opposite of the above: the whole framebuffer
+// is read back to the given pixels, and the GPU is
+// waited for, so this is only meant for test tools
+void OpenGL2DContext::ReadFramebuffer( GPUColor* Pixels )
+{
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, FramebufferID );
+    glReadPixels( 0, 0, Constants::ScreenWidth, Constants::ScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, Pixels );
+    
+    // GL stores rows bottom to top
+    vector< GPUColor > SwappedRow( Constants::ScreenWidth );
+    const unsigned RowBytes = Constants::ScreenWidth * sizeof( GPUColor );
+    
+    for( int y = 0; y < Constants::ScreenHeight / 2; y++ )
+    {
+        GPUColor* TopRow = &Pixels[ y * Constants::ScreenWidth ];
+        GPUColor* BottomRow = &Pixels[ (Constants::ScreenHeight - 1 - y) * Constants::ScreenWidth ];
+        memcpy( &SwappedRow[ 0 ], TopRow, RowBytes );
+        memcpy( TopRow, BottomRow, RowBytes );
+        memcpy( BottomRow, &SwappedRow[ 0 ], RowBytes );
+    }
+}
+
+
+// =============================================================================
+//      OPENGL 2D CONTEXT: FRAMEBUFFER READBACK
+// =============================================================================
+
+
+// fences are core since GL 3.2 and GLES 3.0; without
+// them, reads are assumed complete after a few frames
+void OpenGL2DContext::LoadSyncFunctions( GLADloadproc Loader )
+{
+    const char* VersionName = (const char*)glGetString( GL_VERSION );
+    bool IsGLES = (VersionName && !strncmp( VersionName, "OpenGL ES", 9 ));
+    bool HasFences = (GLVersion.major > 3 || (GLVersion.major == 3 && (IsGLES || GLVersion.minor >= 2)));
+    
+    FenceSync = (FenceSyncFunction)Loader( "glFenceSync" );
+    ClientWaitSync = (ClientWaitSyncFunction)Loader( "glClientWaitSync" );
+    DeleteSync = (DeleteSyncFunction)Loader( "glDeleteSync" );
+    
+    if( !HasFences || !FenceSync || !ClientWaitSync || !DeleteSync )
+    {
+        FenceSync = nullptr;
+        ClientWaitSync = nullptr;
+        DeleteSync = nullptr;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// must be called with the GL context already created
+void OpenGL2DContext::EnableReadback()
+{
+    if( ReadbackEnabled )
+      return;
+      
+    // frames can only be dropped if no consumer needs all of them
+    ReadbackDropsFrames = true;
+    
+    for( FrameConsumerInterface* Consumer: FrameConsumers )
+      if( Consumer->NeedsAllFrames() )
+        ReadbackDropsFrames = false;
+        
+    // mapping buffers needs OpenGL 3.0; under GLES 2
+    // those functions will not have been loaded
+    ReadbackUsesPBOs = (GLVersion.major >= 3 && glMapBufferRange && glUnmapBuffer);
+    const unsigned FrameBytes = 4 * Constants::ScreenPixels;
+    
+    if( ReadbackUsesPBOs )
+    {
+        glGenBuffers( READBACK_BUFFERS, ReadbackPBOs );
+        
+        for( int i = 0; i < READBACK_BUFFERS; i++ )
+        {
+            glBindBuffer( GL_PIXEL_PACK_BUFFER, ReadbackPBOs[ i ] );
+            glBufferData( GL_PIXEL_PACK_BUFFER, FrameBytes, nullptr, GL_STREAM_READ );
+            ReadbackFences[ i ] = nullptr;
+            ReadbackStates[ i ] = ReadbackBufferStates::Free;
+            ReadbackFrames[ i ] = 0;
+            ReadbackFrameNumbers[ i ] = 0;
+        }
+        
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+    }
+    
+    else
+    {
+        LOG( "WARNING: Pixel buffer objects are not available, framebuffer reads will be synchronous" );
+        ReadbackStaging.resize( FrameBytes );
+    }
+    
+    ReadbackPixels.resize( Constants::ScreenPixels );
+    NextReadbackBuffer = 0;
+    MappedReadbackBuffer = -1;
+    ReadbackFrameCounter = 0;
+    DroppedReadbackFrames = 0;
+    
+    // start the readback thread
+    ReadbackSemaphore = SDL_CreateSemaphore( 0 );
+    
+    if( !ReadbackSemaphore )
+      THROW( "Cannot create semaphore for readback thread" );
+      
+    SDL_AtomicSet( &ReadbackSourceInUse, 0 );
+    SDL_AtomicSet( &ReadbackThreadBusy, 0 );
+    ReadbackExitFlag = false;
+    ReadbackThread = SDL_CreateThread( FramebufferReadbackThread, "FramebufferReadback", this );
+    
+    if( !ReadbackThread )
+      THROW( string("Cannot create readback thread: ") + SDL_GetError() );
+      
+    ReadbackEnabled = true;
+    LOG( "Framebuffer readback enabled" << (ReadbackUsesPBOs? (FenceSync? "" : " (no fences)") : " (synchronous)") << (ReadbackDropsFrames? "" : " (all frames)") );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::DisableReadback()
+{
+    if( !ReadbackEnabled )
+      return;
+      
+    // when all frames are needed, deliver any
+    // pending reads in order, from the oldest
+    if( ReadbackUsesPBOs && !ReadbackDropsFrames )
+      for( int i = 0; i < READBACK_BUFFERS; i++ )
+        WaitForReadbackBuffer( (NextReadbackBuffer + i) % READBACK_BUFFERS );
+        
+    // the thread will first complete any frame it has
+    ReadbackExitFlag = true;
+    SDL_SemPost( ReadbackSemaphore );
+    SDL_WaitThread( ReadbackThread, nullptr );
+    SDL_DestroySemaphore( ReadbackSemaphore );
+    ReadbackThread = nullptr;
+    ReadbackSemaphore = nullptr;
+    ReadbackExitFlag = false;
+    
+    // the thread has ended, so no source can be in use;
+    // a buffer still mapped must be unmapped before deleting
+    SDL_AtomicSet( &ReadbackSourceInUse, 0 );
+    ReadbackSource = nullptr;
+    
+    // now all buffers can be released
+    if( ReadbackUsesPBOs )
+    {
+        if( MappedReadbackBuffer >= 0 )
+        {
+            glBindBuffer( GL_PIXEL_PACK_BUFFER, ReadbackPBOs[ MappedReadbackBuffer ] );
+            glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+            glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+            
+            ReadbackStates[ MappedReadbackBuffer ] = ReadbackBufferStates::Free;
+            MappedReadbackBuffer = -1;
+        }
+        
+        // reads never delivered still have their fences
+        for( int i = 0; i < READBACK_BUFFERS; i++ )
+        {
+            if( ReadbackFences[ i ] )
+              DeleteSync( ReadbackFences[ i ] );
+              
+            ReadbackFences[ i ] = nullptr;
+        }
+        
+        glDeleteBuffers( READBACK_BUFFERS, ReadbackPBOs );
+        memset( ReadbackPBOs, 0, sizeof( ReadbackPBOs ) );
+    }
+    
+    ReadbackEnabled = false;
+    
+    if( DroppedReadbackFrames > 0 )
+      LOG( "Framebuffer readback dropped " << DroppedReadbackFrames << " of " << ReadbackFrameCounter << " frames" );
+}
+
+// -----------------------------------------------------------------------------
+
+// a read is complete when its fence is signaled;
+// without fences we rely on it being old enough
+bool OpenGL2DContext::ReadbackIsComplete( int Buffer, uint64_t ReadNumber )
+{
+    if( !ReadbackFences[ Buffer ] )
+      return (ReadbackFrames[ Buffer ] + READBACK_LATENCY <= ReadNumber);
+      
+    GLenum Status = ClientWaitSync( ReadbackFences[ Buffer ], 0, 0 );
+    return (Status == GL_ALREADY_SIGNALED || Status == GL_CONDITION_SATISFIED);
+}
+
+// -----------------------------------------------------------------------------
+
+// unmaps the buffer given to the readback thread,
+// but only once the thread has finished copying it
+void OpenGL2DContext::ReleaseMappedReadback()
+{
+    if( MappedReadbackBuffer < 0 )
+      return;
+      
+    if( SDL_AtomicGet( &ReadbackSourceInUse ) )
+      return;
+      
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, ReadbackPBOs[ MappedReadbackBuffer ] );
+    glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+    
+    ReadbackStates[ MappedReadbackBuffer ] = ReadbackBufferStates::Free;
+    MappedReadbackBuffer = -1;
+}
+
+// -----------------------------------------------------------------------------
+
+// gives a pending read to the readback thread; if the
+// read is not complete yet, mapping it will wait for it
+void OpenGL2DContext::MapReadback( int Buffer )
+{
+    if( ReadbackFences[ Buffer ] )
+    {
+        DeleteSync( ReadbackFences[ Buffer ] );
+        ReadbackFences[ Buffer ] = nullptr;
+    }
+    
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, ReadbackPBOs[ Buffer ] );
+    void* Pixels = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, 4 * Constants::ScreenPixels, GL_MAP_READ_BIT );
+    
+    if( Pixels )
+    {
+        ReadbackStates[ Buffer ] = ReadbackBufferStates::Mapped;
+        MappedReadbackBuffer = Buffer;
+        PostReadbackToThread( (const uint8_t*)Pixels, ReadbackFrameNumbers[ Buffer ] );
+    }
+    
+    else
+    {
+        ReadbackStates[ Buffer ] = ReadbackBufferStates::Free;
+        DroppedReadbackFrames++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// When all frames are needed and the ring is full, the
+// next buffer holds the oldest read, which has to be
+// delivered before the buffer is reused. Only that read
+// is waited for, so newer ones stay queued in the GPU
+void OpenGL2DContext::WaitForReadbackBuffer( int Buffer )
+{
+    if( ReadbackStates[ Buffer ] == ReadbackBufferStates::Pending )
+    {
+        // the thread must be free to receive it, and
+        // then the buffer it copied can be released
+        while( SDL_AtomicGet( &ReadbackThreadBusy ) )
+          SDL_Delay( 0 );
+          
+        ReleaseMappedReadback();
+        
+        if( ReadbackFences[ Buffer ] )
+          ClientWaitSync( ReadbackFences[ Buffer ], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED );
+          
+        MapReadback( Buffer );
+    }
+    
+    // a mapped buffer is reusable once copied
+    while( SDL_AtomicGet( &ReadbackSourceInUse ) )
+      SDL_Delay( 0 );
+      
+    ReleaseMappedReadback();
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::PostReadbackToThread( const uint8_t* Source, uint64_t FrameNumber )
+{
+    ReadbackSource = Source;
+    ReadbackSourceFrame = FrameNumber;
+    SDL_AtomicSet( &ReadbackSourceInUse, 1 );
+    SDL_AtomicSet( &ReadbackThreadBusy, 1 );
+    SDL_SemPost( ReadbackSemaphore );
+}
+
+// -----------------------------------------------------------------------------
+
+// Call once per frame after it has been drawn. Normally this
+// never waits for the GPU or the readback thread: when either
+// of them is not ready the frame is dropped instead. But if
+// a consumer needs all frames it waits, though only when all
+// buffers are in use (or when reads are synchronous).
+// The frame number is only passed on to the consumers
+void OpenGL2DContext::ReadFramebufferAsync( uint64_t FrameNumber )
+{
+    if( !ReadbackEnabled )
+      return;
+      
+    uint64_t ReadNumber = ReadbackFrameCounter++;
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, FramebufferID );
+    
+    // without PBOs we can only read synchronously
+    if( !ReadbackUsesPBOs )
+    {
+        if( ReadbackDropsFrames && SDL_AtomicGet( &ReadbackThreadBusy ) )
+        {
+            DroppedReadbackFrames++;
+            return;
+        }
+        
+        // the staging buffer can only be reused
+        // once the thread has finished with it
+        while( SDL_AtomicGet( &ReadbackThreadBusy ) )
+          SDL_Delay( 0 );
+          
+        glReadPixels( 0, 0, Constants::ScreenWidth, Constants::ScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, &ReadbackStaging[ 0 ] );
+        PostReadbackToThread( &ReadbackStaging[ 0 ], FrameNumber );
+        return;
+    }
+    
+    // (1) recycle the buffer that was copied
+    ReleaseMappedReadback();
+    
+    // (2) start reading this frame into the next buffer;
+    // the read only gets queued, it does not wait
+    int Buffer = NextReadbackBuffer;
+    
+    if( !ReadbackDropsFrames && ReadbackStates[ Buffer ] != ReadbackBufferStates::Free )
+      WaitForReadbackBuffer( Buffer );
+      
+    if( ReadbackStates[ Buffer ] == ReadbackBufferStates::Mapped )
+      DroppedReadbackFrames++;
+      
+    else
+    {
+        // a pending read that was never used gets replaced
+        if( ReadbackStates[ Buffer ] == ReadbackBufferStates::Pending )
+        {
+            DroppedReadbackFrames++;
+            
+            if( ReadbackFences[ Buffer ] )
+              DeleteSync( ReadbackFences[ Buffer ] );
+              
+            ReadbackFences[ Buffer ] = nullptr;
+        }
+        
+        glBindBuffer( GL_PIXEL_PACK_BUFFER, ReadbackPBOs[ Buffer ] );
+        glReadPixels( 0, 0, Constants::ScreenWidth, Constants::ScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+        
+        if( FenceSync )
+          ReadbackFences[ Buffer ] = FenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+          
+        ReadbackStates[ Buffer ] = ReadbackBufferStates::Pending;
+        ReadbackFrames[ Buffer ] = ReadNumber;
+        ReadbackFrameNumbers[ Buffer ] = FrameNumber;
+        NextReadbackBuffer = (Buffer + 1) % READBACK_BUFFERS;
+    }
+    
+    // (3) if the thread is free, give it the oldest
+    // read, but only once that read is completed
+    if( MappedReadbackBuffer < 0 && !SDL_AtomicGet( &ReadbackThreadBusy ) )
+    {
+        int OldestBuffer = -1;
+        
+        for( int i = 0; i < READBACK_BUFFERS; i++ )
+        {
+            if( ReadbackStates[ i ] != ReadbackBufferStates::Pending ) continue;
+            
+            if( OldestBuffer < 0 || ReadbackFrames[ i ] < ReadbackFrames[ OldestBuffer ] )
+              OldestBuffer = i;
+        }
+        
+        if( OldestBuffer >= 0 && ReadbackIsComplete( OldestBuffer, ReadNumber ) )
+          MapReadback( OldestBuffer );
+    }
+    
+    glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+}
+
+
+// =============================================================================
+//      OPENGL 2D CONTEXT: GPU TIMING
+// =============================================================================
+
+
+// GLES drivers only have the extension names, and then
+// results can be invalid if the GPU had a disjoint event
+// (such as a frequency change) while they were measured
+void OpenGL2DContext::LoadTimerQueryFunctions( GLADloadproc Loader )
+{
+    GenQueries = (GenQueriesFunction)Loader( "glGenQueries" );
+    DeleteQueries = (DeleteQueriesFunction)Loader( "glDeleteQueries" );
+    BeginQuery = (BeginQueryFunction)Loader( "glBeginQuery" );
+    EndQuery = (EndQueryFunction)Loader( "glEndQuery" );
+    GetQueryObjectuiv = (GetQueryObjectuivFunction)Loader( "glGetQueryObjectuiv" );
+    GetQueryObjectui64v = (GetQueryObjectui64vFunction)Loader( "glGetQueryObjectui64v" );
+    TimingNeedsDisjointCheck = false;
+    
+    if( !GenQueries || !GetQueryObjectui64v )
+    {
+        GenQueries = (GenQueriesFunction)Loader( "glGenQueriesEXT" );
+        DeleteQueries = (DeleteQueriesFunction)Loader( "glDeleteQueriesEXT" );
+        BeginQuery = (BeginQueryFunction)Loader( "glBeginQueryEXT" );
+        EndQuery = (EndQueryFunction)Loader( "glEndQueryEXT" );
+        GetQueryObjectuiv = (GetQueryObjectuivFunction)Loader( "glGetQueryObjectuivEXT" );
+        GetQueryObjectui64v = (GetQueryObjectui64vFunction)Loader( "glGetQueryObjectui64vEXT" );
+        TimingNeedsDisjointCheck = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// must be called with the GL context already created
+void OpenGL2DContext::EnableGPUTiming()
+{
+    if( GPUTimingEnabled )
+      return;
+      
+    if( !GenQueries || !DeleteQueries || !BeginQuery || !EndQuery || !GetQueryObjectuiv || !GetQueryObjectui64v )
+    {
+        LOG( "GPU timing is not supported" );
+        return;
+    }
+    
+    // loaders can give functions the driver does not
+    // support, so check that a time query actually works
+    ClearOpenGLErrors();
+    GenQueries( GPU_TIMING_FRAMES * (int)GPUTimedPhases::Count, &TimingQueries[ 0 ][ 0 ] );
+    BeginQuery( GL_TIME_ELAPSED, TimingQueries[ 0 ][ 0 ] );
+    EndQuery( GL_TIME_ELAPSED );
+    
+    if( glGetError() != GL_NO_ERROR )
+    {
+        LOG( "GPU timing is not supported" );
+        DeleteQueries( GPU_TIMING_FRAMES * (int)GPUTimedPhases::Count, &TimingQueries[ 0 ][ 0 ] );
+        ClearOpenGLErrors();
+        return;
+    }
+    
+    memset( TimingQueryIssued, 0, sizeof( TimingQueryIssued ) );
+    memset( AccumulatedGPUTimes, 0, sizeof( AccumulatedGPUTimes ) );
+    memset( AverageGPUTimes, 0, sizeof( AverageGPUTimes ) );
+    AccumulatedTimingFrames = 0;
+    DiscardedTimingFrames = 0;
+    TimingFrame = 0;
+    ActiveTimedPhase = -1;
+    
+    GPUTimingEnabled = true;
+    LOG( "GPU timing enabled" );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::DisableGPUTiming()
+{
+    if( !GPUTimingEnabled )
+      return;
+      
+    EndTimedPhase();
+    DeleteQueries( GPU_TIMING_FRAMES * (int)GPUTimedPhases::Count, &TimingQueries[ 0 ][ 0 ] );
+    GPUTimingEnabled = false;
+}
+
+// -----------------------------------------------------------------------------
+
+// only one phase can be measured at a time,
+// so any previous phase ends automatically
+void OpenGL2DContext::BeginTimedPhase( GPUTimedPhases Phase )
+{
+    if( !GPUTimingEnabled )
+      return;
+      
+    EndTimedPhase();
+    
+    BeginQuery( GL_TIME_ELAPSED, TimingQueries[ TimingFrame ][ (int)Phase ] );
+    TimingQueryIssued[ TimingFrame ][ (int)Phase ] = true;
+    ActiveTimedPhase = (int)Phase;
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenGL2DContext::EndTimedPhase()
+{
+    if( !GPUTimingEnabled || ActiveTimedPhase < 0 )
+      return;
+      
+    EndQuery( GL_TIME_ELAPSED );
+    ActiveTimedPhase = -1;
+}
+
+// -----------------------------------------------------------------------------
+
+// called once per shown frame; returns true
+// when new average times are available
+bool OpenGL2DContext::FinishTimedFrame()
+{
+    if( !GPUTimingEnabled )
+      return false;
+      
+    EndTimedPhase();
+    
+    // the next slot holds the oldest results
+    TimingFrame = (TimingFrame + 1) % GPU_TIMING_FRAMES;
+    CollectTimingResults( TimingFrame );
+    
+    if( AccumulatedTimingFrames + DiscardedTimingFrames < GPU_TIMING_REPORT_FRAMES )
+      return false;
+      
+    for( int Phase = 0; Phase < (int)GPUTimedPhases::Count; Phase++ )
+    {
+        AverageGPUTimes[ Phase ] = AccumulatedGPUTimes[ Phase ] / max( 1u, AccumulatedTimingFrames );
+        AccumulatedGPUTimes[ Phase ] = 0;
+    }
+    
+    if( DiscardedTimingFrames > 0 )
+      LOG( "GPU timing: " << DiscardedTimingFrames << " frames could not be measured" );
+      
+    AccumulatedTimingFrames = 0;
+    DiscardedTimingFrames = 0;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// results that are still not available are
+// discarded, instead of waiting for them
+void OpenGL2DContext::CollectTimingResults( int FrameSlot )
+{
+    bool AnyIssued = false;
+    bool AllAvailable = true;
+    
+    for( int Phase = 0; Phase < (int)GPUTimedPhases::Count; Phase++ )
+      if( TimingQueryIssued[ FrameSlot ][ Phase ] )
+      {
+          GLuint Available = 0;
+          GetQueryObjectuiv( TimingQueries[ FrameSlot ][ Phase ], GL_QUERY_RESULT_AVAILABLE, &Available );
+          AnyIssued = true;
+          AllAvailable = AllAvailable && Available;
+      }
+      
+    if( !AnyIssued )
+      return;
+      
+    bool Disjoint = false;
+    
+    if( TimingNeedsDisjointCheck )
+    {
+        GLint DisjointValue = 0;
+        glGetIntegerv( GL_GPU_DISJOINT_EXT, &DisjointValue );
+        Disjoint = (DisjointValue != 0);
+    }
+    
+    // some drivers give wrong results for their first
+    // queries, so a phase cannot take over a second
+    uint64_t Nanoseconds[ (int)GPUTimedPhases::Count ] = { 0 };
+    bool ValidResults = AllAvailable && !Disjoint;
+    
+    for( int Phase = 0; Phase < (int)GPUTimedPhases::Count && ValidResults; Phase++ )
+      if( TimingQueryIssued[ FrameSlot ][ Phase ] )
+      {
+          GetQueryObjectui64v( TimingQueries[ FrameSlot ][ Phase ], GL_QUERY_RESULT, &Nanoseconds[ Phase ] );
+          ValidResults = (Nanoseconds[ Phase ] < 1000000000);
+      }
+      
+    if( ValidResults )
+    {
+        for( int Phase = 0; Phase < (int)GPUTimedPhases::Count; Phase++ )
+          AccumulatedGPUTimes[ Phase ] += Nanoseconds[ Phase ] / 1000000.0;
+          
+        AccumulatedTimingFrames++;
+    }
+    
+    else DiscardedTimingFrames++;
+    
+    for( int Phase = 0; Phase < (int)GPUTimedPhases::Count; Phase++ )
+      TimingQueryIssued[ FrameSlot ][ Phase ] = false;
+}
+
 
 // =============================================================================
 //      OPENGL 2D CONTEXT: COLOR FUNCTIONS
@@ -10,6 +10,12 @@
     // include project headers
     #include "Definitions.hpp"
     #include "Matrix4D.hpp"
+    #include "Render2DInterface.hpp"
+    #include "FrameConsumerInterface.hpp"
+    
+    // include C/C++ headers
+    #include <vector>           // [ C++ STL ] Vectors
+    #include <string>           // [ C++ STL ] Strings
     
     // include SDL2 headers
     #define SDL_MAIN_HANDLED
@@ -22,15 +28,156 @@
     
     // include OpenGL headers
     #include <glad/glad.h>      // [ OpenGL ] GLAD Loader (already includes <GL/gl.h>)
+    
+    // include EGL headers, for contexts with no window
+    #if defined(ENABLE_HEADLESS_GL)
+      #include <EGL/egl.h>      // [ EGL ] Main header
+      #include <EGL/eglext.h>   // [ EGL ] Extensions
+    #endif
 // *****************************************************************************
 
 
+// =============================================================================
+//      DEFINITIONS FOR FRAMEBUFFER READBACK
+// =============================================================================
+
+
+// Reading the framebuffer is done through a ring of pixel
+// buffer objects so that the GPU pipeline never stalls.
+// Each read is mapped once its fence shows it completed;
+// without fences, only when it is this many frames old,
+// so by then the GPU has normally completed it
+#define READBACK_BUFFERS  3
+#define READBACK_LATENCY  2
+
+// Fences need GL 3.2, ARB_sync or GLES 3.0, which
+// our GLAD loader does not include, so these
+// functions are also loaded on our own
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+  #define GL_SYNC_GPU_COMMANDS_COMPLETE     0x9117
+  #define GL_SYNC_FLUSH_COMMANDS_BIT        0x00000001
+  #define GL_ALREADY_SIGNALED               0x911A
+  #define GL_CONDITION_SATISFIED            0x911C
+  #define GL_TIMEOUT_IGNORED                0xFFFFFFFFFFFFFFFFull
+#endif
+
+typedef GLsync (APIENTRYP FenceSyncFunction)( GLenum Condition, GLbitfield Flags );
+typedef GLenum (APIENTRYP ClientWaitSyncFunction)( GLsync Sync, GLbitfield Flags, uint64_t Timeout );
+typedef void (APIENTRYP DeleteSyncFunction)( GLsync Sync );
+
+// -----------------------------------------------------------------------------
+
+enum class ReadbackBufferStates
+{
+    Free,       // can receive a new read
+    Pending,    // read was issued, result not used yet
+    Mapped      // being copied by the readback thread
+};
+
+
+// =============================================================================
+//      DEFINITIONS FOR SHADER PROGRAM CACHE
+// =============================================================================
+
+
+// Linked shader programs can be saved by the driver as
+// binaries, and loading them back is much faster than
+// compiling. This is not part of GL 3.0 or GLES 2.0 (it
+// needs GL 4.1, ARB_get_program_binary or the GLES OES
+// extension) so these functions are loaded on our own
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT  0x8257
+#define GL_PROGRAM_BINARY_LENGTH            0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS       0x87FE
+
+typedef void (APIENTRYP GetProgramBinaryFunction)( GLuint Program, GLsizei BufferSize, GLsizei* Length, GLenum* Format, void* Binary );
+typedef void (APIENTRYP ProgramBinaryFunction)( GLuint Program, GLenum Format, const void* Binary, GLsizei Length );
+typedef void (APIENTRYP ProgramParameteriFunction)( GLuint Program, GLenum Name, GLint Value );
+
+// -----------------------------------------------------------------------------
+
+// The cache file has this header, followed by the entries.
+// All entries are discarded if the graphics driver changes
+#define SHADER_CACHE_SIGNATURE  "V32SHCAC"
+#define SHADER_CACHE_VERSION    1
+
+typedef struct
+{
+    char Signature[ 8 ];
+    uint32_t Version;
+    uint32_t NumberOfEntries;
+    uint64_t DriverHash;
+}
+ShaderCacheHeader;
+
+// -----------------------------------------------------------------------------
+
+// each entry is followed by the program binary
+typedef struct
+{
+    uint64_t SourceHash;
+    uint32_t BinaryFormat;
+    uint32_t BinaryLength;
+}
+ShaderCacheEntry;
+
+
+// =============================================================================
+//      DEFINITIONS FOR GPU TIMING
+// =============================================================================
+
+
+// Each timed phase of a frame is measured with a query,
+// and results are read when the same query is reused
+// this many frames later, so we never wait for the GPU
+#define GPU_TIMING_FRAMES          4
+#define GPU_TIMING_REPORT_FRAMES 300   // averages are given every 5 seconds
+
+// -----------------------------------------------------------------------------
+
+enum class GPUTimedPhases
+{
+    EmulatorDrawing,    // emulated GPU draws into the framebuffer
+    ScreenDrawing,      // framebuffer drawn on the window
+    BufferSwap,         // window buffers are swapped
+    Count
+};
+
+// -----------------------------------------------------------------------------
+
+// Timer queries need GL 3.3, ARB_timer_query, or the GLES
+// extension EXT_disjoint_timer_query, so these functions
+// are also loaded on our own
+#ifndef GL_QUERY_RESULT
+  #define GL_QUERY_RESULT                   0x8866
+  #define GL_QUERY_RESULT_AVAILABLE         0x8867
+#endif
+
+#define GL_TIME_ELAPSED                     0x88BF
+#define GL_GPU_DISJOINT_EXT                 0x8FBB
+
+typedef void (APIENTRYP GenQueriesFunction)( GLsizei Number, GLuint* IDs );
+typedef void (APIENTRYP DeleteQueriesFunction)( GLsizei Number, const GLuint* IDs );
+typedef void (APIENTRYP BeginQueryFunction)( GLenum Target, GLuint ID );
+typedef void (APIENTRYP EndQueryFunction)( GLenum Target );
+typedef void (APIENTRYP GetQueryObjectuivFunction)( GLuint ID, GLenum Name, GLuint* Value );
+typedef void (APIENTRYP GetQueryObjectui64vFunction)( GLuint ID, GLenum Name, uint64_t* Value );
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE CONTEXT
+// =============================================================================
+
+
+// thread function that delivers read frames to consumers
+int FramebufferReadbackThread( void* Parameters );
+
+
 // =============================================================================
 //      2D-SPECIALIZED OPENGL CONTEXT
 // =============================================================================
 
 
-class OpenGL2DContext
+class OpenGL2DContext: public Render2DInterface
 {
     public:
         
@@ -44,11 +191,26 @@ class OpenGL2DContext
         SDL_Window* Window;
         SDL_GLContext OpenGLContext;
         
+        // headless context objects (used instead of the above)
+        #if defined(ENABLE_HEADLESS_GL)
+          EGLDisplay HeadlessDisplay;
+          EGLContext HeadlessContext;
+        #endif
+        
         // framebuffer object
         GLuint FramebufferID;
         GLuint FBColorTextureID;
         unsigned FramebufferWidth;
         unsigned FramebufferHeight;
+        
+        // staging buffer to convert software
+        // framebuffers to RGB before uploading
+        std::vector< uint8_t > UploadPixels;
+        
+        // second framebuffer used for speculative frames;
+        // both are swapped so the other keeps the contents
+        GLuint SpeculativeFramebufferID;
+        GLuint SpeculativeColorTextureID;
 
         // additional GL objects
         GLuint VAO;
@@ -77,14 +239,99 @@ class OpenGL2DContext
         // white texture used to draw solid colors
         GLuint WhiteTextureID;
         
+        // shader program cache (disabled if there is no
+        // path, or if the driver cannot provide binaries)
+        std::string ShaderCachePath;
+        GetProgramBinaryFunction GetProgramBinary;
+        ProgramBinaryFunction ProgramBinary;
+        ProgramParameteriFunction ProgramParameteri;
+        
+        // GPU timing of frame phases; each frame
+        // slot has a query for each phase
+        bool GPUTimingEnabled;
+        bool TimingNeedsDisjointCheck;
+        GLuint TimingQueries[ GPU_TIMING_FRAMES ][ (int)GPUTimedPhases::Count ];
+        bool TimingQueryIssued[ GPU_TIMING_FRAMES ][ (int)GPUTimedPhases::Count ];
+        int TimingFrame;
+        int ActiveTimedPhase;
+        double AccumulatedGPUTimes[ (int)GPUTimedPhases::Count ];
+        unsigned AccumulatedTimingFrames;
+        unsigned DiscardedTimingFrames;
+        float AverageGPUTimes[ (int)GPUTimedPhases::Count ];    // in milliseconds
+        GenQueriesFunction GenQueries;
+        DeleteQueriesFunction DeleteQueries;
+        BeginQueryFunction BeginQuery;
+        EndQueryFunction EndQuery;
+        GetQueryObjectuivFunction GetQueryObjectuiv;
+        GetQueryObjectui64vFunction GetQueryObjectui64v;
+        
+        // framebuffer readback (without PBO support, reads
+        // are synchronous into the staging buffer)
+        bool ReadbackEnabled;
+        bool ReadbackUsesPBOs;
+        bool ReadbackDropsFrames;
+        GLuint ReadbackPBOs[ READBACK_BUFFERS ];
+        GLsync ReadbackFences[ READBACK_BUFFERS ];
+        ReadbackBufferStates ReadbackStates[ READBACK_BUFFERS ];
+        uint64_t ReadbackFrames[ READBACK_BUFFERS ];
+        uint64_t ReadbackFrameNumbers[ READBACK_BUFFERS ];
+        int NextReadbackBuffer;
+        int MappedReadbackBuffer;
+        uint64_t ReadbackFrameCounter;
+        unsigned DroppedReadbackFrames;
+        std::vector< uint8_t > ReadbackStaging;
+        
+        // consumers can only be added or removed
+        // while readback is not enabled
+        std::vector< FrameConsumerInterface* > FrameConsumers;
+        
+        // variables for the readback thread
+        friend int FramebufferReadbackThread( void* );
+        SDL_Thread* ReadbackThread;
+        SDL_sem* ReadbackSemaphore;
+        SDL_atomic_t ReadbackSourceInUse;
+        SDL_atomic_t ReadbackThreadBusy;
+        bool ReadbackExitFlag;
+        const uint8_t* ReadbackSource;
+        uint64_t ReadbackSourceFrame;
+        std::vector< GPUColor > ReadbackPixels;
+        FenceSyncFunction FenceSync;
+        ClientWaitSyncFunction ClientWaitSync;
+        DeleteSyncFunction DeleteSync;
+        
+    private:
+    
+        // shader program cache
+        void LoadProgramBinaryFunctions( GLADloadproc Loader );
+        uint64_t GetDriverHash();
+        bool LoadCachedProgram( GLuint& ProgramID, uint64_t SourceHash );
+        void SaveCachedProgram( GLuint ProgramID, uint64_t SourceHash );
+        
+        // GPU timing
+        void LoadTimerQueryFunctions( GLADloadproc Loader );
+        void CollectTimingResults( int FrameSlot );
+        
+        // speculative drawing
+        void CreateSpeculativeFramebuffer();
+        void SwapFramebuffers();
+        
+        // readback steps
+        void LoadSyncFunctions( GLADloadproc Loader );
+        bool ReadbackIsComplete( int Buffer, uint64_t ReadNumber );
+        void ReleaseMappedReadback();
+        void MapReadback( int Buffer );
+        void WaitForReadbackBuffer( int Buffer );
+        void PostReadbackToThread( const uint8_t* Source, uint64_t FrameNumber );
+        
     public:
         
         // instance handling
         OpenGL2DContext();
-       ~OpenGL2DContext();
+        virtual ~OpenGL2DContext();
         
         // init functions
         void CreateOpenGLWindow();
+        void CreateHeadlessContext();
         void CreateFramebuffer();
         bool CompileShaderProgram();
         void CreateWhiteTexture();
@@ -97,26 +344,48 @@ class OpenGL2DContext
         void SetWindowZoom( int ZoomFactor );
         void SetFullScreen();
         
+        // handling textures
+        virtual unsigned CreateTexture( void* Pixels, unsigned Width, unsigned Height );
+        virtual void DestroyTexture( unsigned TextureID );
+        virtual void BindTexture( unsigned TextureID );
+        
         // framebuffer render functions
         void RenderToScreen();
-        void RenderToFramebuffer();
+        virtual void RenderToFramebuffer();
+        virtual void FinishFrame();
+        virtual void BeginSpeculativeDrawing();
+        virtual void EndSpeculativeDrawing();
         void DrawFramebufferOnScreen();
+        void UploadFramebuffer( const GPUColor* Pixels );
+        void ReadFramebuffer( GPUColor* Pixels );
+        
+        // framebuffer readback
+        void EnableReadback();
+        void DisableReadback();
+        void ReadFramebufferAsync( uint64_t FrameNumber );
+        
+        // GPU timing
+        void EnableGPUTiming();
+        void DisableGPUTiming();
+        void BeginTimedPhase( GPUTimedPhases Phase );
+        void EndTimedPhase();
+        bool FinishTimedFrame();
         
         // color functions
-        void SetMultiplyColor( GPUColor NewMultiplyColor );
-        void SetBlendingMode( IOPortValues BlendingMode );
+        virtual void SetMultiplyColor( GPUColor NewMultiplyColor );
+        virtual void SetBlendingMode( IOPortValues BlendingMode );
         
         // 2D transform functions
-        void SetTranslation( int TranslationX, int TranslationY );
-        void SetScale( float ScaleX, float ScaleY );
-        void SetRotation( float AngleZ );
-        void ComposeTransform( bool ScalingEnabled, bool RotationEnabled );
+        virtual void SetTranslation( int TranslationX, int TranslationY );
+        virtual void SetScale( float ScaleX, float ScaleY );
+        virtual void SetRotation( float AngleZ );
+        virtual void ComposeTransform( bool ScalingEnabled, bool RotationEnabled );
         
         // render functions
-        void SetQuadVertexPosition( int Vertex, int x, int y );
-        void SetQuadVertexTexCoords( int Vertex, float u, float v );
-        void DrawTexturedQuad();
-        void ClearScreen( GPUColor ClearColor );
+        virtual void SetQuadVertexPosition( int Vertex, int x, int y );
+        virtual void SetQuadVertexTexCoords( int Vertex, float u, float v );
+        virtual void DrawTexturedQuad();
+        virtual void ClearScreen( GPUColor ClearColor );
 };
 
 
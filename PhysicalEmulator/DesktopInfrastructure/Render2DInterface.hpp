@@ -0,0 +1,65 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef RENDER2DINTERFACE_HPP
+    #define RENDER2DINTERFACE_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    #include "../../VirconDefinitions/VirconEnumerations.hpp"
+// *****************************************************************************
+
+
+// =============================================================================
+//      COMMON INTERFACE FOR 2D RENDERERS
+// =============================================================================
+
+
+// The Vircon GPU only needs a small set of 2D operations
+// from the host. Any renderer able to perform them (the
+// OpenGL context, a software rasterizer, etc) can be
+// connected to the GPU through this interface
+class Render2DInterface
+{
+    public:
+    
+        // instance handling
+        virtual ~Render2DInterface() {}
+        
+        // handling textures
+        // (returned IDs are always non-zero)
+        virtual unsigned CreateTexture( void* Pixels, unsigned Width, unsigned Height ) = 0;
+        virtual void DestroyTexture( unsigned TextureID ) = 0;
+        virtual void BindTexture( unsigned TextureID ) = 0;
+        
+        // render target control
+        virtual void RenderToFramebuffer() = 0;
+        virtual void FinishFrame() = 0;
+        
+        // speculative frames are drawn on a copy of the
+        // framebuffer, which is shown until the end call
+        // discards it and restores the previous contents
+        virtual void BeginSpeculativeDrawing() = 0;
+        virtual void EndSpeculativeDrawing() = 0;
+        
+        // color functions
+        virtual void SetMultiplyColor( GPUColor NewMultiplyColor ) = 0;
+        virtual void SetBlendingMode( IOPortValues BlendingMode ) = 0;
+        
+        // 2D transform functions
+        virtual void SetTranslation( int TranslationX, int TranslationY ) = 0;
+        virtual void SetScale( float ScaleX, float ScaleY ) = 0;
+        virtual void SetRotation( float AngleZ ) = 0;
+        virtual void ComposeTransform( bool ScalingEnabled, bool RotationEnabled ) = 0;
+        
+        // render functions
+        virtual void SetQuadVertexPosition( int Vertex, int x, int y ) = 0;
+        virtual void SetQuadVertexTexCoords( int Vertex, float u, float v ) = 0;
+        virtual void DrawTexturedQuad() = 0;
+        virtual void ClearScreen( GPUColor ClearColor ) = 0;
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -0,0 +1,987 @@
+// *****************************************************************************
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    
+    // include project headers
+    #include "Software2DContext.hpp"
+    #include "LogStream.hpp"
+    
+    // include C/C++ headers
+    #include <cmath>            // [ ANSI C ] Mathematics
+    #include <cstring>          // [ ANSI C ] Strings
+    #include <algorithm>        // [ C++ STL ] Algorithms
+    
+    // choose the available SIMD instruction set
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+      #define SOFTWARE_RENDER_SSE2
+      #include <emmintrin.h>    // [ x86 ] SSE2 intrinsics
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+      #define SOFTWARE_RENDER_NEON
+      #include <arm_neon.h>     // [ ARM ] NEON intrinsics
+    #endif
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      AUXILIARY FUNCTIONS FOR PIXEL OPERATIONS
+// =============================================================================
+
+
+// pixels drawn beyond the loaded image are transparent
+const GPUColor TransparentPixel = { 0, 0, 0, 0 };
+
+// the framebuffer has no alpha channel (like the GL
+// framebuffer, which uses an RGB texture) so all its
+// pixels are always kept as fully opaque
+const uint32_t OpaqueAlphaMask = 0xFF000000;
+
+// -----------------------------------------------------------------------------
+
+// exact rounded division by 255 for values in [0, 255*255]
+inline unsigned Div255( unsigned Value )
+{
+    Value += 128;
+    return (Value + (Value >> 8)) >> 8;
+}
+
+// -----------------------------------------------------------------------------
+
+inline GPUColor FetchTexel( const SoftwareTexture& Texture, int TexelX, int TexelY )
+{
+    if( (unsigned)TexelX >= Texture.Width || (unsigned)TexelY >= Texture.Height )
+      return TransparentPixel;
+      
+    return Texture.Pixels[ TexelY * Texture.Width + TexelX ];
+}
+
+// -----------------------------------------------------------------------------
+
+// scalar version of the multiply + blend operation,
+// for pixels not covered by the SIMD versions
+inline void BlendPixel( GPUColor& Destination, GPUColor Source, GPUColor Multiplier, IOPortValues BlendingMode )
+{
+    // apply multiply color to the source
+    unsigned R = Div255( Source.R * Multiplier.R );
+    unsigned G = Div255( Source.G * Multiplier.G );
+    unsigned B = Div255( Source.B * Multiplier.B );
+    unsigned A = Div255( Source.A * Multiplier.A );
+    
+    // now blend it into the destination
+    switch( BlendingMode )
+    {
+        case IOPortValues::GPUBlendingMode_Add:
+            Destination.R = min( 255u, Destination.R + Div255( R * A ) );
+            Destination.G = min( 255u, Destination.G + Div255( G * A ) );
+            Destination.B = min( 255u, Destination.B + Div255( B * A ) );
+            break;
+            
+        case IOPortValues::GPUBlendingMode_Subtract:
+            Destination.R = max( 0, (int)Destination.R - (int)Div255( R * A ) );
+            Destination.G = max( 0, (int)Destination.G - (int)Div255( G * A ) );
+            Destination.B = max( 0, (int)Destination.B - (int)Div255( B * A ) );
+            break;
+            
+        default:
+            Destination.R = Div255( R * A + Destination.R * (255 - A) );
+            Destination.G = Div255( G * A + Destination.G * (255 - A) );
+            Destination.B = Div255( B * A + Destination.B * (255 - A) );
+            break;
+    }
+    
+    Destination.A = 255;
+}
+
+// -----------------------------------------------------------------------------
+
+// narrows the span of pixels [First,Last) to those where
+// the linear function Start + Step * x is within [0,1)
+void ClipSpan( float Start, float Step, int& First, int& Last )
+{
+    int BoxFirst = First;
+    int BoxLast = Last;
+    
+    // a constant function includes all or nothing
+    if( Step == 0 )
+    {
+        if( Start < 0 || Start >= 1 )
+          Last = First;
+          
+        return;
+    }
+    
+    // first estimate the bounds analytically
+    float Bound0 = (0 - Start) / Step;
+    float Bound1 = (1 - Start) / Step;
+    float LowerBound = (Step > 0? Bound0 : Bound1);
+    float UpperBound = (Step > 0? Bound1 : Bound0);
+    
+    Clamp( LowerBound, BoxFirst, BoxLast );
+    Clamp( UpperBound, BoxFirst, BoxLast );
+    First = (int)ceil( LowerBound );
+    Last  = (int)ceil( UpperBound );
+    
+    // then correct any rounding errors at both ends,
+    // using the same test applied for each pixel
+    auto IsInside = [ Start, Step ]( int x )
+    {
+        float Value = Start + Step * x;
+        return (Value >= 0 && Value < 1);
+    };
+    
+    while( First > BoxFirst && IsInside( First-1 ) ) First--;
+    while( First < Last && !IsInside( First ) ) First++;
+    while( Last < BoxLast && IsInside( Last ) ) Last++;
+    while( Last > First && !IsInside( Last-1 ) ) Last--;
+}
+
+
+// =============================================================================
+//      SIMD VERSIONS OF PIXEL OPERATIONS
+// =============================================================================
+
+
+#if defined(SOFTWARE_RENDER_SSE2)
+
+// exact rounded division by 255 for 8 16-bit values
+inline __m128i Div255_SSE2( __m128i Values )
+{
+    Values = _mm_add_epi16( Values, _mm_set1_epi16( 128 ) );
+    return _mm_mulhi_epu16( Values, _mm_set1_epi16( 257 ) );
+}
+
+// -----------------------------------------------------------------------------
+
+// replicates the alpha of 2 pixels, in 16-bit components
+inline __m128i BroadcastAlpha_SSE2( __m128i Pixels )
+{
+    Pixels = _mm_shufflelo_epi16( Pixels, _MM_SHUFFLE( 3,3,3,3 ) );
+    return _mm_shufflehi_epi16( Pixels, _MM_SHUFFLE( 3,3,3,3 ) );
+}
+
+// -----------------------------------------------------------------------------
+
+// multiplies and blends 4 pixels at once
+inline __m128i BlendPixels_SSE2( __m128i Destination, __m128i Source, __m128i Multiplier, IOPortValues BlendingMode )
+{
+    __m128i Zero = _mm_setzero_si128();
+    
+    // expand source to 16-bit components and apply multiply color
+    __m128i SourceLow  = _mm_unpacklo_epi8( Source, Zero );
+    __m128i SourceHigh = _mm_unpackhi_epi8( Source, Zero );
+    SourceLow  = Div255_SSE2( _mm_mullo_epi16( SourceLow,  Multiplier ) );
+    SourceHigh = Div255_SSE2( _mm_mullo_epi16( SourceHigh, Multiplier ) );
+    
+    // weight source colors by their alpha
+    __m128i AlphaLow  = BroadcastAlpha_SSE2( SourceLow  );
+    __m128i AlphaHigh = BroadcastAlpha_SSE2( SourceHigh );
+    __m128i WeightedLow  = _mm_mullo_epi16( SourceLow,  AlphaLow  );
+    __m128i WeightedHigh = _mm_mullo_epi16( SourceHigh, AlphaHigh );
+    __m128i Result;
+    
+    switch( BlendingMode )
+    {
+        case IOPortValues::GPUBlendingMode_Add:
+            Source = _mm_packus_epi16( Div255_SSE2( WeightedLow ), Div255_SSE2( WeightedHigh ) );
+            Result = _mm_adds_epu8( Destination, Source );
+            break;
+            
+        case IOPortValues::GPUBlendingMode_Subtract:
+            Source = _mm_packus_epi16( Div255_SSE2( WeightedLow ), Div255_SSE2( WeightedHigh ) );
+            Result = _mm_subs_epu8( Destination, Source );
+            break;
+            
+        default:
+        {
+            __m128i Max = _mm_set1_epi16( 255 );
+            __m128i DestinationLow  = _mm_unpacklo_epi8( Destination, Zero );
+            __m128i DestinationHigh = _mm_unpackhi_epi8( Destination, Zero );
+            DestinationLow  = _mm_mullo_epi16( DestinationLow,  _mm_sub_epi16( Max, AlphaLow  ) );
+            DestinationHigh = _mm_mullo_epi16( DestinationHigh, _mm_sub_epi16( Max, AlphaHigh ) );
+            
+            __m128i ResultLow  = Div255_SSE2( _mm_add_epi16( WeightedLow,  DestinationLow  ) );
+            __m128i ResultHigh = Div255_SSE2( _mm_add_epi16( WeightedHigh, DestinationHigh ) );
+            Result = _mm_packus_epi16( ResultLow, ResultHigh );
+            break;
+        }
+    }
+    
+    return _mm_or_si128( Result, _mm_set1_epi32( (int)OpaqueAlphaMask ) );
+}
+
+#elif defined(SOFTWARE_RENDER_NEON)
+
+// exact rounded division by 255 for 8 16-bit values
+inline uint8x8_t Div255_NEON( uint16x8_t Values )
+{
+    Values = vaddq_u16( Values, vdupq_n_u16( 128 ) );
+    return vshrn_n_u16( vsraq_n_u16( Values, Values, 8 ), 8 );
+}
+
+// -----------------------------------------------------------------------------
+
+// multiplies and blends 4 pixels at once
+inline uint8x16_t BlendPixels_NEON( uint8x16_t Destination, uint8x16_t Source, uint8x8_t Multiplier, IOPortValues BlendingMode )
+{
+    // apply multiply color to the source
+    uint8x8_t SourceLow  = Div255_NEON( vmull_u8( vget_low_u8 ( Source ), Multiplier ) );
+    uint8x8_t SourceHigh = Div255_NEON( vmull_u8( vget_high_u8( Source ), Multiplier ) );
+    Source = vcombine_u8( SourceLow, SourceHigh );
+    
+    // replicate the alpha of each pixel to all its components
+    uint32x4_t Alpha32 = vshrq_n_u32( vreinterpretq_u32_u8( Source ), 24 );
+    uint8x16_t Alpha = vreinterpretq_u8_u32( vmulq_n_u32( Alpha32, 0x01010101 ) );
+    
+    // weight source colors by their alpha
+    uint16x8_t WeightedLow  = vmull_u8( SourceLow,  vget_low_u8 ( Alpha ) );
+    uint16x8_t WeightedHigh = vmull_u8( SourceHigh, vget_high_u8( Alpha ) );
+    uint8x16_t Result;
+    
+    switch( BlendingMode )
+    {
+        case IOPortValues::GPUBlendingMode_Add:
+            Source = vcombine_u8( Div255_NEON( WeightedLow ), Div255_NEON( WeightedHigh ) );
+            Result = vqaddq_u8( Destination, Source );
+            break;
+            
+        case IOPortValues::GPUBlendingMode_Subtract:
+            Source = vcombine_u8( Div255_NEON( WeightedLow ), Div255_NEON( WeightedHigh ) );
+            Result = vqsubq_u8( Destination, Source );
+            break;
+            
+        default:
+        {
+            uint8x16_t InverseAlpha = vmvnq_u8( Alpha );
+            WeightedLow  = vmlal_u8( WeightedLow,  vget_low_u8 ( Destination ), vget_low_u8 ( InverseAlpha ) );
+            WeightedHigh = vmlal_u8( WeightedHigh, vget_high_u8( Destination ), vget_high_u8( InverseAlpha ) );
+            Result = vcombine_u8( Div255_NEON( WeightedLow ), Div255_NEON( WeightedHigh ) );
+            break;
+        }
+    }
+    
+    return vorrq_u8( Result, vreinterpretq_u8_u32( vdupq_n_u32( OpaqueAlphaMask ) ) );
+}
+
+#endif
+
+
+// =============================================================================
+//      RENDER WORKER THREADS
+// =============================================================================
+
+
+// Each worker waits until a frame is flushed, then takes
+// tiles from the shared counter until all are drawn. Since
+// every tile is only drawn by one thread and in command
+// order, results are the same as when drawing serially
+int SoftwareRenderThread( void* Parameters )
+{
+    Software2DContext* Context = (Software2DContext*)Parameters;
+    
+    while( true )
+    {
+        SDL_SemWait( Context->WorkStartSemaphore );
+        
+        if( Context->ThreadExitFlag )
+          break;
+          
+        Context->RasterizeTiles();
+        SDL_SemPost( Context->WorkEndSemaphore );
+    }
+    
+    return 0;
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: INSTANCE HANDLING
+// =============================================================================
+
+
+Software2DContext::Software2DContext()
+{
+    // start with a black screen
+    Framebuffer.resize( Constants::ScreenPixels, GPUColor{ 0, 0, 0, 255 } );
+    
+    // no texture is selected
+    BoundTextureIndex = -1;
+    
+    // initialize our render parameters to neutral
+    MultiplyColor = GPUColor{ 255, 255, 255, 255 };
+    BlendingMode = IOPortValues::GPUBlendingMode_Alpha;
+    memset( QuadPositionCoords, 0, sizeof( QuadPositionCoords ) );
+    memset( QuadTextureCoords, 0, sizeof( QuadTextureCoords ) );
+    
+    // by default, render in the calling thread
+    WorkStartSemaphore = nullptr;
+    WorkEndSemaphore = nullptr;
+    SDL_AtomicSet( &NextTile, 0 );
+    ThreadExitFlag = false;
+}
+
+// -----------------------------------------------------------------------------
+
+Software2DContext::~Software2DContext()
+{
+    // threads must have been stopped before SDL is
+    // closed, so here we can only check for that
+    if( !WorkerThreads.empty() )
+      LOG( "WARNING: Software renderer was destroyed with its worker threads still running" );
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: PARALLEL RENDERING
+// =============================================================================
+
+
+// The calling thread also draws tiles, so N worker
+// threads will allow up to N+1 tiles drawn at once.
+// With no workers, all drawing is done immediately
+void Software2DContext::StartWorkers( int NumberOfThreads )
+{
+    StopWorkers();
+    
+    Clamp( NumberOfThreads, 0, MAX_RENDER_THREADS );
+    
+    if( NumberOfThreads == 0 )
+      return;
+      
+    WorkStartSemaphore = SDL_CreateSemaphore( 0 );
+    WorkEndSemaphore = SDL_CreateSemaphore( 0 );
+    
+    if( !WorkStartSemaphore || !WorkEndSemaphore )
+      THROW( "Cannot create semaphores for render threads" );
+      
+    ThreadExitFlag = false;
+    
+    for( int i = 0; i < NumberOfThreads; i++ )
+    {
+        SDL_Thread* NewThread = SDL_CreateThread( SoftwareRenderThread, "RenderWorker", this );
+        
+        // if a thread fails we can still work with the rest
+        if( !NewThread )
+        {
+            LOG( "WARNING: Cannot create render thread: " << SDL_GetError() );
+            break;
+        }
+        
+        WorkerThreads.push_back( NewThread );
+    }
+    
+    LOG( "Software renderer using " << WorkerThreads.size() << " worker threads" );
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::StopWorkers()
+{
+    // draw anything that is still pending
+    FinishFrame();
+    
+    // wake all threads and wait for them to exit
+    ThreadExitFlag = true;
+    
+    for( unsigned i = 0; i < WorkerThreads.size(); i++ )
+      SDL_SemPost( WorkStartSemaphore );
+      
+    for( SDL_Thread* Thread: WorkerThreads )
+      SDL_WaitThread( Thread, nullptr );
+      
+    WorkerThreads.clear();
+    ThreadExitFlag = false;
+    
+    if( WorkStartSemaphore ) SDL_DestroySemaphore( WorkStartSemaphore );
+    if( WorkEndSemaphore ) SDL_DestroySemaphore( WorkEndSemaphore );
+    WorkStartSemaphore = nullptr;
+    WorkEndSemaphore = nullptr;
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: HANDLING TEXTURES
+// =============================================================================
+
+
+unsigned Software2DContext::CreateTexture( void* Pixels, unsigned Width, unsigned Height )
+{
+    // check for size limits
+    if( (int)Width > Constants::GPUTextureSize || (int)Height > Constants::GPUTextureSize )
+      THROW( "Loaded image is too large to fit in a GPU texture" );
+      
+    // pending commands may refer to textures
+    // that are about to move in memory
+    FinishFrame();
+    
+    // reuse the first free position, if any
+    unsigned Position = 0;
+    
+    while( Position < Textures.size() && Textures[ Position ].InUse )
+      Position++;
+      
+    if( Position == Textures.size() )
+      Textures.emplace_back();
+      
+    // copy the image
+    SoftwareTexture& NewTexture = Textures[ Position ];
+    NewTexture.InUse = true;
+    NewTexture.Width = Width;
+    NewTexture.Height = Height;
+    
+    GPUColor* FirstPixel = (GPUColor*)Pixels;
+    NewTexture.Pixels.assign( FirstPixel, FirstPixel + Width * Height );
+    
+    return Position + 1;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::DestroyTexture( unsigned TextureID )
+{
+    if( TextureID == 0 || TextureID > Textures.size() )
+      return;
+      
+    // pending commands may still use this texture
+    FinishFrame();
+    
+    SoftwareTexture& DestroyedTexture = Textures[ TextureID - 1 ];
+    DestroyedTexture.InUse = false;
+    DestroyedTexture.Width = 0;
+    DestroyedTexture.Height = 0;
+    vector< GPUColor >().swap( DestroyedTexture.Pixels );
+    
+    if( BoundTextureIndex == (int)TextureID - 1 )
+      BoundTextureIndex = -1;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::BindTexture( unsigned TextureID )
+{
+    if( TextureID == 0 || TextureID > Textures.size() )
+      BoundTextureIndex = -1;
+    else
+      BoundTextureIndex = TextureID - 1;
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: RENDER TARGET CONTROL
+// =============================================================================
+
+
+void Software2DContext::RenderToFramebuffer()
+{
+    // our only render target is the framebuffer,
+    // so we only need to reset transforms
+    TransformMatrix.LoadIdentity();
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::BeginSpeculativeDrawing()
+{
+    FinishFrame();
+    SavedFramebuffer = Framebuffer;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::EndSpeculativeDrawing()
+{
+    FinishFrame();
+    Framebuffer.swap( SavedFramebuffer );
+}
+
+// -----------------------------------------------------------------------------
+
+// draws all commands binned since the last call
+void Software2DContext::FinishFrame()
+{
+    if( FrameCommands.empty() )
+      return;
+      
+    // start all workers and also draw from this thread
+    SDL_AtomicSet( &NextTile, 0 );
+    
+    for( unsigned i = 0; i < WorkerThreads.size(); i++ )
+      SDL_SemPost( WorkStartSemaphore );
+      
+    RasterizeTiles();
+    
+    for( unsigned i = 0; i < WorkerThreads.size(); i++ )
+      SDL_SemWait( WorkEndSemaphore );
+      
+    // empty all lists, but keep their memory
+    FrameCommands.clear();
+    
+    for( vector< int >& CommandList: TileCommands )
+      CommandList.clear();
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: COLOR FUNCTIONS
+// =============================================================================
+
+
+void Software2DContext::SetMultiplyColor( GPUColor NewMultiplyColor )
+{
+    MultiplyColor = NewMultiplyColor;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::SetBlendingMode( IOPortValues NewBlendingMode )
+{
+    switch( NewBlendingMode )
+    {
+        case IOPortValues::GPUBlendingMode_Alpha:
+        case IOPortValues::GPUBlendingMode_Add:
+        case IOPortValues::GPUBlendingMode_Subtract:
+            BlendingMode = NewBlendingMode;
+            break;
+            
+        default:
+            // ignore invalid values
+            break;
+    }
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: 2D TRANSFORM FUNCTIONS
+// =============================================================================
+
+
+void Software2DContext::SetTranslation( int TranslationX, int TranslationY )
+{
+    TranslationMatrix.LoadIdentity();
+    TranslationMatrix.Components[ 0 ][ 3 ] = TranslationX;
+    TranslationMatrix.Components[ 1 ][ 3 ] = TranslationY;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::SetScale( float ScaleX, float ScaleY )
+{
+    ScalingMatrix.LoadIdentity();
+    ScalingMatrix.Components[ 0 ][ 0 ] = ScaleX;
+    ScalingMatrix.Components[ 1 ][ 1 ] = ScaleY;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::SetRotation( float AngleZ )
+{
+    RotationMatrix.LoadIdentity();
+    RotationMatrix.Components[ 0 ][ 0 ] =  cos( AngleZ );
+    RotationMatrix.Components[ 0 ][ 1 ] = -sin( AngleZ );
+    RotationMatrix.Components[ 1 ][ 0 ] =  sin( AngleZ );
+    RotationMatrix.Components[ 1 ][ 1 ] =  cos( AngleZ );
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::ComposeTransform( bool ScalingEnabled, bool RotationEnabled )
+{
+    TransformMatrix = TranslationMatrix;
+    if( RotationEnabled ) TransformMatrix *= RotationMatrix;
+    if( ScalingEnabled  ) TransformMatrix *= ScalingMatrix;
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: SPAN OPERATIONS
+// =============================================================================
+
+
+// obtains texels with nearest neighbour sampling along a
+// line of pixels, with texture coordinates given in texels;
+// coordinates are always computed from the line start, so
+// the result for a pixel is the same for any span containing it
+void Software2DContext::SampleSpan( const SoftwareTexture& Texture, float TexelX, float TexelY, float StepX, float StepY, int FirstPixel, int Pixels, GPUColor* Texels )
+{
+    // out-of-texture coordinates must clamp, not wrap
+    const float MaxCoordinate = Constants::GPUTextureSize - 1;
+    int i = 0;
+    
+    #if defined(SOFTWARE_RENDER_SSE2)
+    
+      __m128 Offsets = _mm_set_ps( 3, 2, 1, 0 );
+      __m128 Zero = _mm_setzero_ps();
+      __m128 Max = _mm_set1_ps( MaxCoordinate );
+      int32_t CoordinatesX[ 4 ], CoordinatesY[ 4 ];
+      
+      for( ; i + 4 <= Pixels; i += 4 )
+      {
+          __m128 Positions = _mm_add_ps( _mm_set1_ps( (float)(FirstPixel + i) ), Offsets );
+          __m128 X = _mm_add_ps( _mm_set1_ps( TexelX ), _mm_mul_ps( Positions, _mm_set1_ps( StepX ) ) );
+          __m128 Y = _mm_add_ps( _mm_set1_ps( TexelY ), _mm_mul_ps( Positions, _mm_set1_ps( StepY ) ) );
+          
+          // after clamping, truncation is the same as floor
+          X = _mm_min_ps( _mm_max_ps( X, Zero ), Max );
+          Y = _mm_min_ps( _mm_max_ps( Y, Zero ), Max );
+          _mm_storeu_si128( (__m128i*)CoordinatesX, _mm_cvttps_epi32( X ) );
+          _mm_storeu_si128( (__m128i*)CoordinatesY, _mm_cvttps_epi32( Y ) );
+          
+          for( int j = 0; j < 4; j++ )
+            Texels[ i + j ] = FetchTexel( Texture, CoordinatesX[ j ], CoordinatesY[ j ] );
+      }
+      
+    #elif defined(SOFTWARE_RENDER_NEON)
+    
+      const float OffsetValues[ 4 ] = { 0, 1, 2, 3 };
+      float32x4_t Offsets = vld1q_f32( OffsetValues );
+      float32x4_t Zero = vdupq_n_f32( 0 );
+      float32x4_t Max = vdupq_n_f32( MaxCoordinate );
+      int32_t CoordinatesX[ 4 ], CoordinatesY[ 4 ];
+      
+      for( ; i + 4 <= Pixels; i += 4 )
+      {
+          float32x4_t Positions = vaddq_f32( vdupq_n_f32( (float)(FirstPixel + i) ), Offsets );
+          float32x4_t X = vmlaq_n_f32( vdupq_n_f32( TexelX ), Positions, StepX );
+          float32x4_t Y = vmlaq_n_f32( vdupq_n_f32( TexelY ), Positions, StepY );
+          
+          // after clamping, truncation is the same as floor
+          X = vminq_f32( vmaxq_f32( X, Zero ), Max );
+          Y = vminq_f32( vmaxq_f32( Y, Zero ), Max );
+          vst1q_s32( CoordinatesX, vcvtq_s32_f32( X ) );
+          vst1q_s32( CoordinatesY, vcvtq_s32_f32( Y ) );
+          
+          for( int j = 0; j < 4; j++ )
+            Texels[ i + j ] = FetchTexel( Texture, CoordinatesX[ j ], CoordinatesY[ j ] );
+      }
+      
+    #endif
+    
+    // process any remaining pixels
+    for( ; i < Pixels; i++ )
+    {
+        float X = TexelX + StepX * (FirstPixel + i);
+        float Y = TexelY + StepY * (FirstPixel + i);
+        Clamp( X, 0.0, MaxCoordinate );
+        Clamp( Y, 0.0, MaxCoordinate );
+        Texels[ i ] = FetchTexel( Texture, (int)X, (int)Y );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// applies multiply color to a line of source pixels,
+// and then blends them over the destination pixels
+void Software2DContext::BlendSpan( GPUColor* Destination, const GPUColor* Source, int Pixels, GPUColor Multiplier, IOPortValues Mode )
+{
+    int i = 0;
+    
+    #if defined(SOFTWARE_RENDER_SSE2)
+    
+      __m128i Multiplier16 = _mm_set_epi16
+      (
+          Multiplier.A, Multiplier.B, Multiplier.G, Multiplier.R,
+          Multiplier.A, Multiplier.B, Multiplier.G, Multiplier.R
+      );
+      
+      for( ; i + 4 <= Pixels; i += 4 )
+      {
+          __m128i DestinationPixels = _mm_loadu_si128( (const __m128i*)(Destination + i) );
+          __m128i SourcePixels = _mm_loadu_si128( (const __m128i*)(Source + i) );
+          DestinationPixels = BlendPixels_SSE2( DestinationPixels, SourcePixels, Multiplier16, Mode );
+          _mm_storeu_si128( (__m128i*)(Destination + i), DestinationPixels );
+      }
+      
+    #elif defined(SOFTWARE_RENDER_NEON)
+    
+      uint32_t MultiplierValue;
+      memcpy( &MultiplierValue, &Multiplier, 4 );
+      uint8x8_t Multiplier8 = vreinterpret_u8_u32( vdup_n_u32( MultiplierValue ) );
+      
+      for( ; i + 4 <= Pixels; i += 4 )
+      {
+          uint8x16_t DestinationPixels = vld1q_u8( (const uint8_t*)(Destination + i) );
+          uint8x16_t SourcePixels = vld1q_u8( (const uint8_t*)(Source + i) );
+          DestinationPixels = BlendPixels_NEON( DestinationPixels, SourcePixels, Multiplier8, Mode );
+          vst1q_u8( (uint8_t*)(Destination + i), DestinationPixels );
+      }
+      
+    #endif
+    
+    // process any remaining pixels
+    for( ; i < Pixels; i++ )
+      BlendPixel( Destination[ i ], Source[ i ], Multiplier, Mode );
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: BASE RENDER FUNCTIONS
+// =============================================================================
+
+
+void Software2DContext::SetQuadVertexPosition( int Vertex, int x, int y )
+{
+    QuadPositionCoords[ 2*Vertex ] = x;
+    QuadPositionCoords[ 2*Vertex + 1 ] = y;
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::SetQuadVertexTexCoords( int Vertex, float u, float v )
+{
+    QuadTextureCoords[ 2*Vertex ] = u;
+    QuadTextureCoords[ 2*Vertex + 1 ] = v;
+}
+
+// -----------------------------------------------------------------------------
+
+// Quads are always given as rectangles with vertices
+// in the order: top-left, top-right, bottom-left and
+// bottom-right. Instead of splitting them in triangles,
+// each screen pixel is mapped back to the quad space
+// and it is drawn when its center falls inside the quad
+void Software2DContext::DrawTexturedQuad()
+{
+    if( BoundTextureIndex < 0 )
+      return;
+      
+    SoftwareDrawCommand Command;
+    Command.IsClear = false;
+    Command.TextureIndex = BoundTextureIndex;
+    Command.Color = MultiplyColor;
+    Command.BlendingMode = BlendingMode;
+    
+    // PART 1: Find the inverse mapping
+    // - - - - - - - - - - - - - - - - - -
+    
+    // quad limits in render coordinates
+    float QuadMinX = QuadPositionCoords[ 0 ];
+    float QuadMinY = QuadPositionCoords[ 1 ];
+    float QuadWidth  = QuadPositionCoords[ 2 ] - QuadMinX;
+    float QuadHeight = QuadPositionCoords[ 5 ] - QuadMinY;
+    
+    if( QuadWidth == 0 || QuadHeight == 0 )
+      return;
+      
+    // our 2D transforms only use these matrix components
+    float M00 = TransformMatrix.Components[ 0 ][ 0 ];
+    float M01 = TransformMatrix.Components[ 0 ][ 1 ];
+    float M03 = TransformMatrix.Components[ 0 ][ 3 ];
+    float M10 = TransformMatrix.Components[ 1 ][ 0 ];
+    float M11 = TransformMatrix.Components[ 1 ][ 1 ];
+    float M13 = TransformMatrix.Components[ 1 ][ 3 ];
+    
+    // a null scale collapses the quad
+    float Determinant = M00 * M11 - M01 * M10;
+    
+    if( fabs( Determinant ) < 1e-9 )
+      return;
+      
+    float I00 =  M11 / Determinant;
+    float I01 = -M01 / Determinant;
+    float I10 = -M10 / Determinant;
+    float I11 =  M00 / Determinant;
+    
+    // express quad-relative coordinates (U,V), in range [0-1),
+    // as linear functions of the screen pixel (x,y), which is
+    // sampled at its center (x+0.5,y+0.5)
+    float CenterX = 0.5 - M03;
+    float CenterY = 0.5 - M13;
+    Command.StartU = (I00 * CenterX + I01 * CenterY - QuadMinX) / QuadWidth;
+    Command.StartV = (I10 * CenterX + I11 * CenterY - QuadMinY) / QuadHeight;
+    Command.StepUX = I00 / QuadWidth;
+    Command.StepUY = I01 / QuadWidth;
+    Command.StepVX = I10 / QuadHeight;
+    Command.StepVY = I11 / QuadHeight;
+    
+    // (U,V) are then mapped linearly to texels
+    Command.TexelMinX  = QuadTextureCoords[ 0 ] * Constants::GPUTextureSize;
+    Command.TexelMinY  = QuadTextureCoords[ 1 ] * Constants::GPUTextureSize;
+    Command.TexelSizeX = (QuadTextureCoords[ 2 ] - QuadTextureCoords[ 0 ]) * Constants::GPUTextureSize;
+    Command.TexelSizeY = (QuadTextureCoords[ 5 ] - QuadTextureCoords[ 1 ]) * Constants::GPUTextureSize;
+    
+    // PART 2: Find the screen area covered
+    // - - - - - - - - - - - - - - - - - - - -
+    
+    float MinX = Constants::ScreenWidth, MaxX = 0;
+    float MinY = Constants::ScreenHeight, MaxY = 0;
+    
+    for( int Vertex = 0; Vertex < 4; Vertex++ )
+    {
+        float x = QuadPositionCoords[ 2*Vertex ];
+        float y = QuadPositionCoords[ 2*Vertex + 1 ];
+        float ScreenX = M00 * x + M01 * y + M03;
+        float ScreenY = M10 * x + M11 * y + M13;
+        
+        MinX = min( MinX, ScreenX );
+        MaxX = max( MaxX, ScreenX );
+        MinY = min( MinY, ScreenY );
+        MaxY = max( MaxY, ScreenY );
+    }
+    
+    Clamp( MinX, 0, Constants::ScreenWidth );
+    Clamp( MaxX, 0, Constants::ScreenWidth );
+    Clamp( MinY, 0, Constants::ScreenHeight );
+    Clamp( MaxY, 0, Constants::ScreenHeight );
+    
+    Command.MinX = (int)floor( MinX );
+    Command.MaxX = (int)ceil( MaxX );
+    Command.MinY = (int)floor( MinY );
+    Command.MaxY = (int)ceil( MaxY );
+    
+    if( Command.MinX >= Command.MaxX || Command.MinY >= Command.MaxY )
+      return;
+      
+    SubmitCommand( Command );
+}
+
+// -----------------------------------------------------------------------------
+
+void Software2DContext::ClearScreen( GPUColor ClearColor )
+{
+    SoftwareDrawCommand Command;
+    Command.IsClear = true;
+    Command.TextureIndex = -1;
+    Command.Color = ClearColor;
+    Command.BlendingMode = BlendingMode;
+    Command.MinX = 0;
+    Command.MinY = 0;
+    Command.MaxX = Constants::ScreenWidth;
+    Command.MaxY = Constants::ScreenHeight;
+    
+    SubmitCommand( Command );
+}
+
+
+// =============================================================================
+//      SOFTWARE 2D CONTEXT: PROCESSING DRAW COMMANDS
+// =============================================================================
+
+
+// without worker threads commands are drawn immediately;
+// otherwise they are stored in the lists of all the tiles
+// they overlap, to be drawn when the frame is finished
+void Software2DContext::SubmitCommand( const SoftwareDrawCommand& Command )
+{
+    if( WorkerThreads.empty() )
+    {
+        RasterizeCommand( Command, 0, 0, Constants::ScreenWidth, Constants::ScreenHeight );
+        return;
+    }
+    
+    int CommandIndex = FrameCommands.size();
+    FrameCommands.push_back( Command );
+    
+    int FirstTileX = Command.MinX / RENDER_TILE_SIZE;
+    int FirstTileY = Command.MinY / RENDER_TILE_SIZE;
+    int LastTileX = (Command.MaxX - 1) / RENDER_TILE_SIZE;
+    int LastTileY = (Command.MaxY - 1) / RENDER_TILE_SIZE;
+    
+    for( int TileY = FirstTileY; TileY <= LastTileY; TileY++ )
+      for( int TileX = FirstTileX; TileX <= LastTileX; TileX++ )
+        TileCommands[ TileY * RENDER_TILES_X + TileX ].push_back( CommandIndex );
+}
+
+// -----------------------------------------------------------------------------
+
+// draws a command only within the given screen area
+// (maximums excluded); different threads can call this
+// at the same time as long as their areas do not overlap
+void Software2DContext::RasterizeCommand( const SoftwareDrawCommand& Command, int ClipMinX, int ClipMinY, int ClipMaxX, int ClipMaxY )
+{
+    int BoxMinX = max( Command.MinX, ClipMinX );
+    int BoxMaxX = min( Command.MaxX, ClipMaxX );
+    int BoxMinY = max( Command.MinY, ClipMinY );
+    int BoxMaxY = min( Command.MaxY, ClipMaxY );
+    
+    if( BoxMinX >= BoxMaxX || BoxMinY >= BoxMaxY )
+      return;
+      
+    // the screen is cleared by drawing a full-screen quad
+    // with the clear color, as done by the OpenGL context,
+    // so the current blending mode will also apply
+    if( Command.IsClear )
+    {
+        bool IsOpaque = (Command.BlendingMode == IOPortValues::GPUBlendingMode_Alpha && Command.Color.A == 255);
+        GPUColor ClearLine[ Constants::ScreenWidth ];
+        fill( ClearLine, ClearLine + BoxMaxX - BoxMinX, Command.Color );
+        
+        for( int y = BoxMinY; y < BoxMaxY; y++ )
+        {
+            GPUColor* Destination = &Framebuffer[ y * Constants::ScreenWidth + BoxMinX ];
+            
+            if( IsOpaque )
+              copy( ClearLine, ClearLine + BoxMaxX - BoxMinX, Destination );
+            else
+              BlendSpan( Destination, ClearLine, BoxMaxX - BoxMinX, GPUColor{ 255, 255, 255, 255 }, Command.BlendingMode );
+        }
+        
+        return;
+    }
+    
+    // otherwise draw each line of the quad
+    const SoftwareTexture& Texture = Textures[ Command.TextureIndex ];
+    GPUColor Texels[ Constants::ScreenWidth ];
+    
+    for( int y = BoxMinY; y < BoxMaxY; y++ )
+    {
+        float RowU = Command.StartU + Command.StepUY * y;
+        float RowV = Command.StartV + Command.StepVY * y;
+        
+        // find the pixels inside the quad; spans are
+        // always computed from the full command area so
+        // that the result does not depend on clipping
+        int FirstU = Command.MinX, LastU = Command.MaxX;
+        int FirstV = Command.MinX, LastV = Command.MaxX;
+        ClipSpan( RowU, Command.StepUX, FirstU, LastU );
+        ClipSpan( RowV, Command.StepVX, FirstV, LastV );
+        
+        int First = max( max( FirstU, FirstV ), BoxMinX );
+        int Last  = min( min( LastU, LastV ), BoxMaxX );
+        
+        if( First >= Last )
+          continue;
+          
+        // obtain their texels
+        SampleSpan
+        (
+            Texture,
+            Command.TexelMinX + RowU * Command.TexelSizeX,
+            Command.TexelMinY + RowV * Command.TexelSizeY,
+            Command.StepUX * Command.TexelSizeX,
+            Command.StepVX * Command.TexelSizeY,
+            First,
+            Last - First,
+            Texels
+        );
+        
+        // now draw them
+        GPUColor* Destination = &Framebuffer[ y * Constants::ScreenWidth + First ];
+        BlendSpan( Destination, Texels, Last - First, Command.Color, Command.BlendingMode );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// takes tiles not yet drawn and draws all their commands
+// in order, until no tiles remain for the current frame
+void Software2DContext::RasterizeTiles()
+{
+    const int NumberOfTiles = RENDER_TILES_X * RENDER_TILES_Y;
+    
+    while( true )
+    {
+        int Tile = SDL_AtomicAdd( &NextTile, 1 );
+        
+        if( Tile >= NumberOfTiles )
+          return;
+          
+        int TileMinX = (Tile % RENDER_TILES_X) * RENDER_TILE_SIZE;
+        int TileMinY = (Tile / RENDER_TILES_X) * RENDER_TILE_SIZE;
+        int TileMaxX = min( TileMinX + RENDER_TILE_SIZE, (int)Constants::ScreenWidth );
+        int TileMaxY = min( TileMinY + RENDER_TILE_SIZE, (int)Constants::ScreenHeight );
+        
+        for( int CommandIndex: TileCommands[ Tile ] )
+          RasterizeCommand( FrameCommands[ CommandIndex ], TileMinX, TileMinY, TileMaxX, TileMaxY );
+    }
+}
@@ -0,0 +1,187 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef SOFTWARE2DCONTEXT_HPP
+    #define SOFTWARE2DCONTEXT_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    #include "../../VirconDefinitions/VirconEnumerations.hpp"
+    
+    // include project headers
+    #include "Render2DInterface.hpp"
+    #include "Matrix4D.hpp"
+    
+    // include C/C++ headers
+    #include <vector>       // [ C++ STL ] Vectors
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>   // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR SOFTWARE RENDERING
+// =============================================================================
+
+
+// When rendering in parallel, the screen is divided in
+// tiles of this size. Each tile gets its own list of the
+// commands that affect it, and tiles are rasterized
+// independently by a pool of worker threads
+#define RENDER_TILE_SIZE      64
+#define RENDER_TILES_X        10   // 640 / 64
+#define RENDER_TILES_Y         6   // 360 / 64, rounded up
+#define MAX_RENDER_THREADS     8
+
+// -----------------------------------------------------------------------------
+
+// textures are kept in system memory at their actual size;
+// the rest of the 1024x1024 texture area reads as transparent
+typedef struct
+{
+    bool InUse;
+    unsigned Width;
+    unsigned Height;
+    std::vector< GPUColor > Pixels;
+}
+SoftwareTexture;
+
+// -----------------------------------------------------------------------------
+
+// a draw command, with all data needed to rasterize it
+// already prepared (so that tiles can be drawn later)
+typedef struct
+{
+    bool IsClear;
+    int TextureIndex;
+    GPUColor Color;             // multiply color, or clear color
+    IOPortValues BlendingMode;
+    
+    // covered screen area (maximums excluded)
+    int MinX, MinY;
+    int MaxX, MaxY;
+    
+    // mapping of screen pixels to quad space (U,V)
+    float StartU, StepUX, StepUY;
+    float StartV, StepVX, StepVY;
+    
+    // mapping of quad space to texels
+    float TexelMinX, TexelSizeX;
+    float TexelMinY, TexelSizeY;
+}
+SoftwareDrawCommand;
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE CONTEXT
+// =============================================================================
+
+
+// thread function for the render worker pool
+int SoftwareRenderThread( void* Parameters );
+
+
+// =============================================================================
+//      2D-SPECIALIZED SOFTWARE RENDERING CONTEXT
+// =============================================================================
+
+
+// This context implements the same 2D operations as the
+// OpenGL context, but renders into a framebuffer kept in
+// system memory. It needs no GPU at all, so it can be used
+// to run headless or when the GL driver is not reliable
+class Software2DContext: public Render2DInterface
+{
+    public:
+    
+        // framebuffer (640x360, first row is the screen top)
+        std::vector< GPUColor > Framebuffer;
+        
+        // contents kept while drawing speculative frames
+        std::vector< GPUColor > SavedFramebuffer;
+        
+        // loaded textures (ID 0 is reserved for no texture,
+        // so ID N is stored at position N-1 in the vector)
+        std::vector< SoftwareTexture > Textures;
+        int BoundTextureIndex;
+        
+        // arrays to hold quad info
+        int QuadPositionCoords[ 8 ];
+        float QuadTextureCoords[ 8 ];
+        
+        // transformation matrices
+        Matrix4D TranslationMatrix, ScalingMatrix, RotationMatrix;
+        Matrix4D TransformMatrix;
+        
+        // color settings
+        GPUColor MultiplyColor;
+        IOPortValues BlendingMode;
+        
+        // commands binned for the current frame
+        // (only used when rendering in parallel)
+        std::vector< SoftwareDrawCommand > FrameCommands;
+        std::vector< int > TileCommands[ RENDER_TILES_X * RENDER_TILES_Y ];
+        
+        // variables for the worker threads
+        friend int SoftwareRenderThread( void* );
+        std::vector< SDL_Thread* > WorkerThreads;
+        SDL_sem* WorkStartSemaphore;
+        SDL_sem* WorkEndSemaphore;
+        SDL_atomic_t NextTile;
+        bool ThreadExitFlag;
+        
+    private:
+    
+        // span operations, used by the render functions
+        void SampleSpan( const SoftwareTexture& Texture, float TexelX, float TexelY, float StepX, float StepY, int FirstPixel, int Pixels, GPUColor* Texels );
+        void BlendSpan( GPUColor* Destination, const GPUColor* Source, int Pixels, GPUColor Multiplier, IOPortValues Mode );
+        
+        // processing of draw commands
+        void SubmitCommand( const SoftwareDrawCommand& Command );
+        void RasterizeCommand( const SoftwareDrawCommand& Command, int ClipMinX, int ClipMinY, int ClipMaxX, int ClipMaxY );
+        void RasterizeTiles();
+        
+    public:
+    
+        // instance handling
+        Software2DContext();
+        virtual ~Software2DContext();
+        
+        // parallel rendering
+        void StartWorkers( int NumberOfThreads );
+        void StopWorkers();
+        
+        // handling textures
+        virtual unsigned CreateTexture( void* Pixels, unsigned Width, unsigned Height );
+        virtual void DestroyTexture( unsigned TextureID );
+        virtual void BindTexture( unsigned TextureID );
+        
+        // render target control
+        virtual void RenderToFramebuffer();
+        virtual void FinishFrame();
+        virtual void BeginSpeculativeDrawing();
+        virtual void EndSpeculativeDrawing();
+        
+        // color functions
+        virtual void SetMultiplyColor( GPUColor NewMultiplyColor );
+        virtual void SetBlendingMode( IOPortValues NewBlendingMode );
+        
+        // 2D transform functions
+        virtual void SetTranslation( int TranslationX, int TranslationY );
+        virtual void SetScale( float ScaleX, float ScaleY );
+        virtual void SetRotation( float AngleZ );
+        virtual void ComposeTransform( bool ScalingEnabled, bool RotationEnabled );
+        
+        // render functions
+        virtual void SetQuadVertexPosition( int Vertex, int x, int y );
+        virtual void SetQuadVertexTexCoords( int Vertex, float u, float v );
+        virtual void DrawTexturedQuad();
+        virtual void ClearScreen( GPUColor ClearColor );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
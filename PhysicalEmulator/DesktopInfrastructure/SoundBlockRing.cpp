@@ -0,0 +1,172 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "SoundBlockRing.hpp"
+    
+    // include C/C++ headers
+    #include <cstring>          // [ ANSI C ] Strings
+    #include <algorithm>        // [ C++ STL ] Algorithms
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      SOUND BLOCK RING: INSTANCE HANDLING
+// =============================================================================
+
+
+SoundBlockRing::SoundBlockRing()
+{
+    Clear();
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundBlockRing::SetCapacity( unsigned NumberOfBlocks )
+{
+    Blocks.resize( NumberOfBlocks );
+    Clear();
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundBlockRing::Clear()
+{
+    SDL_AtomicSet( &WrittenBlocks, 0 );
+    SDL_AtomicSet( &ReleasedBlocks, 0 );
+    SDL_AtomicSet( &Overruns, 0 );
+    SDL_AtomicSet( &Underruns, 0 );
+    
+    TimingLock = 0;
+    memset( &Timing, 0, sizeof( Timing ) );
+}
+
+
+// =============================================================================
+//      SOUND BLOCK RING: QUERIES
+// =============================================================================
+
+
+unsigned SoundBlockRing::GetCapacity()
+{
+    return Blocks.size();
+}
+
+// -----------------------------------------------------------------------------
+
+// counts wrap around, but their difference is still right
+unsigned SoundBlockRing::GetUsedBlocks()
+{
+    unsigned Released = SDL_AtomicGet( &ReleasedBlocks );
+    unsigned Written = SDL_AtomicGet( &WrittenBlocks );
+    return Written - Released;
+}
+
+// -----------------------------------------------------------------------------
+
+// statistics start again after being taken
+SoundTimingStatistics SoundBlockRing::TakeTimingStatistics()
+{
+    SDL_AtomicLock( &TimingLock );
+    
+    SoundTimingStatistics Result = Timing;
+    memset( &Timing, 0, sizeof( Timing ) );
+    
+    SDL_AtomicUnlock( &TimingLock );
+    return Result;
+}
+
+
+// =============================================================================
+//      SOUND BLOCK RING: PRODUCER SIDE
+// =============================================================================
+
+
+SoundBlock* SoundBlockRing::GetBlockToWrite()
+{
+    unsigned Written = SDL_AtomicGet( &WrittenBlocks );
+    unsigned Released = SDL_AtomicGet( &ReleasedBlocks );
+    
+    if( Written - Released >= Blocks.size() )
+      return nullptr;
+      
+    return &Blocks[ Written % Blocks.size() ];
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundBlockRing::FinishWriting()
+{
+    SDL_AtomicAdd( &WrittenBlocks, 1 );
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundBlockRing::RegisterOverrun()
+{
+    SDL_AtomicAdd( &Overruns, 1 );
+}
+
+
+// =============================================================================
+//      SOUND BLOCK RING: CONSUMER SIDE
+// =============================================================================
+
+
+unsigned SoundBlockRing::GetWrittenBlocks()
+{
+    return SDL_AtomicGet( &WrittenBlocks );
+}
+
+// -----------------------------------------------------------------------------
+
+// this is also the number of the oldest block in use
+unsigned SoundBlockRing::GetReleasedBlocks()
+{
+    return SDL_AtomicGet( &ReleasedBlocks );
+}
+
+// -----------------------------------------------------------------------------
+
+// the block must have been written, and not yet released
+SoundBlock& SoundBlockRing::GetBlock( unsigned BlockNumber )
+{
+    return Blocks[ BlockNumber % Blocks.size() ];
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundBlockRing::ReleaseBlock()
+{
+    SDL_AtomicAdd( &ReleasedBlocks, 1 );
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundBlockRing::RegisterUnderrun()
+{
+    SDL_AtomicAdd( &Underruns, 1 );
+}
+
+// -----------------------------------------------------------------------------
+
+// called by the consumer when a block has been played,
+// before releasing it; the measure includes its length
+void SoundBlockRing::RegisterPlayedBlock( const SoundBlock& PlayedBlock )
+{
+    Uint64 CurrentTime = SDL_GetPerformanceCounter();
+    double CounterFrequency = SDL_GetPerformanceFrequency();
+    double QueueDelay = (PlayedBlock.QueueTime - PlayedBlock.MixTime) / CounterFrequency;
+    double Latency = (CurrentTime - PlayedBlock.MixTime) / CounterFrequency;
+    
+    SDL_AtomicLock( &TimingLock );
+    
+    Timing.MinLatency = (Timing.PlayedBlocks? min( Timing.MinLatency, Latency ) : Latency);
+    Timing.MaxLatency = (Timing.PlayedBlocks? max( Timing.MaxLatency, Latency ) : Latency);
+    Timing.SumQueueDelay += QueueDelay;
+    Timing.SumLatency += Latency;
+    Timing.PlayedBlocks++;
+    
+    SDL_AtomicUnlock( &TimingLock );
+}
@@ -0,0 +1,124 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef SOUNDBLOCKRING_HPP
+    #define SOUNDBLOCKRING_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    
+    // include C/C++ headers
+    #include <vector>           // [ C++ STL ] Vectors
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>       // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR SOUND BLOCKS
+// =============================================================================
+
+
+// sound is passed in blocks of a fraction of a frame, so
+// that it can be generated as the frame runs (147 samples
+// = 3.3 ms); rate control can make them slightly longer
+// or shorter than that
+#define BLOCKS_PER_FRAME      5
+#define BLOCK_SAMPLES      (Constants::SPUSamplesPerFrame / BLOCKS_PER_FRAME)
+#define MAX_BLOCK_SAMPLES  (BLOCK_SAMPLES + 16)
+
+typedef struct
+{
+    SPUSample Samples[ MAX_BLOCK_SAMPLES ];
+    unsigned NumberOfSamples;
+    
+    // performance counter values when the block was
+    // mixed, and when the sink gave it to the device
+    Uint64 MixTime;
+    Uint64 QueueTime;
+}
+SoundBlock;
+
+// timings of the blocks played since last taken, in seconds
+typedef struct
+{
+    unsigned PlayedBlocks;
+    double SumQueueDelay;       // from mixing until given to the device
+    double SumLatency;          // from mixing until fully played
+    double MinLatency;
+    double MaxLatency;
+}
+SoundTimingStatistics;
+
+
+// =============================================================================
+//      SOUND BLOCK RING CLASS
+// =============================================================================
+
+
+// Passes sound blocks from the thread that generates them
+// to the one that plays them, without locks. There must be
+// a single producer and a single consumer: each one is the
+// only thread that advances its count, and SDL atomics are
+// full barriers, so block contents are always visible to
+// the other thread before the count that hands them over.
+// Blocks are read in order, and they can be kept in use
+// after being read until the consumer releases them
+class SoundBlockRing
+{
+    public:
+    
+        // slots are taken modulo the capacity
+        std::vector< SoundBlock > Blocks;
+        
+        // counts of blocks since the ring was cleared
+        SDL_atomic_t WrittenBlocks;
+        SDL_atomic_t ReleasedBlocks;
+        
+        // times that the producer found no space
+        // or the consumer found no sound to play
+        SDL_atomic_t Overruns;
+        SDL_atomic_t Underruns;
+        
+        // timings of played blocks; they are added
+        // by the consumer and taken by any thread
+        SDL_SpinLock TimingLock;
+        SoundTimingStatistics Timing;
+        
+    public:
+    
+        // instance handling
+        SoundBlockRing();
+        
+        // these can only be used when no
+        // other thread is using the ring
+        void SetCapacity( unsigned NumberOfBlocks );
+        void Clear();
+        
+        // queries from any thread
+        unsigned GetCapacity();
+        unsigned GetUsedBlocks();
+        SoundTimingStatistics TakeTimingStatistics();
+        
+        // producer side: a block is returned only if
+        // there is space, and it is published on finish
+        SoundBlock* GetBlockToWrite();
+        void FinishWriting();
+        void RegisterOverrun();
+        
+        // consumer side
+        unsigned GetWrittenBlocks();
+        unsigned GetReleasedBlocks();
+        SoundBlock& GetBlock( unsigned BlockNumber );
+        void ReleaseBlock();
+        void RegisterUnderrun();
+        void RegisterPlayedBlock( const SoundBlock& PlayedBlock );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
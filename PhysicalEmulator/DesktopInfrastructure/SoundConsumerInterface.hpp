@@ -0,0 +1,36 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef SOUNDCONSUMERINTERFACE_HPP
+    #define SOUNDCONSUMERINTERFACE_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+// *****************************************************************************
+
+
+// =============================================================================
+//      COMMON INTERFACE FOR SOUND CONSUMERS
+// =============================================================================
+
+
+// Anything that needs the emulator sound output (audio
+// capture, sound hashing...) can receive it by implementing
+// this interface. Samples are delivered from the emulation
+// thread as soon as they are generated, so implementations
+// must return quickly and never wait for other threads
+class SoundConsumerInterface
+{
+    public:
+    
+        // instance handling
+        virtual ~SoundConsumerInterface() {}
+        
+        // samples are only valid during the call
+        virtual void ProcessSound( const SPUSample* Samples, unsigned NumberOfSamples ) = 0;
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
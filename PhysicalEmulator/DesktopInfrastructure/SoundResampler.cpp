@@ -0,0 +1,72 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "SoundResampler.hpp"
+    
+    // include C/C++ headers
+    #include <cmath>            // [ ANSI C ] Mathematics
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      SOUND RESAMPLER: INSTANCE HANDLING
+// =============================================================================
+
+
+SoundResampler::SoundResampler()
+{
+    Reset();
+}
+
+// -----------------------------------------------------------------------------
+
+void SoundResampler::Reset()
+{
+    Position = 0;
+    LastSample.LeftSample = 0;
+    LastSample.RightSample = 0;
+}
+
+
+// =============================================================================
+//      SOUND RESAMPLER: PROCESSING
+// =============================================================================
+
+
+unsigned SoundResampler::Resample( const SPUSample* Input, unsigned InputSamples,
+                                   SPUSample* Output, unsigned MaxOutputSamples, double Ratio )
+{
+    if( !InputSamples )
+      return 0;
+      
+    // distance between output samples, measured in input samples
+    const uint64_t One = (uint64_t)1 << 32;
+    uint64_t Step = (uint64_t)ldexp( 1.0 / Ratio, 32 );
+    uint64_t End = (uint64_t)InputSamples << 32;
+    unsigned OutputSamples = 0;
+    
+    // interpolate between the 2 input samples around each position
+    while( Position < End && OutputSamples < MaxOutputSamples )
+    {
+        unsigned Index = Position >> 32;
+        int32_t Fraction = (Position & (One - 1)) >> 17;   // 15 bits, so products fit in 32
+        
+        const SPUSample& Previous = (Index? Input[ Index - 1 ] : LastSample);
+        const SPUSample& Next = Input[ Index ];
+        
+        Output->LeftSample  = Previous.LeftSample  + (((Next.LeftSample  - Previous.LeftSample ) * Fraction) >> 15);
+        Output->RightSample = Previous.RightSample + (((Next.RightSample - Previous.RightSample) * Fraction) >> 15);
+        
+        Output++;
+        OutputSamples++;
+        Position += Step;
+    }
+    
+    // if output had no room for all, drop the rest of
+    // the input so that the stream is still continuous
+    Position = (Position > End? Position - End : 0);
+    LastSample = Input[ InputSamples - 1 ];
+    return OutputSamples;
+}
@@ -0,0 +1,51 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef SOUNDRESAMPLER_HPP
+    #define SOUNDRESAMPLER_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include C/C++ headers
+    #include <cstdint>          // [ ANSI C ] Standard integer types
+// *****************************************************************************
+
+
+// =============================================================================
+//      SOUND RESAMPLER CLASS
+// =============================================================================
+
+
+// Stretches or shrinks a continuous stream of sound by a
+// small ratio, using linear interpolation. The position
+// in the input is kept across calls as a 32.32 fixed point
+// number, along with the last input sample, so that there
+// are no discontinuities between consecutive blocks. At a
+// ratio of 1 output is the same as input, 1 sample later
+class SoundResampler
+{
+    public:
+    
+        // position of the next output sample, where 0 is
+        // the last sample of the previous input block and
+        // 1 is the first sample of the current one
+        uint64_t Position;
+        SPUSample LastSample;
+        
+    public:
+    
+        // instance handling
+        SoundResampler();
+        void Reset();
+        
+        // ratio is output samples per input sample;
+        // returns the number of samples produced
+        unsigned Resample( const SPUSample* Input, unsigned InputSamples,
+                           SPUSample* Output, unsigned MaxOutputSamples, double Ratio );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -0,0 +1,43 @@
+// *****************************************************************************
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include infrastructure headers
+    #include "WAVFunctions.hpp"
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      WAV FILE FUNCTIONS
+// =============================================================================
+
+
+void WriteWAVHeader( ostream& File, uint32_t SoundBytes )
+{
+    uint32_t RIFFSize = 36 + SoundBytes;
+    uint32_t FormatSize = 16;
+    uint16_t FormatPCM = 1;
+    uint16_t Channels = 2;
+    uint32_t SampleRate = Constants::SPUSamplingRate;
+    uint32_t ByteRate = SampleRate * sizeof( SPUSample );
+    uint16_t BlockAlign = sizeof( SPUSample );
+    uint16_t BitsPerSample = 16;
+    
+    File.seekp( 0, ios_base::beg );
+    File.write( "RIFF", 4 );
+    File.write( (char*)&RIFFSize, 4 );
+    File.write( "WAVEfmt ", 8 );
+    File.write( (char*)&FormatSize, 4 );
+    File.write( (char*)&FormatPCM, 2 );
+    File.write( (char*)&Channels, 2 );
+    File.write( (char*)&SampleRate, 4 );
+    File.write( (char*)&ByteRate, 4 );
+    File.write( (char*)&BlockAlign, 2 );
+    File.write( (char*)&BitsPerSample, 2 );
+    File.write( "data", 4 );
+    File.write( (char*)&SoundBytes, 4 );
+}
@@ -0,0 +1,27 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef WAVFUNCTIONS_HPP
+    #define WAVFUNCTIONS_HPP
+    
+    // include C/C++ headers
+    #include <ostream>          // [ C++ STL ] Output streams
+    #include <cstdint>          // [ ANSI C ] Standard integer types
+// *****************************************************************************
+
+
+// =============================================================================
+//      WAV FILE FUNCTIONS
+// =============================================================================
+
+
+// writes, at the start of the file, the header for a WAV
+// with the sound format of the SPU (16-bit stereo samples
+// at SPU rate); sizes are only known at the end, so this
+// is written once at start and again when finishing
+void WriteWAVHeader( std::ostream& File, uint32_t SoundBytes );
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -0,0 +1,167 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    
+    // include project headers
+    #include "GPURecorder.hpp"
+    
+    // include C/C++ headers
+    #include <cstring>          // [ ANSI C ] Strings
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      GPU RECORDER: INSTANCE HANDLING
+// =============================================================================
+
+
+GPURecorder::GPURecorder()
+{
+    Recording = false;
+    RecordedFrames = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+GPURecorder::~GPURecorder()
+{
+    StopRecording();
+}
+
+
+// =============================================================================
+//      GPU RECORDER: WRITING EVENT DATA
+// =============================================================================
+
+
+void GPURecorder::WriteBytes( const void* Data, unsigned Size )
+{
+    const uint8_t* FirstByte = (const uint8_t*)Data;
+    FrameEvents.insert( FrameEvents.end(), FirstByte, FirstByte + Size );
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::WriteEvent( GPURecordingEvents Event )
+{
+    FrameEvents.push_back( (uint8_t)Event );
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::WriteInteger( int32_t Value )
+{
+    WriteBytes( &Value, 4 );
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::SaveFrameEvents()
+{
+    if( FrameEvents.empty() )
+      return;
+      
+    OutputFile.write( (char*)(&FrameEvents[0]), FrameEvents.size() );
+    
+    // keep the buffer memory for next frame
+    FrameEvents.clear();
+}
+
+
+// =============================================================================
+//      GPU RECORDER: RECORDING CONTROL
+// =============================================================================
+
+
+void GPURecorder::StartRecording( const string& NewFilePath )
+{
+    StopRecording();
+    
+    // open the file
+    LOG( "Recording GPU to file \"" << NewFilePath << "\"" );
+    
+    OutputFile.open( NewFilePath, ios::binary );
+    
+    if( OutputFile.fail() )
+      THROW( "Cannot open GPU recording file" );
+      
+    // save the file header
+    GPURecordingHeader Header;
+    memcpy( Header.Signature, GPU_RECORDING_SIGNATURE, 8 );
+    Header.Version = GPU_RECORDING_VERSION;
+    OutputFile.write( (char*)(&Header), sizeof(GPURecordingHeader) );
+    
+    FilePath = NewFilePath;
+    RecordedFrames = 0;
+    Recording = true;
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::StopRecording()
+{
+    if( !Recording )
+      return;
+      
+    // save any remaining events and close the file
+    SaveFrameEvents();
+    OutputFile.close();
+    Recording = false;
+    
+    LOG( "Recorded " << RecordedFrames << " GPU frames to file \"" << FilePath << "\"" );
+}
+
+
+// =============================================================================
+//      GPU RECORDER: RECORDING EVENTS
+// =============================================================================
+
+
+void GPURecorder::RecordPortWrite( int32_t LocalPort, VirconWord Value )
+{
+    FrameEvents.push_back( (uint8_t)LocalPort );
+    WriteInteger( Value.AsInteger );
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::RecordFrameStart()
+{
+    // all events of the previous frame are complete
+    SaveFrameEvents();
+    
+    WriteEvent( GPURecordingEvents::FrameStart );
+    RecordedFrames++;
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::RecordReset()
+{
+    WriteEvent( GPURecordingEvents::Reset );
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::RecordLoadTexture( int32_t TextureNumber, const void* Pixels, unsigned Width, unsigned Height )
+{
+    WriteEvent( GPURecordingEvents::LoadTexture );
+    WriteInteger( TextureNumber );
+    WriteInteger( Width );
+    WriteInteger( Height );
+    WriteBytes( Pixels, Width * Height * 4 );
+    
+    // textures are large, so don't keep them in memory
+    SaveFrameEvents();
+}
+
+// -----------------------------------------------------------------------------
+
+void GPURecorder::RecordUnloadTexture( int32_t TextureNumber )
+{
+    WriteEvent( GPURecordingEvents::UnloadTexture );
+    WriteInteger( TextureNumber );
+}
@@ -0,0 +1,99 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef GPURECORDER_HPP
+    #define GPURECORDER_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include C/C++ headers
+    #include <string>       // [ C++ STL ] Strings
+    #include <vector>       // [ C++ STL ] Vectors
+    #include <fstream>      // [ C++ STL ] File streams
+// *****************************************************************************
+
+
+// =============================================================================
+//      GPU RECORDING DEFINITIONS
+// =============================================================================
+
+
+// A recorded GPU stream starts with this header,
+// followed by a sequence of events. Each event begins
+// with a 1-byte code: codes up to the last GPU port
+// mean a write to that port, followed by the 4-byte
+// value. Any other codes are listed below
+#define GPU_RECORDING_SIGNATURE "V32-GPUR"
+#define GPU_RECORDING_VERSION   1
+
+typedef struct
+{
+    char Signature[ 8 ];
+    uint32_t Version;
+}
+GPURecordingHeader;
+
+// -----------------------------------------------------------------------------
+
+enum class GPURecordingEvents: uint8_t
+{
+    FrameStart    = 0xF0,   // (no data)
+    Reset         = 0xF1,   // (no data)
+    LoadTexture   = 0xF2,   // int32 texture (-1 = BIOS), uint32 width, uint32 height, pixels
+    UnloadTexture = 0xF3    // int32 texture (-1 = BIOS)
+};
+
+
+// =============================================================================
+//      GPU RECORDER CLASS
+// =============================================================================
+
+
+// Records all inputs to the GPU so that the same frames
+// can later be drawn again without emulating the CPU.
+// Events for each frame are kept in memory and saved
+// to file all at once when the next frame begins
+class GPURecorder
+{
+    public:
+    
+        // output file
+        std::string FilePath;
+        std::ofstream OutputFile;
+        bool Recording;
+        
+        // events pending to be saved
+        std::vector< uint8_t > FrameEvents;
+        unsigned RecordedFrames;
+        
+    private:
+    
+        // writing event data
+        void WriteBytes( const void* Data, unsigned Size );
+        void WriteEvent( GPURecordingEvents Event );
+        void WriteInteger( int32_t Value );
+        void SaveFrameEvents();
+        
+    public:
+    
+        // instance handling
+        GPURecorder();
+       ~GPURecorder();
+       
+        // recording control
+        void StartRecording( const std::string& NewFilePath );
+        void StopRecording();
+        
+        // recording events
+        void RecordPortWrite( int32_t LocalPort, VirconWord Value );
+        void RecordFrameStart();
+        void RecordReset();
+        void RecordLoadTexture( int32_t TextureNumber, const void* Pixels, unsigned Width, unsigned Height );
+        void RecordUnloadTexture( int32_t TextureNumber );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
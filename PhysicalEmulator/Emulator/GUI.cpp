@@ -2,12 +2,16 @@
     // include infrastructure headers
     #include "../DesktopInfrastructure/OpenGL2DContext.hpp"
     #include "../DesktopInfrastructure/FilePaths.hpp"
+    #include "../DesktopInfrastructure/LogStream.hpp"
     
     // include project headers
     #include "GUI.hpp"
     #include "VirconEmulator.hpp"
     #include "Globals.hpp"
     
+    // include C/C++ headers
+    #include <algorithm>        // [ C++ STL ] Algorithms
+    
     // declare used namespaces
     using namespace std;
 // *****************************************************************************
@@ -27,7 +31,9 @@ void SetFullScreen()
     if( WasRunning )
       Vircon.Pause();
     
-    // set full screen
+    // set full screen; the window size
+    // must not change while a frame is drawn
+    ThreadedOpenGL2D.WaitForRenderThread();
     OpenGL2D.SetFullScreen();
     
     // resume emulation if needed
@@ -38,10 +44,12 @@ void SetFullScreen()
 // -----------------------------------------------------------------------------
 
 // renders the emulator's framebuffer onto the main program's
-// window to make it visible. Since the console implementation
-// can change OpenGL's render properties, we need to wrap this
-// to ensure the framebuffer is rendered correctly
-void ShowEmulatorWindow()
+// window to make it visible. This only uses GL and the given
+// console state, so a render thread can also call it. Redraws
+// show an already presented frame again (i.e. when the window
+// is exposed), so they are not given to frame consumers and
+// are left out of GPU timing
+void DrawEmulatorWindow( bool PowerIsOn, uint64_t FrameNumber, bool IsRedraw )
 {
     glEnable( GL_BLEND );
     glEnable( GL_TEXTURE_2D );
@@ -59,12 +67,241 @@ void ShowEmulatorWindow()
     // signal" indicator on a black screen
     OpenGL2D.RenderToScreen();
     
-    if( Vircon.PowerIsOn )
-      OpenGL2D.DrawFramebufferOnScreen();
+    if( PowerIsOn )
+    {
+        // software rendered images must first
+        // be transferred to the GL framebuffer
+        if( !IsRedraw )
+          OpenGL2D.BeginTimedPhase( GPUTimedPhases::ScreenDrawing );
+          
+        if( Vircon.GPU.Renderer == &Software2D )
+          OpenGL2D.UploadFramebuffer( &Software2D.Framebuffer[ 0 ] );
+          
+        OpenGL2D.DrawFramebufferOnScreen();
+        
+        if( !IsRedraw )
+          OpenGL2D.EndTimedPhase();
+          
+        // give the image to any frame consumers
+        if( !IsRedraw )
+          OpenGL2D.ReadFramebufferAsync( FrameNumber );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// Since the console implementation can change OpenGL's
+// render properties, we need to wrap this to ensure the
+// framebuffer is rendered correctly
+void ShowEmulatorWindow( bool IsRedraw )
+{
+    DrawEmulatorWindow( Vircon.PowerIsOn, Vircon.Timer.FrameCounter, IsRedraw );
     
-    // now restore the Vircon render parameters
-    VirconWord BlendValue;
-    BlendValue.AsInteger = Vircon.GPU.ActiveBlending;
-    Vircon.GPU.WritePort( (int32_t)GPU_LocalPorts::ActiveBlending, BlendValue );
+    // now restore the Vircon render parameters; this
+    // is not done through GPU ports, so it does not
+    // appear in GPU recordings
+    Vircon.GPU.Renderer->SetBlendingMode( (IOPortValues)Vircon.GPU.ActiveBlending );
     OpenGL2D.MultiplyColor = Vircon.GPU.MultiplyColor;
 }
+
+// -----------------------------------------------------------------------------
+
+// shows the latest emulator frame on screen; with a
+// render thread this only submits the recorded frame
+void PresentEmulatorWindow( bool IsRedraw )
+{
+    if( ThreadedOpenGL2D.IsRunning() )
+    {
+        ThreadedOpenGL2D.SubmitFrame
+        (
+            Vircon.PowerIsOn,
+            Vircon.Timer.FrameCounter,
+            Vircon.LastGPULoads[ 0 ],
+            (IOPortValues)Vircon.GPU.ActiveBlending,
+            Vircon.GPU.MultiplyColor,
+            IsRedraw
+        );
+        
+        return;
+    }
+    
+    ShowEmulatorWindow( IsRedraw );
+    
+    if( IsRedraw )
+    {
+        SDL_GL_SwapWindow( OpenGL2D.Window );
+        return;
+    }
+    
+    OpenGL2D.BeginTimedPhase( GPUTimedPhases::BufferSwap );
+    SDL_GL_SwapWindow( OpenGL2D.Window );
+    OpenGL2D.EndTimedPhase();
+    
+    ReportGPUTiming( Vircon.LastGPULoads[ 0 ] );
+}
+
+
+// =============================================================================
+//      RENDER THREAD FUNCTIONS
+// =============================================================================
+
+
+// from now on the GL context belongs to the render
+// thread, so GL must not be used from this one
+void StartRenderThread()
+{
+    if( !ThreadedOpenGL2D.Enabled || Vircon.GPU.Renderer != &OpenGL2D )
+      return;
+      
+    ThreadedOpenGL2D.Start();
+    
+    if( ThreadedOpenGL2D.IsRunning() )
+      Vircon.GPU.Renderer = &ThreadedOpenGL2D;
+}
+
+// -----------------------------------------------------------------------------
+
+void StopRenderThread()
+{
+    if( !ThreadedOpenGL2D.IsRunning() )
+      return;
+      
+    ThreadedOpenGL2D.Stop();
+    Vircon.GPU.Renderer = &OpenGL2D;
+}
+
+
+// =============================================================================
+//      CONNECTING OUTPUT CONSUMERS
+// =============================================================================
+
+
+// Frame consumers receive images through framebuffer
+// readback, which must be stopped while the list of
+// consumers is modified. Sound consumers are called
+// from this same thread, so they need no precautions
+void ConnectOutputConsumer( FrameConsumerInterface* FrameConsumer, SoundConsumerInterface* SoundConsumer )
+{
+    OpenGL2D.DisableReadback();
+    OpenGL2D.FrameConsumers.push_back( FrameConsumer );
+    OpenGL2D.EnableReadback();
+    
+    Vircon.SPU.SoundConsumers.push_back( SoundConsumer );
+}
+
+// -----------------------------------------------------------------------------
+
+void DisconnectOutputConsumer( FrameConsumerInterface* FrameConsumer, SoundConsumerInterface* SoundConsumer )
+{
+    vector< SoundConsumerInterface* >& SoundConsumers = Vircon.SPU.SoundConsumers;
+    SoundConsumers.erase( remove( SoundConsumers.begin(), SoundConsumers.end(), SoundConsumer ), SoundConsumers.end() );
+    
+    OpenGL2D.DisableReadback();
+    vector< FrameConsumerInterface* >& FrameConsumers = OpenGL2D.FrameConsumers;
+    FrameConsumers.erase( remove( FrameConsumers.begin(), FrameConsumers.end(), FrameConsumer ), FrameConsumers.end() );
+    
+    if( !FrameConsumers.empty() )
+      OpenGL2D.EnableReadback();
+}
+
+
+// =============================================================================
+//      VIDEO RECORDING FUNCTIONS
+// =============================================================================
+
+
+void StartVideoRecording( const string& BaseFilePath )
+{
+    StopVideoRecording();
+    GameplayRecorder.StartRecording( BaseFilePath );
+    ConnectOutputConsumer( &GameplayRecorder, &GameplayRecorder );
+}
+
+// -----------------------------------------------------------------------------
+
+void StopVideoRecording()
+{
+    if( !GameplayRecorder.Recording )
+      return;
+      
+    // it can only save its remaining
+    // data once it receives no more
+    DisconnectOutputConsumer( &GameplayRecorder, &GameplayRecorder );
+    GameplayRecorder.StopRecording();
+}
+
+
+// =============================================================================
+//      OUTPUT HASHING FUNCTIONS
+// =============================================================================
+
+
+void StartOutputHashing( const string& LogFilePath )
+{
+    StopOutputHashing();
+    OutputHashes.StartLogging( LogFilePath, &Vircon.Timer.FrameCounter );
+    ConnectOutputConsumer( &OutputHashes, &OutputHashes );
+}
+
+// -----------------------------------------------------------------------------
+
+void StopOutputHashing()
+{
+    if( !OutputHashes.Logging )
+      return;
+      
+    DisconnectOutputConsumer( &OutputHashes, &OutputHashes );
+    OutputHashes.StopLogging();
+}
+
+
+// =============================================================================
+//      GPU TIMING FUNCTIONS
+// =============================================================================
+
+
+// the emulated GPU load is averaged over
+// the same frames as the measured times
+double AccumulatedGPULoad = 0;
+unsigned AccumulatedGPULoadFrames = 0;
+
+// -----------------------------------------------------------------------------
+
+void EnableGPUTiming()
+{
+    OpenGL2D.EnableGPUTiming();
+    AccumulatedGPULoad = 0;
+    AccumulatedGPULoadFrames = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void DisableGPUTiming()
+{
+    OpenGL2D.DisableGPUTiming();
+}
+
+// -----------------------------------------------------------------------------
+
+// called once per shown frame, after the buffer swap
+void ReportGPUTiming( float GPULoad )
+{
+    if( !OpenGL2D.GPUTimingEnabled )
+      return;
+      
+    AccumulatedGPULoad += GPULoad;
+    AccumulatedGPULoadFrames++;
+    
+    if( !OpenGL2D.FinishTimedFrame() )
+      return;
+      
+    float* Times = OpenGL2D.AverageGPUTimes;
+    
+    LOG( "GPU load: " << (AccumulatedGPULoad / AccumulatedGPULoadFrames) << "% of pixel capacity"
+         << ", GPU time per frame: emulator " << Times[ (int)GPUTimedPhases::EmulatorDrawing ] << " ms"
+         << ", screen " << Times[ (int)GPUTimedPhases::ScreenDrawing ] << " ms"
+         << ", swap " << Times[ (int)GPUTimedPhases::BufferSwap ] << " ms" );
+         
+    AccumulatedGPULoad = 0;
+    AccumulatedGPULoadFrames = 0;
+}
@@ -5,6 +5,7 @@
     
     // include C/C++ headers
     #include <string>           // [ C++ STL ] Strings
+    #include <cstdint>          // [ ANSI C ] Standard integer types
 // *****************************************************************************
 
 
@@ -14,7 +15,46 @@
 
 
 void SetFullScreen();
-void ShowEmulatorWindow();
+void DrawEmulatorWindow( bool PowerIsOn, uint64_t FrameNumber, bool IsRedraw );
+void ShowEmulatorWindow( bool IsRedraw );
+void PresentEmulatorWindow( bool IsRedraw );
+
+
+// =============================================================================
+//      RENDER THREAD FUNCTIONS
+// =============================================================================
+
+
+void StartRenderThread();
+void StopRenderThread();
+
+
+// =============================================================================
+//      VIDEO RECORDING FUNCTIONS
+// =============================================================================
+
+
+void StartVideoRecording( const std::string& BaseFilePath );
+void StopVideoRecording();
+
+
+// =============================================================================
+//      OUTPUT HASHING FUNCTIONS
+// =============================================================================
+
+
+void StartOutputHashing( const std::string& LogFilePath );
+void StopOutputHashing();
+
+
+// =============================================================================
+//      GPU TIMING FUNCTIONS
+// =============================================================================
+
+
+void EnableGPUTiming();
+void DisableGPUTiming();
+void ReportGPUTiming( float GPULoad );
 
 
 // *****************************************************************************
@@ -37,6 +37,10 @@ string MemoryCardPath;
 
 
 OpenGL2DContext OpenGL2D;
+Software2DContext Software2D;
+ThreadedRenderer ThreadedOpenGL2D;
+VideoRecorder GameplayRecorder;
+OutputHasher OutputHashes;
 
 string VertexShader =
     "#version 100" "\n"
@@ -66,6 +70,17 @@ string FragmentShader =
     "}";
 
 
+// =============================================================================
+//      AUDIO OBJECTS
+// =============================================================================
+
+
+OpenALAudioSink OpenALSink;
+SDLAudioSink SDLSink;
+NullAudioSink NullSink;
+WAVAudioSink WAVSink;
+
+
 // =============================================================================
 //      PROGRAM OBJECTS
 // =============================================================================
@@ -74,6 +89,9 @@ string FragmentShader =
 // instance of the Vircon virtual machine
 VirconEmulator Vircon;
 
+// timing of the main loop
+FramePacer MainLoopPacer;
+
 
 // =============================================================================
 //      INITIALIZATION OF VARIABLES
@@ -7,6 +7,17 @@
     #include "../DesktopInfrastructure/Definitions.hpp"
     #include "../DesktopInfrastructure/Texture.hpp"
     #include "../DesktopInfrastructure/OpenGL2DContext.hpp"
+    #include "../DesktopInfrastructure/Software2DContext.hpp"
+    #include "../DesktopInfrastructure/FramePacer.hpp"
+    
+    // include project headers
+    #include "VideoRecorder.hpp"
+    #include "OutputHasher.hpp"
+    #include "ThreadedRenderer.hpp"
+    #include "OpenALAudioSink.hpp"
+    #include "SDLAudioSink.hpp"
+    #include "NullAudioSink.hpp"
+    #include "WAVAudioSink.hpp"
     
     // include C/C++ headers
     #include <map>          // [ C++ STL ] Maps
@@ -39,10 +50,25 @@ extern std::string MemoryCardPath;
 
 
 extern OpenGL2DContext OpenGL2D;
+extern Software2DContext Software2D;
+extern ThreadedRenderer ThreadedOpenGL2D;
+extern VideoRecorder GameplayRecorder;
+extern OutputHasher OutputHashes;
 extern std::string VertexShader;
 extern std::string FragmentShader;
 
 
+// =============================================================================
+//      AUDIO OBJECTS
+// =============================================================================
+
+
+extern OpenALAudioSink OpenALSink;
+extern SDLAudioSink SDLSink;
+extern NullAudioSink NullSink;
+extern WAVAudioSink WAVSink;
+
+
 // =============================================================================
 //      PROGRAM OBJECTS
 // =============================================================================
@@ -51,6 +77,9 @@ extern std::string FragmentShader;
 // instance of the Vircon virtual machine
 extern VirconEmulator Vircon;
 
+// timing of the main loop
+extern FramePacer MainLoopPacer;
+
 
 // =============================================================================
 //      INITIALIZATION OF VARIABLES
@@ -15,6 +15,7 @@
     // include C/C++ headers
     #include <iostream>     // [ C++ STL ] I/O Streams
     #include <cstddef>      // for offsetof
+    #include <cmath>        // [ ANSI C ] Mathematics
     
     // include SDL2 headers
     #include <SDL2/SDL_image.h>   // [ SDL2 ] SDL_Image
@@ -96,6 +97,24 @@ string GetProgramFolder()
     return Result;
 }
 
+// -----------------------------------------------------------------------------
+
+// folder where the current user can write our files, since
+// the program folder can be read-only in system installs;
+// returns an empty path if there is no such folder
+string GetUserFolder()
+{
+    char* SDLString = SDL_GetPrefPath( "Vircon32", "Emulator" );
+    
+    if( !SDLString )
+      return "";
+      
+    string Result = SDLString;
+    SDL_free( SDLString );
+    
+    return Result;
+}
+
 
 // =============================================================================
 //      MAIN FUNCTION
@@ -151,6 +170,13 @@ int main( int NumberOfArguments, char* Arguments[] )
         // -----------------------------------------------------------------------------
         
         // initialize OpenGL shaders and their infrastructure
+        // (compiled shaders are kept to speed up next runs;
+        // without a user folder they are just not cached)
+        string UserFolder = GetUserFolder();
+        
+        if( !UserFolder.empty() )
+          OpenGL2D.ShaderCachePath = UserFolder + "ShaderCache.bin";
+          
         OpenGL2D.InitRendering();
         
         // create a framebuffer object
@@ -162,14 +188,6 @@ int main( int NumberOfArguments, char* Arguments[] )
         glEnable( GL_BLEND );
         OpenGL2D.SetBlendingMode( IOPortValues::GPUBlendingMode_Alpha );
         
-        //initialize audio
-        LOG( "Initializing audio" );
-        alutInit( NULL, NULL );
-        
-        // locating listener
-        alListener3f( AL_POSITION, 0, 0, 0 );
-        alListenerf( AL_GAIN, 1.0 );
-        
         // initialize the window
         string WindowTitle = "Vircon32";
         SDL_SetWindowTitle( OpenGL2D.Window, WindowTitle.c_str() );
@@ -179,6 +197,20 @@ int main( int NumberOfArguments, char* Arguments[] )
         LoadControls( EmulatorFolder + "Config-Controls.xml" );
         LoadSettings( EmulatorFolder + "Config-Settings.xml" );
         
+        // initialize audio; OpenAL is only
+        // needed if the settings chose it
+        bool OpenALInitialized = (Vircon.SPU.Sink == &OpenALSink);
+        
+        if( OpenALInitialized )
+        {
+            LOG( "Initializing audio" );
+            alutInit( NULL, NULL );
+            
+            // locating listener
+            alListener3f( AL_POSITION, 0, 0, 0 );
+            alListenerf( AL_GAIN, 1.0 );
+        }
+        
         // -----------------------------------------------------------------------------
         
         // enable SDL joystick events
@@ -241,6 +273,10 @@ int main( int NumberOfArguments, char* Arguments[] )
         // timing control
         StopWatch Watch;
         
+        // from here GL may belong to a render thread
+        StartRenderThread();
+        bool GLIsCurrent = !ThreadedOpenGL2D.IsRunning();
+        
         // begin message loop
         while( GlobalLoopActive )
         {
@@ -287,12 +323,10 @@ int main( int NumberOfArguments, char* Arguments[] )
                         Vircon.Resume();
                     }
                     
-                    // on this case, window should be redrawn
+                    // on this case, window should be redrawn; this
+                    // repeats a frame that was already presented
                     if( Event.window.event == SDL_WINDOWEVENT_EXPOSED )
-                    {
-                        ShowEmulatorWindow();
-                        SDL_GL_SwapWindow( OpenGL2D.Window );
-                    }
+                      PresentEmulatorWindow( true );
                     
                     // keep track of when mouse is inside our window
                     if( Event.window.event == SDL_WINDOWEVENT_ENTER )
@@ -366,16 +400,33 @@ int main( int NumberOfArguments, char* Arguments[] )
                   Vircon.ProcessEvent( Event );
             }
             
-            // update frame only when needed
-            if( !WindowActive ) continue;
+            // update frame only when needed; meanwhile
+            // just check for events once per frame
+            if( !WindowActive )
+            {
+                MainLoopPacer.WaitFor( 1.0 / 60 );
+                continue;
+            }
             
             // redirect all rendering to emulator's display
-            OpenGL2D.RenderToFramebuffer();
+            // (a render thread does this on its own)
+            if( GLIsCurrent )
+              OpenGL2D.RenderToFramebuffer();
             
             // measure cycle time
             double TimeStep = Watch.GetStepTime();
             PendingFrames += TimeStep * 60.0;
-            if( PendingFrames < 0.9 ) continue;
+            
+            // wait until the next frame is due, without
+            // using the CPU while there is time to sleep
+            if( PendingFrames < 0.9 )
+            {
+                MainLoopPacer.WaitFor( (1 - PendingFrames) / 60.0 );
+                continue;
+            }
+            
+            if( GLIsCurrent )
+              OpenGL2D.BeginTimedPhase( GPUTimedPhases::EmulatorDrawing );
             
             while( PendingFrames >= 0.9 )
             {
@@ -384,22 +435,47 @@ int main( int NumberOfArguments, char* Arguments[] )
                 
                 // this frame is done
                 PendingFrames = max( PendingFrames - 1, 0.0f );
+                
+                // only the last frame of each update is shown,
+                // but frame consumers must receive all of them;
+                // so when behind, emulation slows down instead
+                if( !OpenGL2D.FrameConsumers.empty() )
+                {
+                    PendingFrames -= floor( PendingFrames );
+                    break;
+                }
             }
             
+            // when enabled, emulate some frames ahead to show
+            // their result; recorded output must be the real one
+            if( OpenGL2D.FrameConsumers.empty() )
+              Vircon.RunAhead();
+              
+            if( GLIsCurrent )
+              OpenGL2D.EndTimedPhase();
+              
             // - - - - - - - - - - - - - - - - - - - - - - - - - -
             // THE FOLLOWING WILL BE DONE JUST ONCE PER UPDATE
             
-            // (1) Show the emulator's display on screen
-            ShowEmulatorWindow();
+            // show the emulator's display on screen
+            // (this also reports GPU times, if measured)
+            PresentEmulatorWindow( false );
+            MainLoopPacer.RegisterFrame();
             
-            // (2) Show updates on screen
-            SDL_GL_SwapWindow( OpenGL2D.Window );
+            // go back to the last real frame
+            Vircon.RollBack();
         }
         
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
         
+        // GL is used from this thread again
+        StopRenderThread();
+        
         // turn off Vircon VM
         Vircon.Terminate();
+        Vircon.GPU.Recorder.StopRecording();
+        StopVideoRecording();
+        StopOutputHashing();
         
         // free scene resources
         LOG( "---------------------------------------------------------------------" );
@@ -414,11 +490,15 @@ int main( int NumberOfArguments, char* Arguments[] )
         }
         
         // shut down ALUT
-        LOG( "Terminating audio" );
-        alutExit();
+        if( OpenALInitialized )
+        {
+            LOG( "Terminating audio" );
+            alutExit();
+        }
         
         // clean-up in reverse order
         LOG( "Exiting" );
+        Software2D.StopWorkers();
         OpenGL2D.Destroy();
         SDL_Quit();
     }
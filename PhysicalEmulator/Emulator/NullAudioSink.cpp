@@ -0,0 +1,120 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    
+    // include project headers
+    #include "NullAudioSink.hpp"
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      NULL AUDIO SINK: INSTANCE HANDLING
+// =============================================================================
+
+
+NullAudioSink::NullAudioSink()
+{
+    Ring = nullptr;
+}
+
+
+// =============================================================================
+//      NULL AUDIO SINK: HANDLING THE OUTPUT DEVICE
+// =============================================================================
+
+
+void NullAudioSink::Open( SoundBlockRing& SourceRing )
+{
+    LOG( "Audio output is disabled" );
+    Ring = &SourceRing;
+}
+
+// -----------------------------------------------------------------------------
+
+void NullAudioSink::Close()
+{
+    Ring = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool NullAudioSink::IsOpen()
+{
+    return (Ring != nullptr);
+}
+
+
+// =============================================================================
+//      NULL AUDIO SINK: PLAYBACK CONTROL
+// =============================================================================
+
+
+// there is nothing to play, so
+// nothing needs to be controlled
+void NullAudioSink::Start()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void NullAudioSink::Stop()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void NullAudioSink::Pause()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void NullAudioSink::Resume()
+{
+}
+
+
+// =============================================================================
+//      NULL AUDIO SINK: SOUND INPUT
+// =============================================================================
+
+
+// this is called from the emulation thread, which
+// then becomes the only consumer of the ring too;
+// blocks count as played as soon as they are taken
+void NullAudioSink::NotifyBlockWritten()
+{
+    while( Ring->GetUsedBlocks() )
+    {
+        Ring->RegisterPlayedBlock( Ring->GetBlock( Ring->GetReleasedBlocks() ) );
+        Ring->ReleaseBlock();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+unsigned NullAudioSink::GetStartingBlocks()
+{
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// sound is taken as soon as it is written
+bool NullAudioSink::FollowsDeviceClock()
+{
+    return false;
+}
+
+
+// =============================================================================
+//      NULL AUDIO SINK: OUTPUT VOLUME
+// =============================================================================
+
+
+void NullAudioSink::SetGain( float NewGain )
+{
+}
@@ -0,0 +1,56 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef NULLAUDIOSINK_HPP
+    #define NULLAUDIOSINK_HPP
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/AudioSinkInterface.hpp"
+    #include "../DesktopInfrastructure/SoundBlockRing.hpp"
+// *****************************************************************************
+
+
+// =============================================================================
+//      NULL AUDIO SINK CLASS
+// =============================================================================
+
+
+// Discards all sound as soon as it is written, with no
+// sound device and no threads. The SPU still mixes all
+// its sound, so headless runs can measure its real cost
+class NullAudioSink: public AudioSinkInterface
+{
+    public:
+    
+        // sound blocks to discard
+        SoundBlockRing* Ring;
+        
+    public:
+    
+        // instance handling
+        NullAudioSink();
+        
+        // handling the output device
+        virtual void Open( SoundBlockRing& SourceRing );
+        virtual void Close();
+        virtual bool IsOpen();
+        
+        // playback control
+        virtual void Start();
+        virtual void Stop();
+        virtual void Pause();
+        virtual void Resume();
+        
+        // sound input
+        virtual void NotifyBlockWritten();
+        virtual unsigned GetStartingBlocks();
+        virtual bool FollowsDeviceClock();
+        
+        // output volume
+        virtual void SetGain( float NewGain );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -0,0 +1,508 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    
+    // include project headers
+    #include "OpenALAudioSink.hpp"
+    
+    // include C/C++ headers
+    #include <stdexcept>        // [ C++ STL ] Exceptions
+    #include <iostream>         // [ C++ STL ] I/O Streams
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      AUXILIARY AUDIO FUNCTIONS
+// =============================================================================
+
+
+bool IsOpenALActive()
+{
+    // STEP 1: Check there is an audio context
+    ALCcontext* AudioContext = alcGetCurrentContext();
+    
+    if( !AudioContext )
+      return false;
+      
+    alGetError();
+    
+    // STEP 2: Check there is an audio device
+    ALCdevice* AudioDevice = alcGetContextsDevice( AudioContext );
+    
+    if( !AudioDevice )
+      return false;
+      
+    alGetError();
+    
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+ALenum GetSourceState( ALuint SourceID )
+{
+    ALenum State;
+    alGetSourcei( SourceID, AL_SOURCE_STATE, &State );
+    
+    return State;
+}
+
+// -----------------------------------------------------------------------------
+
+bool IsSourcePlaying( ALuint SourceID )
+{
+    return (GetSourceState( SourceID ) == AL_PLAYING);
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: INSTANCE HANDLING
+// =============================================================================
+
+
+OpenALAudioSink::OpenALAudioSink()
+{
+    // set null IDs for OpenAL objects
+    SoundSourceID = 0;
+    Gain = 1.0;
+    
+    for( int i = 0; i < MAX_AL_BUFFERS; i++ )
+      BufferIDs[ i ] = 0;
+      
+    // no sound to play yet
+    Ring = nullptr;
+    QueuedBlocks = 0;
+    
+    // initial state for playback variables
+    PlaybackThread = nullptr;
+    PlaybackSemaphore = nullptr;
+    SDL_AtomicSet( &ThreadExitFlag, 0 );
+    SDL_AtomicSet( &ThreadPauseFlag, 1 );
+}
+
+// -----------------------------------------------------------------------------
+
+OpenALAudioSink::~OpenALAudioSink()
+{
+    Close();
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: HANDLING THE OUTPUT DEVICE
+// =============================================================================
+
+
+void OpenALAudioSink::Open( SoundBlockRing& SourceRing )
+{
+    // don't try next operations without OpenAL active
+    if( !IsOpenALActive() )
+      THROW( "OpenAL is not active" );
+      
+    LOG( "Opening OpenAL audio output" );
+    Ring = &SourceRing;
+    
+    // create sound buffers to alternate streaming
+    for( int i = 0; i < MAX_AL_BUFFERS; i++ )
+      alGenBuffers( 1, &BufferIDs[ i ] );
+      
+    // create a sound SourceID to play the buffers
+    alGenSources( 1, &SoundSourceID );
+    
+    // configure sound source
+    alSource3f( SoundSourceID, AL_POSITION, 0, 0, 0 );
+    alSourcef ( SoundSourceID, AL_GAIN, Gain );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenALAudioSink::Close()
+{
+    // do nothing if audio was not initialized
+    if( !SoundSourceID )
+      return;
+      
+    // don't try next operations without OpenAL active
+    if( !IsOpenALActive() )
+      return;
+      
+    // stop the thread and remove any queued buffers
+    Stop();
+    
+    // unattach any buffer from the source
+    alSourcei( SoundSourceID, AL_BUFFER, 0 );
+    
+    // delete sound buffers
+    for( int i = 0; i < MAX_AL_BUFFERS; i++ )
+      alDeleteBuffers( 1, &BufferIDs[ i ] );
+      
+    // delete sound source
+    alDeleteSources( 1, &SoundSourceID );
+    SoundSourceID = 0;
+    Ring = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool OpenALAudioSink::IsOpen()
+{
+    return (SoundSourceID != 0);
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: PLAYBACK CONTROL
+// =============================================================================
+
+
+void OpenALAudioSink::Start()
+{
+    if( !IsOpen() )
+      return;
+      
+    // as an exception, this one time we will
+    // need to call this from the main thread;
+    // but it is still safe: at this point the
+    // playback thread is stopped and the sound
+    // source is stopped too
+    QueuedBlocks = Ring->GetReleasedBlocks();
+    QueueFilledBuffers();
+    
+    // the source must be playing before the
+    // thread is unpaused, or else it would
+    // take the new buffers as already played
+    alSourcePlay( SoundSourceID );
+    
+    LaunchPlaybackThread();
+    SDL_AtomicSet( &ThreadPauseFlag, 0 );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenALAudioSink::Stop()
+{
+    if( !IsOpen() )
+      return;
+      
+    // stop the playback thread first, so that
+    // it does not use the queue while we clear it
+    StopPlaybackThread();
+    
+    // stop sound emission
+    // (must be done before clearing queue or unattaching buffer)
+    alSourceStop( SoundSourceID );
+    
+    // remove any pending queued buffers
+    ClearBufferQueue();
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenALAudioSink::Pause()
+{
+    if( !IsOpen() )
+      return;
+      
+    SDL_AtomicSet( &ThreadPauseFlag, 1 );
+    alSourcePause( SoundSourceID );
+}
+
+// -----------------------------------------------------------------------------
+
+// a source that ran out of buffers is stopped, but the
+// thread will restart it once those have been unqueued
+void OpenALAudioSink::Resume()
+{
+    if( !IsOpen() )
+      return;
+      
+    ALenum SourceState = GetSourceState( SoundSourceID );
+    
+    if( SourceState == AL_PAUSED || SourceState == AL_INITIAL )
+      alSourcePlay( SoundSourceID );
+      
+    if( SDL_AtomicGet( &ThreadPauseFlag ) )
+      SDL_AtomicSet( &ThreadPauseFlag, 0 );
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: SOUND INPUT
+// =============================================================================
+
+
+void OpenALAudioSink::NotifyBlockWritten()
+{
+    if( PlaybackSemaphore )
+      SDL_SemPost( PlaybackSemaphore );
+}
+
+// -----------------------------------------------------------------------------
+
+// we will only fill half of the buffers
+// (the rest are left free for later use)
+unsigned OpenALAudioSink::GetStartingBlocks()
+{
+    return (Ring? Ring->GetCapacity() / 2 : 0);
+}
+
+// -----------------------------------------------------------------------------
+
+bool OpenALAudioSink::FollowsDeviceClock()
+{
+    return true;
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: OUTPUT VOLUME
+// =============================================================================
+
+
+void OpenALAudioSink::SetGain( float NewGain )
+{
+    Gain = NewGain;
+    
+    if( IsOpen() )
+      alSourcef( SoundSourceID, AL_GAIN, Gain );
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: HANDLING PLAYBACK THREAD
+// =============================================================================
+
+
+void OpenALAudioSink::LaunchPlaybackThread()
+{
+    LOG( "Creating audio playback thread" );
+    
+    // ensure thread continuity, but don't play yet
+    SDL_AtomicSet( &ThreadExitFlag, 0 );
+    SDL_AtomicSet( &ThreadPauseFlag, 1 );
+    
+    // create thread, if needed
+    if( !PlaybackThread )
+    {
+        PlaybackSemaphore = SDL_CreateSemaphore( 0 );
+        
+        if( !PlaybackSemaphore )
+          THROW( "Could not create semaphore for audio playback thread" );
+          
+        PlaybackThread = SDL_CreateThread
+        (
+            OpenALPlaybackThread,   // function to use as thread entry point
+            "Playback",             // thread name
+            this                    // function parameters (= the owner sink instance)
+        );
+    }
+    
+    if( !PlaybackThread )
+      THROW( "Could not create audio playback thread" );
+}
+
+// -----------------------------------------------------------------------------
+
+void OpenALAudioSink::StopPlaybackThread()
+{
+    if( !PlaybackThread )
+      return;
+      
+    LOG( "Stopping audio playback thread" );
+    
+    // wake the thread and wait for it to terminate
+    SDL_AtomicSet( &ThreadExitFlag, 1 );
+    SDL_SemPost( PlaybackSemaphore );
+    
+    int ExitCode = 0;
+    SDL_WaitThread( PlaybackThread, &ExitCode );
+    
+    SDL_DestroySemaphore( PlaybackSemaphore );
+    PlaybackThread = nullptr;
+    PlaybackSemaphore = nullptr;
+}
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK: HANDLING PLAYBACK BUFFER QUEUE
+// =============================================================================
+
+
+int OpenALAudioSink::GetQueuedBuffers()
+{
+    int QueuedBuffers = 0;
+    alGetSourcei( SoundSourceID, AL_BUFFERS_QUEUED, &QueuedBuffers );
+    
+    return max( QueuedBuffers, 0 );
+}
+
+// -----------------------------------------------------------------------------
+
+// NOTE: read the documentation for all cases regarding AL_BUFFERS_PROCESSED
+// (will only work right with source state AL_PLAYING)
+int OpenALAudioSink::GetProcessedBuffers()
+{
+    // without this check, the playback thread produces "invalid operation" error on exit
+    int SourceState;
+    alGetSourcei( SoundSourceID, AL_SOURCE_STATE, &SourceState );
+    
+    if( SourceState != AL_PLAYING )
+      return 0;
+      
+    // now do the actual check for buffers
+    int ProcessedBuffers = 0;
+    alGetSourcei( SoundSourceID, AL_BUFFERS_PROCESSED, &ProcessedBuffers );
+    
+    return max( ProcessedBuffers, 0 );
+}
+
+// -----------------------------------------------------------------------------
+
+// NOTE: read the documentation for alSourceUnqueueBuffers
+// (will only work right with source state AL_STOPPED)
+void OpenALAudioSink::ClearBufferQueue()
+{
+    int SourceState;
+    alGetSourcei( SoundSourceID, AL_SOURCE_STATE, &SourceState );
+    
+    if( SourceState != AL_STOPPED )
+      return;
+      
+    // remove all buffers from the queue
+    try
+    {
+        // obtain the number of buffers queued for play in the source
+        int QueuedBuffers = GetQueuedBuffers();
+        
+        // remove each buffer
+        while( QueuedBuffers-- )
+        {
+            ALuint QueuedBufferID = 0;
+            alSourceUnqueueBuffers( SoundSourceID, 1, &QueuedBufferID );
+        }
+        
+        // all written blocks become free
+        while( Ring->GetUsedBlocks() )
+          Ring->ReleaseBlock();
+          
+        QueuedBlocks = Ring->GetWrittenBlocks();
+    }
+    
+    catch( const exception& e )
+    {
+        cout << "[Exception caught]: " << e.what() << endl;
+        cout.flush();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// this function is only called from the playback thread;
+// it returns the milliseconds until the buffer now being
+// played is finished, which is when it has to be unqueued
+int OpenALAudioSink::GetPlaybackWaitTime()
+{
+    // each buffer holds one block
+    int BufferTime = 1 + 1000 / (Constants::FramesPerSecond * BLOCKS_PER_FRAME);
+    
+    // without queued buffers, only new blocks can
+    // give us work, and they will wake us anyway
+    if( !GetQueuedBuffers() || !IsSourcePlaying( SoundSourceID ) )
+      return BufferTime;
+      
+    // played buffers must be unqueued right away
+    if( GetProcessedBuffers() )
+      return 0;
+      
+    // the offset counts from the start of the queue, and
+    // with no processed buffers the first one is playing:
+    // that is the oldest block still not released
+    int SampleOffset = 0;
+    alGetSourcei( SoundSourceID, AL_SAMPLE_OFFSET, &SampleOffset );
+    
+    SoundBlock& PlayingBlock = Ring->GetBlock( Ring->GetReleasedBlocks() );
+    int RemainingSamples = max( (int)PlayingBlock.NumberOfSamples - SampleOffset, 0 );
+    int RemainingTime = 1 + (RemainingSamples * 1000) / Constants::SPUSamplingRate;
+    return min( RemainingTime, BufferTime );
+}
+
+// -----------------------------------------------------------------------------
+
+// this function is only called from the playback thread,
+// with only one exception for initial queuing on start
+void OpenALAudioSink::QueueFilledBuffers()
+{
+    // ignore OpenAL errors so far
+    alGetError();
+    
+    // blocks are queued in the same order they were
+    // written, each one using the OpenAL buffer of its
+    // slot; the block is kept until the buffer is played
+    while( QueuedBlocks != Ring->GetWrittenBlocks() )
+    {
+        ALuint BufferID = BufferIDs[ QueuedBlocks % Ring->GetCapacity() ];
+        SoundBlock& Block = Ring->GetBlock( QueuedBlocks );
+        
+        // copy our local buffer to internal OpenAL one
+        int BlockBytes = Block.NumberOfSamples * BYTES_PER_SAMPLE;
+        alBufferData( BufferID, AL_FORMAT_STEREO16, Block.Samples, BlockBytes, Constants::SPUSamplingRate );
+        
+        // put it in the source play queue
+        alSourceQueueBuffers( SoundSourceID, 1, &BufferID );
+        Block.QueueTime = SDL_GetPerformanceCounter();
+        QueuedBlocks++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// this function is only called from the playback thread
+void OpenALAudioSink::UnqueuePlayedBuffers()
+{
+    // state validations
+    if( !GetQueuedBuffers() )
+      return;
+      
+    // when the source runs out of buffers it stops,
+    // and all its buffers are considered processed
+    bool SourceRanOut = (GetSourceState( SoundSourceID ) == AL_STOPPED);
+    
+    // query number of queued buffers already processed
+    int ProcessedBuffers = (SourceRanOut? GetQueuedBuffers() : GetProcessedBuffers());
+    if( !ProcessedBuffers ) return;
+    
+    // unqueue every processed buffer; buffers are
+    // played in order, so they are always the oldest
+    while( ProcessedBuffers-- )
+    {
+        ALuint ProcessedBufferID = 0;
+        alSourceUnqueueBuffers( SoundSourceID, 1, &ProcessedBufferID );
+        
+        // its block is ready to be refilled
+        Ring->RegisterPlayedBlock( Ring->GetBlock( Ring->GetReleasedBlocks() ) );
+        Ring->ReleaseBlock();
+    }
+    
+    // there will be a gap before the next
+    // block is played, so count it
+    if( SourceRanOut )
+      Ring->RegisterUnderrun();
+}
+
+// -----------------------------------------------------------------------------
+
+// this function is only called from the playback thread;
+// a source that ran out of buffers needs to be restarted
+// (this is safe because the thread is only running and
+// unpaused while the SPU expects the source to be playing)
+void OpenALAudioSink::RestartStoppedPlayback()
+{
+    if( GetSourceState( SoundSourceID ) != AL_STOPPED )
+      return;
+      
+    if( GetQueuedBuffers() )
+      alSourcePlay( SoundSourceID );
+}
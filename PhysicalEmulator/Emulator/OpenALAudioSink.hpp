@@ -0,0 +1,141 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef OPENALAUDIOSINK_HPP
+    #define OPENALAUDIOSINK_HPP
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/AudioSinkInterface.hpp"
+    #include "../DesktopInfrastructure/SoundBlockRing.hpp"
+    
+    // include project headers
+    #include "VirconSPU.hpp"
+    
+    // include C/C++ headers
+    #include <string>           // [ C++ STL ] Strings
+    
+    // include OpenAL headers
+    #if defined(__APPLE__)
+      #include <OpenAL/al.h>      // [ OpenAL ] Main header
+      #include <OpenAL/alc.h>     // [ OpenAL ] Audio contexts
+    #else
+      #include <AL/al.h>          // [ OpenAL ] Main header
+      #include <AL/alc.h>         // [ OpenAL ] Audio contexts
+    #endif
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>       // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR OPENAL AUDIO
+// =============================================================================
+
+
+// each slot of the ring has its own OpenAL buffer,
+// and each buffer of sound holds a frame of blocks
+#define MAX_AL_BUFFERS  (MAX_BUFFERS * BLOCKS_PER_FRAME)
+
+
+// =============================================================================
+//      AUXILIARY AUDIO FUNCTIONS
+// =============================================================================
+
+
+// checking that OpenAL is active
+bool IsOpenALActive();
+
+// source properties
+ALenum GetSourceState( ALuint SourceID );
+bool IsSourcePlaying ( ALuint SourceID );
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE SINK
+// =============================================================================
+
+
+// thread function for background continuous play
+int OpenALPlaybackThread( void* Parameters );
+
+
+// =============================================================================
+//      OPENAL AUDIO SINK CLASS
+// =============================================================================
+
+
+// Plays sound by pushing each block to a queue of OpenAL
+// buffers. Each ring slot uses the same OpenAL buffer, and
+// it is released when that buffer is played. Latency is
+// then given by the number of blocks queued on start
+class OpenALAudioSink: public AudioSinkInterface
+{
+    public:
+    
+        // OpenAL mixer objects
+        ALuint SoundSourceID;
+        ALuint BufferIDs[ MAX_AL_BUFFERS ];
+        float Gain;
+        
+        // sound blocks to play; only the playback
+        // thread uses them while it is running
+        SoundBlockRing* Ring;
+        unsigned QueuedBlocks;
+        
+        // Variables for playback thread
+        friend int OpenALPlaybackThread( void* );
+        SDL_Thread*  PlaybackThread;
+        SDL_sem*     PlaybackSemaphore;     // posted for every written block, to wake the thread
+        
+        // variables accessed by the thread for playback control
+        std::string  ThreadErrorMessage;    // used by the playback thread to report errors on exceptions
+        SDL_atomic_t ThreadExitFlag;        // used by the main thread to stop the playing thread
+        SDL_atomic_t ThreadPauseFlag;       // used by the main thread to hold the playing thread on pause
+        
+    private:
+    
+        // handling playback buffer queue
+        int GetQueuedBuffers();
+        int GetProcessedBuffers();
+        void UnqueuePlayedBuffers();
+        void QueueFilledBuffers();
+        void RestartStoppedPlayback();
+        void ClearBufferQueue();
+        int GetPlaybackWaitTime();
+        
+        // operating the playback thread
+        void LaunchPlaybackThread();
+        void StopPlaybackThread();
+        
+    public:
+    
+        // instance handling
+        OpenALAudioSink();
+       ~OpenALAudioSink();
+       
+        // handling the output device
+        virtual void Open( SoundBlockRing& SourceRing );
+        virtual void Close();
+        virtual bool IsOpen();
+        
+        // playback control
+        virtual void Start();
+        virtual void Stop();
+        virtual void Pause();
+        virtual void Resume();
+        
+        // sound input
+        virtual void NotifyBlockWritten();
+        virtual unsigned GetStartingBlocks();
+        virtual bool FollowsDeviceClock();
+        
+        // output volume
+        virtual void SetGain( float NewGain );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
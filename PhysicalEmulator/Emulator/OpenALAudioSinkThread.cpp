@@ -1,6 +1,6 @@
 // *****************************************************************************
     // include project headers
-    #include "VirconSPU.hpp"
+    #include "OpenALAudioSink.hpp"
     
     // include C/C++ headers
     #include <stdexcept>        // [ C++ STL ] Exceptions
@@ -14,7 +14,7 @@
 /* -------------------------------------------------------------------------- //
     THREAD SAFETY CONSIDERATIONS:
     -------------------------------
-    (1) Thread needs synchronization to access VirconSPU instance variables
+    (1) Thread needs synchronization to access sink instance variables
     (2) Any exceptions thrown need to be caught, since they cannot trespass
         the boundary to the main thread
 // -------------------------------------------------------------------------- */
@@ -25,7 +25,7 @@
 // =============================================================================
 
 
-int SPUPlaybackThread( void* Parameters )
+int OpenALPlaybackThread( void* Parameters )
 {
     // thread exit code defaults to success
     int ExitCode = 0;
@@ -33,28 +33,33 @@ int SPUPlaybackThread( void* Parameters )
     // (1) obtain class instance from parameters
     if( !Parameters )
     {
-        throw runtime_error( "Vircon SPU instance not received" );
+        throw runtime_error( "OpenAL audio sink instance not received" );
         return 1;
     }
     
-    VirconSPU* SPUInstance = (VirconSPU*)Parameters;
+    OpenALAudioSink* SinkInstance = (OpenALAudioSink*)Parameters;
     
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     
     try
     {
-        // (2) keep thread alive until the SPU stops it
-        while( !SPUInstance->ThreadExitFlag )
+        // (2) keep thread alive until the sink stops it
+        while( !SDL_AtomicGet( &SinkInstance->ThreadExitFlag ) )
         {
             // (2.1) if not paused, update sound buffers
-            if( !SPUInstance->ThreadPauseFlag )
+            if( !SDL_AtomicGet( &SinkInstance->ThreadPauseFlag ) )
             {
-                SPUInstance->QueueFilledBuffers();
-                SPUInstance->UnqueuePlayedBuffers();
+                SinkInstance->UnqueuePlayedBuffers();
+                SinkInstance->QueueFilledBuffers();
+                SinkInstance->RestartStoppedPlayback();
             }
             
-            // (2.2) when idle, sleep and re-check playback state periodically
-            SDL_Delay( 5 );
+            // (2.2) sleep until a new block is written or the
+            // current buffer finishes playing, whichever first
+            int WaitTime = SinkInstance->GetPlaybackWaitTime();
+            
+            if( WaitTime > 0 )
+              SDL_SemWaitTimeout( SinkInstance->PlaybackSemaphore, WaitTime );
         }
     }
     
@@ -69,7 +74,7 @@ int SPUPlaybackThread( void* Parameters )
         
         // store exception message to treat it in the main thread
         // (necessary since exceptions do not cross threads)
-        SPUInstance->ThreadErrorMessage = e.what();
+        SinkInstance->ThreadErrorMessage = e.what();
         
         // provide an error exit code
         ExitCode = 1;
@@ -0,0 +1,169 @@
+// *****************************************************************************
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    #include "../DesktopInfrastructure/HashFunctions.hpp"
+    
+    // include project headers
+    #include "OutputHasher.hpp"
+    
+    // include C/C++ headers
+    #include <cstdio>           // [ ANSI C ] Standard I/O
+    #include <cinttypes>        // [ ANSI C ] Integer format macros
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      OUTPUT HASHER: INSTANCE HANDLING
+// =============================================================================
+
+
+OutputHasher::OutputHasher()
+{
+    Logging = false;
+    FrameCounter = nullptr;
+    SoundFrameNumber = 0;
+    SoundHash = 0;
+    SoundFrameStarted = false;
+    LastImageFrameNumber = 0;
+    LoggedImageFrames = 0;
+    LoggedSoundFrames = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+OutputHasher::~OutputHasher()
+{
+    if( Logging )
+      LOG( "WARNING: Output hasher was destroyed while still logging" );
+}
+
+
+// =============================================================================
+//      OUTPUT HASHER: LOGGING CONTROL
+// =============================================================================
+
+
+void OutputHasher::StartLogging( const string& NewFilePath, const int32_t* EmulatorFrameCounter )
+{
+    StopLogging();
+    
+    LOG( "Logging output hashes to file \"" << NewFilePath << "\"" );
+    ImageLogFile.open( NewFilePath );
+    SoundLogFile.open( NewFilePath + ".sound" );
+    
+    if( ImageLogFile.fail() || SoundLogFile.fail() )
+      THROW( "Cannot open output hash log files" );
+      
+    ImageLogFile << "# frame image-hash" << endl;
+    SoundLogFile << "# frame sound-hash" << endl;
+    
+    FilePath = NewFilePath;
+    FrameCounter = EmulatorFrameCounter;
+    SoundFrameStarted = false;
+    LastImageFrameNumber = 0;
+    LoggedImageFrames = 0;
+    LoggedSoundFrames = 0;
+    Logging = true;
+}
+
+// -----------------------------------------------------------------------------
+
+// it must have been disconnected from all producers first
+void OutputHasher::StopLogging()
+{
+    if( !Logging )
+      return;
+      
+    // the sound of the last frame is still pending
+    if( SoundFrameStarted )
+      WriteSoundHash();
+      
+    ImageLogFile.close();
+    SoundLogFile.close();
+    Logging = false;
+    
+    LOG( "Logged output hashes for " << LoggedImageFrames << " images and " << LoggedSoundFrames << " sound frames to file \"" << FilePath << "\"" );
+}
+
+
+// =============================================================================
+//      OUTPUT HASHER: RECEIVING DATA
+// =============================================================================
+
+
+// called from the framebuffer readback thread
+void OutputHasher::ProcessFrame( const GPUColor* Pixels, uint64_t FrameNumber )
+{
+    // nothing was emulated since the last frame
+    if( FrameNumber == LastImageFrameNumber )
+      return;
+      
+    // frames that never reached us are logged as
+    // skipped, so that gaps are not taken as matches
+    char Line[ 64 ];
+    int Length;
+    
+    uint64_t FirstSkipped = (LoggedImageFrames > 0? LastImageFrameNumber + 1 : FrameNumber);
+    
+    for( uint64_t Skipped = FirstSkipped; Skipped < FrameNumber; Skipped++ )
+    {
+        Length = snprintf( Line, sizeof( Line ), "%08" PRIu64 " skipped\n", Skipped );
+        ImageLogFile.write( Line, Length );
+    }
+    
+    LastImageFrameNumber = FrameNumber;
+    uint64_t ImageHash = HashXXH64( Pixels, Constants::ScreenPixels * sizeof( GPUColor ) );
+    
+    // use a fixed width format to ease comparisons
+    Length = snprintf( Line, sizeof( Line ), "%08" PRIu64 " %016" PRIx64 "\n", FrameNumber, ImageHash );
+    ImageLogFile.write( Line, Length );
+    LoggedImageFrames++;
+}
+
+// -----------------------------------------------------------------------------
+
+// hashes are only useful if no frame is skipped
+bool OutputHasher::NeedsAllFrames()
+{
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// called from the main thread, while a frame is emulated
+void OutputHasher::ProcessSound( const SPUSample* Samples, unsigned NumberOfSamples )
+{
+    uint64_t FrameNumber = *FrameCounter;
+    
+    // a frame receives its sound in several blocks,
+    // so its hash is complete when the next one starts
+    if( SoundFrameStarted && FrameNumber != SoundFrameNumber )
+      WriteSoundHash();
+      
+    if( SoundFrameStarted )
+      SoundHash = HashXXH64( Samples, NumberOfSamples * sizeof( SPUSample ), SoundHash );
+      
+    else
+    {
+        SoundFrameNumber = FrameNumber;
+        SoundHash = HashXXH64( Samples, NumberOfSamples * sizeof( SPUSample ) );
+        SoundFrameStarted = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void OutputHasher::WriteSoundHash()
+{
+    char Line[ 64 ];
+    int Length = snprintf( Line, sizeof( Line ), "%08" PRIu64 " %016" PRIx64 "\n", SoundFrameNumber, SoundHash );
+    SoundLogFile.write( Line, Length );
+    LoggedSoundFrames++;
+    SoundFrameStarted = false;
+}
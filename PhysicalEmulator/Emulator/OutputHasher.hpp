@@ -0,0 +1,80 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef OUTPUTHASHER_HPP
+    #define OUTPUTHASHER_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/FrameConsumerInterface.hpp"
+    #include "../DesktopInfrastructure/SoundConsumerInterface.hpp"
+    
+    // include C/C++ headers
+    #include <string>       // [ C++ STL ] Strings
+    #include <fstream>      // [ C++ STL ] File streams
+// *****************************************************************************
+
+
+// =============================================================================
+//      OUTPUT HASHER CLASS
+// =============================================================================
+
+
+// Saves logs with a hash of the image and the sound of
+// each emulated frame. When the same inputs are given to
+// two builds of the emulator, comparing their logs shows
+// the first frame where their outputs differ. Images and
+// sound arrive from different threads, so each is saved to
+// its own log (sound goes to the same path plus ".sound").
+// Each line has the frame number and its hash, or
+// "skipped" for images that were not received
+class OutputHasher: public FrameConsumerInterface, public SoundConsumerInterface
+{
+    public:
+    
+        // output files
+        std::string FilePath;
+        std::ofstream ImageLogFile;
+        std::ofstream SoundLogFile;
+        bool Logging;
+        
+        // the emulator counter of frames since power on
+        // (only read from the main thread)
+        const int32_t* FrameCounter;
+        
+        // sound hash of the frame being emulated
+        uint64_t SoundFrameNumber;
+        uint64_t SoundHash;
+        bool SoundFrameStarted;
+        
+        // logged frames
+        uint64_t LastImageFrameNumber;
+        unsigned LoggedImageFrames;
+        unsigned LoggedSoundFrames;
+        
+    private:
+    
+        void WriteSoundHash();
+        
+    public:
+    
+        // instance handling
+        OutputHasher();
+       ~OutputHasher();
+       
+        // logging control
+        void StartLogging( const std::string& NewFilePath, const int32_t* EmulatorFrameCounter );
+        void StopLogging();
+        
+        // receiving data
+        virtual void ProcessFrame( const GPUColor* Pixels, uint64_t FrameNumber );
+        virtual bool NeedsAllFrames();
+        virtual void ProcessSound( const SPUSample* Samples, unsigned NumberOfSamples );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -0,0 +1,264 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    
+    // include project headers
+    #include "SDLAudioSink.hpp"
+    
+    // include C/C++ headers
+    #include <cstring>          // [ ANSI C ] Strings
+    #include <string>           // [ C++ STL ] Strings
+    #include <algorithm>        // [ C++ STL ] Algorithms
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE SINK
+// =============================================================================
+
+
+void SDLAudioCallback( void* UserData, Uint8* Stream, int Length )
+{
+    SDLAudioSink* Sink = (SDLAudioSink*)UserData;
+    Sink->ReadSamples( (SPUSample*)Stream, Length / sizeof( SPUSample ) );
+}
+
+
+// =============================================================================
+//      SDL AUDIO SINK: INSTANCE HANDLING
+// =============================================================================
+
+
+SDLAudioSink::SDLAudioSink()
+{
+    DeviceID = 0;
+    Playing = false;
+    
+    // default period is about 6 ms
+    PeriodSamples = 256;
+    
+    Ring = nullptr;
+    ReadPosition = 0;
+    Starving = false;
+    Gain = 1.0;
+}
+
+// -----------------------------------------------------------------------------
+
+SDLAudioSink::~SDLAudioSink()
+{
+    Close();
+}
+
+
+// =============================================================================
+//      SDL AUDIO SINK: HANDLING THE OUTPUT DEVICE
+// =============================================================================
+
+
+void SDLAudioSink::Open( SoundBlockRing& SourceRing )
+{
+    LOG( "Opening SDL audio output" );
+    Ring = &SourceRing;
+    
+    // request the same format that the SPU generates,
+    // so that SDL will not need to convert our sound
+    SDL_AudioSpec DesiredSpec, ObtainedSpec;
+    SDL_zero( DesiredSpec );
+    DesiredSpec.freq = Constants::SPUSamplingRate;
+    DesiredSpec.format = AUDIO_S16SYS;
+    DesiredSpec.channels = 2;
+    DesiredSpec.samples = PeriodSamples;
+    DesiredSpec.callback = SDLAudioCallback;
+    DesiredSpec.userdata = this;
+    
+    // the device is created paused
+    DeviceID = SDL_OpenAudioDevice( nullptr, 0, &DesiredSpec, &ObtainedSpec, 0 );
+    
+    if( !DeviceID )
+      THROW( string("Cannot open SDL audio device: ") + SDL_GetError() );
+      
+    LOG( "SDL audio period: " << ObtainedSpec.samples << " samples" );
+    Playing = false;
+}
+
+// -----------------------------------------------------------------------------
+
+void SDLAudioSink::Close()
+{
+    if( !DeviceID )
+      return;
+      
+    Stop();
+    SDL_CloseAudioDevice( DeviceID );
+    
+    DeviceID = 0;
+    Ring = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool SDLAudioSink::IsOpen()
+{
+    return (DeviceID != 0);
+}
+
+
+// =============================================================================
+//      SDL AUDIO SINK: PLAYBACK CONTROL
+// =============================================================================
+
+
+void SDLAudioSink::Start()
+{
+    if( !IsOpen() )
+      return;
+      
+    // the callback is not running
+    // while the device is paused
+    ReadPosition = 0;
+    Starving = false;
+    
+    SDL_PauseAudioDevice( DeviceID, 0 );
+    Playing = true;
+}
+
+// -----------------------------------------------------------------------------
+
+// pausing the device waits for the callback to
+// finish, so after this the ring is not in use
+void SDLAudioSink::Stop()
+{
+    if( !IsOpen() )
+      return;
+      
+    SDL_PauseAudioDevice( DeviceID, 1 );
+    Playing = false;
+}
+
+// -----------------------------------------------------------------------------
+
+void SDLAudioSink::Pause()
+{
+    Stop();
+}
+
+// -----------------------------------------------------------------------------
+
+void SDLAudioSink::Resume()
+{
+    if( !IsOpen() || Playing )
+      return;
+      
+    SDL_PauseAudioDevice( DeviceID, 0 );
+    Playing = true;
+}
+
+
+// =============================================================================
+//      SDL AUDIO SINK: SOUND INPUT
+// =============================================================================
+
+
+// the device takes sound when it needs it,
+// so nothing has to be done for new blocks
+void SDLAudioSink::NotifyBlockWritten()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+// sound is generated in bursts of a frame, so
+// that much has to be available between them
+unsigned SDLAudioSink::GetStartingBlocks()
+{
+    return BLOCKS_PER_FRAME;
+}
+
+// -----------------------------------------------------------------------------
+
+bool SDLAudioSink::FollowsDeviceClock()
+{
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// this function is only called from the SDL audio thread;
+// the current block is released only when fully played
+void SDLAudioSink::ReadSamples( SPUSample* Samples, unsigned NumberOfSamples )
+{
+    while( NumberOfSamples > 0 )
+    {
+        // when there is no sound, play silence
+        // until the emulator generates more
+        if( !Ring->GetUsedBlocks() )
+        {
+            memset( Samples, 0, NumberOfSamples * sizeof( SPUSample ) );
+            
+            if( !Starving )
+              Ring->RegisterUnderrun();
+              
+            Starving = true;
+            return;
+        }
+        
+        Starving = false;
+        
+        // copy as much as we can from the oldest block
+        SoundBlock& Block = Ring->GetBlock( Ring->GetReleasedBlocks() );
+        
+        if( ReadPosition == 0 )
+          Block.QueueTime = SDL_GetPerformanceCounter();
+          
+        unsigned CopiedSamples = min( NumberOfSamples, Block.NumberOfSamples - ReadPosition );
+        const SPUSample* BlockSamples = &Block.Samples[ ReadPosition ];
+        
+        if( Gain >= 1.0 )
+          memcpy( Samples, BlockSamples, CopiedSamples * sizeof( SPUSample ) );
+          
+        else
+        {
+            for( unsigned i = 0; i < CopiedSamples; i++ )
+            {
+                Samples[ i ].LeftSample  = BlockSamples[ i ].LeftSample  * Gain;
+                Samples[ i ].RightSample = BlockSamples[ i ].RightSample * Gain;
+            }
+        }
+        
+        ReadPosition += CopiedSamples;
+        Samples += CopiedSamples;
+        NumberOfSamples -= CopiedSamples;
+        
+        // advance to the next block; its end is still
+        // to be played by the device, so the measured
+        // latency does not include the device period
+        if( ReadPosition == Block.NumberOfSamples )
+        {
+            Ring->RegisterPlayedBlock( Block );
+            Ring->ReleaseBlock();
+            ReadPosition = 0;
+        }
+    }
+}
+
+
+// =============================================================================
+//      SDL AUDIO SINK: OUTPUT VOLUME
+// =============================================================================
+
+
+// the callback must not see the gain change mid-period
+void SDLAudioSink::SetGain( float NewGain )
+{
+    if( IsOpen() )
+      SDL_LockAudioDevice( DeviceID );
+      
+    Gain = NewGain;
+    
+    if( IsOpen() )
+      SDL_UnlockAudioDevice( DeviceID );
+}
@@ -0,0 +1,103 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef SDLAUDIOSINK_HPP
+    #define SDLAUDIOSINK_HPP
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/AudioSinkInterface.hpp"
+    #include "../DesktopInfrastructure/SoundBlockRing.hpp"
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>       // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR SDL AUDIO
+// =============================================================================
+
+
+// the device asks for sound in periods of this size,
+// in samples; it must be a power of 2 in this range
+#define MIN_AUDIO_PERIOD    128
+#define MAX_AUDIO_PERIOD   4096
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE SINK
+// =============================================================================
+
+
+// called from the SDL audio thread when
+// the device needs more samples to play
+void SDLAudioCallback( void* UserData, Uint8* Stream, int Length );
+
+
+// =============================================================================
+//      SDL AUDIO SINK CLASS
+// =============================================================================
+
+
+// Plays sound through an SDL audio device in pull mode: the
+// device callback takes samples from the ring as it needs
+// them, in short periods. Unlike a queue of whole buffers,
+// only one frame needs to be written ahead, so latency is
+// close to a frame plus the period of the device
+class SDLAudioSink: public AudioSinkInterface
+{
+    public:
+    
+        // SDL audio device
+        SDL_AudioDeviceID DeviceID;
+        bool Playing;
+        
+        // configuration
+        unsigned PeriodSamples;
+        
+        // sound blocks to play, and state only used
+        // by the callback while the device is playing
+        SoundBlockRing* Ring;
+        unsigned ReadPosition;      // samples already played from the oldest block
+        bool Starving;              // to count each underrun only once
+        float Gain;
+        
+        // the callback reads state of the sink
+        friend void SDLAudioCallback( void*, Uint8*, int );
+        
+    private:
+    
+        // done in the callback
+        void ReadSamples( SPUSample* Samples, unsigned NumberOfSamples );
+        
+    public:
+    
+        // instance handling
+        SDLAudioSink();
+       ~SDLAudioSink();
+       
+        // handling the output device
+        virtual void Open( SoundBlockRing& SourceRing );
+        virtual void Close();
+        virtual bool IsOpen();
+        
+        // playback control
+        virtual void Start();
+        virtual void Stop();
+        virtual void Pause();
+        virtual void Resume();
+        
+        // sound input
+        virtual void NotifyBlockWritten();
+        virtual unsigned GetStartingBlocks();
+        virtual bool FollowsDeviceClock();
+        
+        // output volume
+        virtual void SetGain( float NewGain );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
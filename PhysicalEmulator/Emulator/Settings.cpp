@@ -399,10 +399,23 @@ void SetDefaultSettings()
     
     // video configuration
     SetFullScreen();
+    Vircon.GPU.Renderer = &OpenGL2D;
+    ThreadedOpenGL2D.Enabled = false;
+    Software2D.StopWorkers();
+    Vircon.GPU.Recorder.StopRecording();
+    StopVideoRecording();
+    StopOutputHashing();
+    DisableGPUTiming();
+    MainLoopPacer.ReportEnabled = false;
     
     // audio configuration
+    Vircon.SPU.Sink = &OpenALSink;
+    Vircon.SPU.RateControlEnabled = true;
+    Vircon.SPU.ReportEnabled = false;
+    Vircon.SPU.CloseTimingFile();
     Vircon.SetMute( false );
     Vircon.SetOutputVolume( 1.0 );
+    Vircon.StreamCartridgeSounds = false;
     
     // unloaded cartridge
     Vircon.UnloadCartridge();
@@ -456,12 +469,103 @@ void LoadSettings( const string& FilePath )
         if( BiosElement )
           BiosFileName = GetRequiredStringAttribute( BiosElement, "file" );
         
-        // load video settings (omitted)
+        // load video settings
         SetFullScreen();
         
+        // load video renderer (optional)
+        XMLElement* VideoElement = SettingsRoot->FirstChildElement( "video" );
+        
+        if( VideoElement )
+        {
+            string RendererName = GetRequiredStringAttribute( VideoElement, "renderer" );
+            RendererName = ToLowerCase( RendererName );
+            
+            if( RendererName == "opengl" )
+              Vircon.GPU.Renderer = &OpenGL2D;
+              
+            else if( RendererName == "software" )
+              Vircon.GPU.Renderer = &Software2D;
+              
+            else
+              THROW( "Video renderer must be either 'opengl' or 'software'" );
+              
+            // the software renderer can use worker threads;
+            // by default leave a core for emulation and one
+            // for the rest of the system (audio, drivers...)
+            if( Vircon.GPU.Renderer == &Software2D )
+            {
+                int RenderThreads = max( 0, SDL_GetCPUCount() - 2 );
+                VideoElement->QueryIntAttribute( "threads", &RenderThreads );
+                Clamp( RenderThreads, 0, MAX_RENDER_THREADS );
+                Software2D.StartWorkers( RenderThreads );
+            }
+            
+            // the OpenGL renderer can run in its own thread,
+            // so that driver work does not stall emulation
+            else if( VideoElement->FindAttribute( "render-thread" ) )
+              ThreadedOpenGL2D.Enabled = GetRequiredYesNoAttribute( VideoElement, "render-thread" );
+        }
+        
+        // load GPU recording (optional)
+        XMLElement* GPURecordingElement = SettingsRoot->FirstChildElement( "gpu-recording" );
+        
+        if( GPURecordingElement )
+        {
+            string RecordingPath = GetRequiredStringAttribute( GPURecordingElement, "file" );
+            Vircon.GPU.Recorder.StartRecording( RecordingPath );
+        }
+        
+        // load video recording (optional)
+        XMLElement* VideoRecordingElement = SettingsRoot->FirstChildElement( "video-recording" );
+        
+        if( VideoRecordingElement )
+        {
+            string RecordingPath = GetRequiredStringAttribute( VideoRecordingElement, "file" );
+            StartVideoRecording( RecordingPath );
+        }
+        
+        // load output hashing (optional)
+        XMLElement* OutputHashesElement = SettingsRoot->FirstChildElement( "output-hashes" );
+        
+        if( OutputHashesElement )
+        {
+            string LogFilePath = GetRequiredStringAttribute( OutputHashesElement, "file" );
+            StartOutputHashing( LogFilePath );
+        }
+        
+        // load GPU timing (optional)
+        if( SettingsRoot->FirstChildElement( "gpu-timing" ) )
+          EnableGPUTiming();
+          
+        // load frame timing (optional)
+        MainLoopPacer.ReportEnabled = (SettingsRoot->FirstChildElement( "frame-timing" ) != nullptr);
+        
+        // load run-ahead (optional); frames shown
+        // are emulated ahead to reduce input latency
+        XMLElement* RunAheadElement = SettingsRoot->FirstChildElement( "run-ahead" );
+        
+        if( RunAheadElement )
+        {
+            int RunAheadFrames = GetRequiredIntegerAttribute( RunAheadElement, "frames" );
+            Clamp( RunAheadFrames, 0, MAX_RUN_AHEAD_FRAMES );
+            Vircon.RunAheadFrames = RunAheadFrames;
+        }
+        
         // load audio settings (omitted)
         Vircon.SetOutputVolume( 1.0 );
         
+        // load sound streaming (optional); this
+        // limits memory used by cartridge sounds
+        XMLElement* SoundStreamingElement = SettingsRoot->FirstChildElement( "sound-streaming" );
+        Vircon.StreamCartridgeSounds = (SoundStreamingElement != nullptr);
+        
+        if( SoundStreamingElement )
+        {
+            int MaxMegabytes = GetRequiredIntegerAttribute( SoundStreamingElement, "max-memory" );
+            Clamp( MaxMegabytes, 1, 1024 );
+            Vircon.SPU.MaxResidentBytes = (uint64_t)MaxMegabytes << 20;
+        }
+        
         // load audio buffers settings
         XMLElement* AudioBuffersElement = GetRequiredElement( SettingsRoot, "audio-buffers" );
         int NumberOfBuffers = GetRequiredIntegerAttribute( AudioBuffersElement, "number" );
@@ -470,6 +574,64 @@ void LoadSettings( const string& FilePath )
         // apply audio buffers settings
         Vircon.SPU.NumberOfBuffers = NumberOfBuffers;
         
+        // load audio output (optional); the SDL output
+        // takes sound from the emulator in short periods
+        // as it plays, so it can achieve lower latency;
+        // the other 2 need no sound device, for headless
+        // runs: sound can be discarded or saved to a file
+        XMLElement* AudioOutputElement = SettingsRoot->FirstChildElement( "audio-output" );
+        
+        if( AudioOutputElement )
+        {
+            string SinkName = GetRequiredStringAttribute( AudioOutputElement, "sink" );
+            SinkName = ToLowerCase( SinkName );
+            
+            if( SinkName == "openal" )
+              Vircon.SPU.Sink = &OpenALSink;
+              
+            else if( SinkName == "sdl" )
+              Vircon.SPU.Sink = &SDLSink;
+              
+            else if( SinkName == "null" )
+              Vircon.SPU.Sink = &NullSink;
+              
+            else if( SinkName == "wav" )
+            {
+                WAVSink.FilePath = GetRequiredStringAttribute( AudioOutputElement, "file" );
+                Vircon.SPU.Sink = &WAVSink;
+            }
+            
+            else
+              THROW( "Audio output must be one of 'openal', 'sdl', 'null' or 'wav'" );
+              
+            // periods are rounded up to a power of 2
+            if( Vircon.SPU.Sink == &SDLSink && AudioOutputElement->FindAttribute( "period" ) )
+            {
+                int PeriodSamples = GetRequiredIntegerAttribute( AudioOutputElement, "period" );
+                Clamp( PeriodSamples, MIN_AUDIO_PERIOD, MAX_AUDIO_PERIOD );
+                
+                SDLSink.PeriodSamples = MIN_AUDIO_PERIOD;
+                
+                while( (int)SDLSink.PeriodSamples < PeriodSamples )
+                  SDLSink.PeriodSamples *= 2;
+            }
+        }
+        
+        // load audio rate control (optional); it is
+        // enabled unless this disables it explicitly
+        XMLElement* RateControlElement = SettingsRoot->FirstChildElement( "audio-rate-control" );
+        
+        if( RateControlElement )
+          Vircon.SPU.RateControlEnabled = GetRequiredYesNoAttribute( RateControlElement, "enabled" );
+          
+        // load audio timing (optional); besides the
+        // log, reports can also be saved as CSV lines
+        XMLElement* AudioTimingElement = SettingsRoot->FirstChildElement( "audio-timing" );
+        Vircon.SPU.ReportEnabled = (AudioTimingElement != nullptr);
+        
+        if( AudioTimingElement && AudioTimingElement->FindAttribute( "file" ) )
+          Vircon.SPU.OpenTimingFile( GetRequiredStringAttribute( AudioTimingElement, "file" ) );
+          
         // configure gamepads
         for( int Gamepad = 0; Gamepad < Constants::MaximumGamepads; Gamepad++ )
         {
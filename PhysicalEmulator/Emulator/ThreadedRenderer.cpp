@@ -0,0 +1,555 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    #include "../DesktopInfrastructure/OpenGL2DContext.hpp"
+    
+    // include project headers
+    #include "ThreadedRenderer.hpp"
+    #include "Globals.hpp"
+    #include "GUI.hpp"
+    
+    // include C/C++ headers
+    #include <cstring>      // [ ANSI C ] Strings
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE RENDERER
+// =============================================================================
+
+
+int OpenGLRenderThread( void* Parameters )
+{
+    ThreadedRenderer* Renderer = (ThreadedRenderer*)Parameters;
+    
+    // the GL context can only be current in one thread;
+    // report to the starting thread if we could take it
+    bool ContextIsCurrent = !SDL_GL_MakeCurrent( OpenGL2D.Window, OpenGL2D.OpenGLContext );
+    Renderer->ThreadExitFlag = !ContextIsCurrent;
+    SDL_SemPost( Renderer->WorkEndSemaphore );
+    
+    if( !ContextIsCurrent )
+      return 1;
+      
+    while( true )
+    {
+        SDL_SemWait( Renderer->WorkStartSemaphore );
+        
+        if( Renderer->ThreadExitFlag )
+          break;
+          
+        // errors are passed to the emulation thread,
+        // which will find them at its next wait
+        try
+        {
+            if( Renderer->PendingCall )
+              Renderer->PendingCall( Renderer->PendingCallData );
+              
+            else
+            {
+                RenderFrame& Frame = Renderer->Frames[ 1 - Renderer->RecordedFrame ];
+                Renderer->DrawFrame( Frame );
+                
+                if( Frame.Present )
+                  Renderer->PresentFrame( Frame );
+            }
+        }
+        
+        catch( ... )
+        {
+            Renderer->RenderError = current_exception();
+        }
+        
+        Renderer->PendingCall = nullptr;
+        SDL_SemPost( Renderer->WorkEndSemaphore );
+    }
+    
+    // give the context back for the main thread
+    SDL_GL_MakeCurrent( OpenGL2D.Window, nullptr );
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// texture creation done as a synchronous call
+typedef struct
+{
+    void* Pixels;
+    unsigned Width, Height;
+    unsigned TextureID;
+}
+TextureCreation;
+
+void CreateTextureInRenderThread( void* Data )
+{
+    TextureCreation* Creation = (TextureCreation*)Data;
+    Creation->TextureID = OpenGL2D.CreateTexture( Creation->Pixels, Creation->Width, Creation->Height );
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: INSTANCE HANDLING
+// =============================================================================
+
+
+ThreadedRenderer::ThreadedRenderer()
+{
+    RecordedFrame = 0;
+    WorkPending = false;
+    memset( &NextQuad, 0, sizeof( NextQuad ) );
+    NextQuad.Type = RenderCommandTypes::DrawQuad;
+    
+    PendingCall = nullptr;
+    PendingCallData = nullptr;
+    
+    RenderThread = nullptr;
+    WorkStartSemaphore = nullptr;
+    WorkEndSemaphore = nullptr;
+    ThreadExitFlag = false;
+    
+    // by default, render in the emulation thread
+    Enabled = false;
+}
+
+// -----------------------------------------------------------------------------
+
+ThreadedRenderer::~ThreadedRenderer()
+{
+    Stop();
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: THREAD CONTROL
+// =============================================================================
+
+
+void ThreadedRenderer::Start()
+{
+    Stop();
+    
+    WorkStartSemaphore = SDL_CreateSemaphore( 0 );
+    WorkEndSemaphore = SDL_CreateSemaphore( 0 );
+    
+    if( !WorkStartSemaphore || !WorkEndSemaphore )
+      THROW( "Cannot create semaphores for the render thread" );
+      
+    // start recording on an empty frame
+    RecordedFrame = 0;
+    Frames[ 0 ].Commands.clear();
+    Frames[ 1 ].Commands.clear();
+    
+    // the new thread takes the GL context from us
+    SDL_GL_MakeCurrent( OpenGL2D.Window, nullptr );
+    ThreadExitFlag = false;
+    RenderThread = SDL_CreateThread( OpenGLRenderThread, "RenderThread", this );
+    
+    if( RenderThread )
+      SDL_SemWait( WorkEndSemaphore );
+      
+    // on failure we can still render from this thread
+    if( !RenderThread || ThreadExitFlag )
+    {
+        LOG( "WARNING: Cannot start render thread: " << SDL_GetError() );
+        
+        if( RenderThread )
+          SDL_WaitThread( RenderThread, nullptr );
+          
+        RenderThread = nullptr;
+        SDL_GL_MakeCurrent( OpenGL2D.Window, OpenGL2D.OpenGLContext );
+        Stop();
+        return;
+    }
+    
+    LOG( "OpenGL renderer using a separate render thread" );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::Stop()
+{
+    if( RenderThread )
+    {
+        // draw anything that is still pending
+        try
+        {
+            SubmitWork( false );
+            WaitForRenderThread();
+        }
+        
+        catch( exception& e )
+        {
+            LOG( "WARNING: Render thread error: " << e.what() );
+        }
+        
+        // wake the thread and wait for it to exit
+        ThreadExitFlag = true;
+        SDL_SemPost( WorkStartSemaphore );
+        SDL_WaitThread( RenderThread, nullptr );
+        RenderThread = nullptr;
+        
+        // GL is used from this thread again
+        SDL_GL_MakeCurrent( OpenGL2D.Window, OpenGL2D.OpenGLContext );
+    }
+    
+    ThreadExitFlag = false;
+    WorkPending = false;
+    
+    if( WorkStartSemaphore ) SDL_DestroySemaphore( WorkStartSemaphore );
+    if( WorkEndSemaphore ) SDL_DestroySemaphore( WorkEndSemaphore );
+    WorkStartSemaphore = nullptr;
+    WorkEndSemaphore = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool ThreadedRenderer::IsRunning()
+{
+    return (RenderThread != nullptr);
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::WaitForRenderThread()
+{
+    if( !WorkPending )
+      return;
+      
+    SDL_SemWait( WorkEndSemaphore );
+    WorkPending = false;
+    
+    if( RenderError )
+    {
+        exception_ptr Error = RenderError;
+        RenderError = nullptr;
+        rethrow_exception( Error );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::RunInRenderThread( void (*Function)( void* ), void* Data )
+{
+    if( !RenderThread )
+    {
+        Function( Data );
+        return;
+    }
+    
+    WaitForRenderThread();
+    
+    PendingCall = Function;
+    PendingCallData = Data;
+    WorkPending = true;
+    SDL_SemPost( WorkStartSemaphore );
+    
+    WaitForRenderThread();
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: WORK SUBMISSION
+// =============================================================================
+
+
+// the previous frame must be drawn before its buffer
+// is reused, so at most one frame is waiting while
+// the emulation thread records the next one
+void ThreadedRenderer::SubmitWork( bool Present )
+{
+    WaitForRenderThread();
+    
+    Frames[ RecordedFrame ].Present = Present;
+    RecordedFrame = 1 - RecordedFrame;
+    Frames[ RecordedFrame ].Commands.clear();
+    
+    WorkPending = true;
+    SDL_SemPost( WorkStartSemaphore );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::SubmitFrame( bool PowerIsOn, uint64_t FrameNumber, float GPULoad, IOPortValues ActiveBlending, GPUColor MultiplyColor, bool IsRedraw )
+{
+    RenderFrame& Frame = Frames[ RecordedFrame ];
+    Frame.PowerIsOn = PowerIsOn;
+    Frame.FrameNumber = FrameNumber;
+    Frame.GPULoad = GPULoad;
+    Frame.ActiveBlending = ActiveBlending;
+    Frame.MultiplyColor = MultiplyColor;
+    Frame.IsRedraw = IsRedraw;
+    
+    SubmitWork( true );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::AddCommand( RenderCommandTypes Type )
+{
+    Frames[ RecordedFrame ].Commands.emplace_back();
+    Frames[ RecordedFrame ].Commands.back().Type = Type;
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: WORK DONE IN THE RENDER THREAD
+// =============================================================================
+
+
+void ThreadedRenderer::DrawFrame( RenderFrame& Frame )
+{
+    OpenGL2D.RenderToFramebuffer();
+    
+    // only new emulator frames are timed
+    bool IsTimed = Frame.Present && !Frame.IsRedraw;
+    
+    if( IsTimed )
+      OpenGL2D.BeginTimedPhase( GPUTimedPhases::EmulatorDrawing );
+      
+    for( RenderCommand& Command: Frame.Commands )
+    {
+        switch( Command.Type )
+        {
+            case RenderCommandTypes::RenderToFramebuffer:
+                OpenGL2D.RenderToFramebuffer();
+                break;
+                
+            case RenderCommandTypes::FinishFrame:
+                OpenGL2D.FinishFrame();
+                break;
+                
+            case RenderCommandTypes::BeginSpeculativeDrawing:
+                OpenGL2D.BeginSpeculativeDrawing();
+                break;
+                
+            case RenderCommandTypes::EndSpeculativeDrawing:
+                OpenGL2D.EndSpeculativeDrawing();
+                break;
+                
+            case RenderCommandTypes::DestroyTexture:
+                OpenGL2D.DestroyTexture( Command.TextureID );
+                break;
+                
+            case RenderCommandTypes::SetMultiplyColor:
+                OpenGL2D.SetMultiplyColor( Command.Color );
+                break;
+                
+            case RenderCommandTypes::SetBlendingMode:
+                OpenGL2D.SetBlendingMode( Command.BlendingMode );
+                break;
+                
+            case RenderCommandTypes::ClearScreen:
+                OpenGL2D.ClearScreen( Command.Color );
+                break;
+                
+            case RenderCommandTypes::DrawQuad:
+            {
+                OpenGL2D.BindTexture( Command.TextureID );
+                
+                for( int Vertex = 0; Vertex < 4; Vertex++ )
+                {
+                    OpenGL2D.SetQuadVertexPosition( Vertex, Command.VertexPositions[ Vertex ][ 0 ], Command.VertexPositions[ Vertex ][ 1 ] );
+                    OpenGL2D.SetQuadVertexTexCoords( Vertex, Command.VertexTexCoords[ Vertex ][ 0 ], Command.VertexTexCoords[ Vertex ][ 1 ] );
+                }
+                
+                OpenGL2D.SetTranslation( Command.TranslationX, Command.TranslationY );
+                
+                if( Command.ScalingEnabled )
+                  OpenGL2D.SetScale( Command.ScaleX, Command.ScaleY );
+                  
+                if( Command.RotationEnabled )
+                  OpenGL2D.SetRotation( Command.AngleZ );
+                  
+                OpenGL2D.ComposeTransform( Command.ScalingEnabled, Command.RotationEnabled );
+                OpenGL2D.DrawTexturedQuad();
+                break;
+            }
+        }
+    }
+    
+    if( IsTimed )
+      OpenGL2D.EndTimedPhase();
+}
+
+// -----------------------------------------------------------------------------
+
+// same as the main loop does when rendering in
+// one thread, but using the submitted state
+void ThreadedRenderer::PresentFrame( RenderFrame& Frame )
+{
+    DrawEmulatorWindow( Frame.PowerIsOn, Frame.FrameNumber, Frame.IsRedraw );
+    
+    // restore the Vircon render parameters
+    OpenGL2D.SetBlendingMode( Frame.ActiveBlending );
+    OpenGL2D.MultiplyColor = Frame.MultiplyColor;
+    
+    if( Frame.IsRedraw )
+    {
+        SDL_GL_SwapWindow( OpenGL2D.Window );
+        return;
+    }
+    
+    OpenGL2D.BeginTimedPhase( GPUTimedPhases::BufferSwap );
+    SDL_GL_SwapWindow( OpenGL2D.Window );
+    OpenGL2D.EndTimedPhase();
+    
+    ReportGPUTiming( Frame.GPULoad );
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: HANDLING TEXTURES
+// =============================================================================
+
+
+unsigned ThreadedRenderer::CreateTexture( void* Pixels, unsigned Width, unsigned Height )
+{
+    // recorded commands go first, so that no
+    // pending texture deletion runs after this
+    if( RenderThread )
+      SubmitWork( false );
+      
+    TextureCreation Creation = { Pixels, Width, Height, 0 };
+    RunInRenderThread( CreateTextureInRenderThread, &Creation );
+    return Creation.TextureID;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::DestroyTexture( unsigned TextureID )
+{
+    AddCommand( RenderCommandTypes::DestroyTexture );
+    Frames[ RecordedFrame ].Commands.back().TextureID = TextureID;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::BindTexture( unsigned TextureID )
+{
+    NextQuad.TextureID = TextureID;
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: RENDER TARGET CONTROL
+// =============================================================================
+
+
+void ThreadedRenderer::RenderToFramebuffer()
+{
+    AddCommand( RenderCommandTypes::RenderToFramebuffer );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::FinishFrame()
+{
+    AddCommand( RenderCommandTypes::FinishFrame );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::BeginSpeculativeDrawing()
+{
+    AddCommand( RenderCommandTypes::BeginSpeculativeDrawing );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::EndSpeculativeDrawing()
+{
+    AddCommand( RenderCommandTypes::EndSpeculativeDrawing );
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: COLOR FUNCTIONS
+// =============================================================================
+
+
+void ThreadedRenderer::SetMultiplyColor( GPUColor NewMultiplyColor )
+{
+    AddCommand( RenderCommandTypes::SetMultiplyColor );
+    Frames[ RecordedFrame ].Commands.back().Color = NewMultiplyColor;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::SetBlendingMode( IOPortValues BlendingMode )
+{
+    AddCommand( RenderCommandTypes::SetBlendingMode );
+    Frames[ RecordedFrame ].Commands.back().BlendingMode = BlendingMode;
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: 2D TRANSFORM FUNCTIONS
+// =============================================================================
+
+
+void ThreadedRenderer::SetTranslation( int TranslationX, int TranslationY )
+{
+    NextQuad.TranslationX = TranslationX;
+    NextQuad.TranslationY = TranslationY;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::SetScale( float ScaleX, float ScaleY )
+{
+    NextQuad.ScaleX = ScaleX;
+    NextQuad.ScaleY = ScaleY;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::SetRotation( float AngleZ )
+{
+    NextQuad.AngleZ = AngleZ;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::ComposeTransform( bool ScalingEnabled, bool RotationEnabled )
+{
+    NextQuad.ScalingEnabled = ScalingEnabled;
+    NextQuad.RotationEnabled = RotationEnabled;
+}
+
+
+// =============================================================================
+//      THREADED RENDERER: BASE RENDER FUNCTIONS
+// =============================================================================
+
+
+void ThreadedRenderer::SetQuadVertexPosition( int Vertex, int x, int y )
+{
+    NextQuad.VertexPositions[ Vertex ][ 0 ] = x;
+    NextQuad.VertexPositions[ Vertex ][ 1 ] = y;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::SetQuadVertexTexCoords( int Vertex, float u, float v )
+{
+    NextQuad.VertexTexCoords[ Vertex ][ 0 ] = u;
+    NextQuad.VertexTexCoords[ Vertex ][ 1 ] = v;
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::DrawTexturedQuad()
+{
+    Frames[ RecordedFrame ].Commands.push_back( NextQuad );
+}
+
+// -----------------------------------------------------------------------------
+
+void ThreadedRenderer::ClearScreen( GPUColor ClearColor )
+{
+    AddCommand( RenderCommandTypes::ClearScreen );
+    Frames[ RecordedFrame ].Commands.back().Color = ClearColor;
+}
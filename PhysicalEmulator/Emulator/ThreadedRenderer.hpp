@@ -0,0 +1,190 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef THREADEDRENDERER_HPP
+    #define THREADEDRENDERER_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    #include "../../VirconDefinitions/VirconEnumerations.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/Render2DInterface.hpp"
+    
+    // include C/C++ headers
+    #include <vector>       // [ C++ STL ] Vectors
+    #include <exception>    // [ C++ STL ] Exceptions
+    #include <cstdint>      // [ ANSI C ] Standard integer types
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>   // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR THE RENDER THREAD
+// =============================================================================
+
+
+enum class RenderCommandTypes: uint8_t
+{
+    RenderToFramebuffer,
+    FinishFrame,
+    BeginSpeculativeDrawing,
+    EndSpeculativeDrawing,
+    DestroyTexture,
+    SetMultiplyColor,
+    SetBlendingMode,
+    ClearScreen,
+    DrawQuad
+};
+
+// -----------------------------------------------------------------------------
+
+// a draw command carries all the parameters of its quad,
+// so the GPU state changes between draws need no commands
+typedef struct
+{
+    RenderCommandTypes Type;
+    IOPortValues BlendingMode;
+    GPUColor Color;
+    unsigned TextureID;
+    int VertexPositions[ 4 ][ 2 ];
+    float VertexTexCoords[ 4 ][ 2 ];
+    int TranslationX, TranslationY;
+    float ScaleX, ScaleY;
+    float AngleZ;
+    bool ScalingEnabled;
+    bool RotationEnabled;
+}
+RenderCommand;
+
+// -----------------------------------------------------------------------------
+
+// everything the render thread needs to draw one emulator
+// update; console state used to present it on the window
+// is copied at submission, since emulation continues
+typedef struct
+{
+    std::vector< RenderCommand > Commands;
+    bool Present;
+    bool PowerIsOn;
+    uint64_t FrameNumber;
+    float GPULoad;
+    IOPortValues ActiveBlending;
+    GPUColor MultiplyColor;
+    bool IsRedraw;
+}
+RenderFrame;
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE RENDERER
+// =============================================================================
+
+
+// thread function that owns the GL context
+// and draws all frames submitted to it
+int OpenGLRenderThread( void* Parameters );
+
+
+// =============================================================================
+//      THREADED RENDERER CLASS
+// =============================================================================
+
+
+// Connects the GPU to the OpenGL renderer through a separate
+// thread, so that driver work does not stall the emulation.
+// The GPU calls are recorded in one frame buffer while the
+// render thread draws and presents the other one. Texture
+// creation needs a result, so it is run synchronously
+class ThreadedRenderer: public Render2DInterface
+{
+    public:
+    
+        // the frame being recorded by the emulation thread
+        // and the one being drawn by the render thread
+        RenderFrame Frames[ 2 ];
+        int RecordedFrame;
+        bool WorkPending;
+        
+        // quad parameters are gathered until it is drawn
+        RenderCommand NextQuad;
+        
+        // synchronous calls to the render thread
+        void (*PendingCall)( void* );
+        void* PendingCallData;
+        
+        // errors found in the render thread
+        std::exception_ptr RenderError;
+        
+        // variables for the render thread
+        friend int OpenGLRenderThread( void* );
+        SDL_Thread* RenderThread;
+        SDL_sem* WorkStartSemaphore;
+        SDL_sem* WorkEndSemaphore;
+        bool ThreadExitFlag;
+        
+        // configuration
+        bool Enabled;
+        
+    private:
+    
+        // work done in the render thread
+        void DrawFrame( RenderFrame& Frame );
+        void PresentFrame( RenderFrame& Frame );
+        
+        // work submission
+        void SubmitWork( bool Present );
+        void AddCommand( RenderCommandTypes Type );
+        
+    public:
+    
+        // instance handling
+        ThreadedRenderer();
+       ~ThreadedRenderer();
+       
+        // thread control
+        void Start();
+        void Stop();
+        bool IsRunning();
+        void WaitForRenderThread();
+        void RunInRenderThread( void (*Function)( void* ), void* Data );
+        
+        // submits the recorded commands; the window is
+        // presented with the given state of the console
+        void SubmitFrame( bool PowerIsOn, uint64_t FrameNumber, float GPULoad, IOPortValues ActiveBlending, GPUColor MultiplyColor, bool IsRedraw );
+        
+        // handling textures
+        virtual unsigned CreateTexture( void* Pixels, unsigned Width, unsigned Height );
+        virtual void DestroyTexture( unsigned TextureID );
+        virtual void BindTexture( unsigned TextureID );
+        
+        // render target control
+        virtual void RenderToFramebuffer();
+        virtual void FinishFrame();
+        virtual void BeginSpeculativeDrawing();
+        virtual void EndSpeculativeDrawing();
+        
+        // color functions
+        virtual void SetMultiplyColor( GPUColor NewMultiplyColor );
+        virtual void SetBlendingMode( IOPortValues BlendingMode );
+        
+        // 2D transform functions
+        virtual void SetTranslation( int TranslationX, int TranslationY );
+        virtual void SetScale( float ScaleX, float ScaleY );
+        virtual void SetRotation( float AngleZ );
+        virtual void ComposeTransform( bool ScalingEnabled, bool RotationEnabled );
+        
+        // render functions
+        virtual void SetQuadVertexPosition( int Vertex, int x, int y );
+        virtual void SetQuadVertexTexCoords( int Vertex, float u, float v );
+        virtual void DrawTexturedQuad();
+        virtual void ClearScreen( GPUColor ClearColor );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
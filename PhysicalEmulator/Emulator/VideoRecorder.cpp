@@ -0,0 +1,518 @@
+// *****************************************************************************
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    #include "../DesktopInfrastructure/WAVFunctions.hpp"
+    
+    // include project headers
+    #include "VideoRecorder.hpp"
+    
+    // include C/C++ headers
+    #include <cstring>          // [ ANSI C ] Strings
+    #include <algorithm>        // [ C++ STL ] Algorithms
+    
+    // choose the available SIMD instruction set
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+      #define VIDEO_RECORDER_SSE2
+      #include <emmintrin.h>    // [ x86 ] SSE2 intrinsics
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+      #define VIDEO_RECORDER_NEON
+      #include <arm_neon.h>     // [ ARM ] NEON intrinsics
+    #endif
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      CONVERSION FROM RGB TO YUV
+// =============================================================================
+
+
+// Colors are converted with BT.601 full range coefficients,
+// scaled by 256. Chroma is subsampled by taking the sum of
+// each 2x2 block, so its scale is 4 times larger. The SIMD
+// versions below give exactly the same results as these
+inline uint8_t LumaFromRGB( int R, int G, int B )
+{
+    return (77*R + 150*G + 29*B + 128) >> 8;
+}
+
+// -----------------------------------------------------------------------------
+
+inline uint8_t ChromaUFromRGBSums( int R4, int G4, int B4 )
+{
+    return min( (-43*R4 - 85*G4 + 128*B4 + (128 << 10) + 512) >> 10, 255 );
+}
+
+// -----------------------------------------------------------------------------
+
+inline uint8_t ChromaVFromRGBSums( int R4, int G4, int B4 )
+{
+    return min( (128*R4 - 107*G4 - 21*B4 + (128 << 10) + 512) >> 10, 255 );
+}
+
+// -----------------------------------------------------------------------------
+
+#if defined(VIDEO_RECORDER_SSE2)
+
+// weights for 2 16-bit multipliers in each 32-bit lane
+inline __m128i PairOfWeights_SSE2( int16_t Low, int16_t High )
+{
+    return _mm_set1_epi32( (int)(((uint32_t)(uint16_t)High << 16) | (uint16_t)Low) );
+}
+
+// -----------------------------------------------------------------------------
+
+// luma for 4 pixels, as 32-bit values
+inline __m128i Luma_SSE2( __m128i Pixels )
+{
+    // R and B are kept as 16-bit halves of each lane, so
+    // a single multiply-add can weight both at once
+    __m128i RB = _mm_and_si128( Pixels, _mm_set1_epi32( 0x00FF00FF ) );
+    __m128i G  = _mm_and_si128( _mm_srli_epi32( Pixels, 8 ), _mm_set1_epi32( 0xFF ) );
+    
+    __m128i Sum = _mm_madd_epi16( RB, PairOfWeights_SSE2( 77, 29 ) );
+    Sum = _mm_add_epi32( Sum, _mm_madd_epi16( G, PairOfWeights_SSE2( 150, 0 ) ) );
+    Sum = _mm_add_epi32( Sum, _mm_set1_epi32( 128 ) );
+    return _mm_srli_epi32( Sum, 8 );
+}
+
+// -----------------------------------------------------------------------------
+
+// chroma for 2x2 blocks of 4 columns in 2 rows; lanes
+// 0 and 2 get the results, as 32-bit values
+inline void Chroma_SSE2( __m128i Pixels1, __m128i Pixels2, __m128i& U, __m128i& V )
+{
+    __m128i MaskRB = _mm_set1_epi32( 0x00FF00FF );
+    __m128i MaskG  = _mm_set1_epi32( 0xFF );
+    
+    // add each pair of rows
+    __m128i RB = _mm_add_epi16( _mm_and_si128( Pixels1, MaskRB ), _mm_and_si128( Pixels2, MaskRB ) );
+    __m128i G  = _mm_add_epi16( _mm_and_si128( _mm_srli_epi32( Pixels1, 8 ), MaskG ), _mm_and_si128( _mm_srli_epi32( Pixels2, 8 ), MaskG ) );
+    
+    // add each pair of columns
+    RB = _mm_add_epi16( RB, _mm_srli_epi64( RB, 32 ) );
+    G  = _mm_add_epi16( G , _mm_srli_epi64( G , 32 ) );
+    
+    __m128i Offset = _mm_set1_epi32( (128 << 10) + 512 );
+    U = _mm_add_epi32( _mm_madd_epi16( RB, PairOfWeights_SSE2( -43, 128 ) ), _mm_madd_epi16( G, PairOfWeights_SSE2( -85, 0 ) ) );
+    V = _mm_add_epi32( _mm_madd_epi16( RB, PairOfWeights_SSE2( 128, -21 ) ), _mm_madd_epi16( G, PairOfWeights_SSE2( -107, 0 ) ) );
+    U = _mm_srai_epi32( _mm_add_epi32( U, Offset ), 10 );
+    V = _mm_srai_epi32( _mm_add_epi32( V, Offset ), 10 );
+}
+
+// -----------------------------------------------------------------------------
+
+// joins lanes 0 and 2 of 2 vectors
+inline __m128i JoinEvenLanes_SSE2( __m128i First, __m128i Second )
+{
+    First  = _mm_shuffle_epi32( First , _MM_SHUFFLE( 3,1,2,0 ) );
+    Second = _mm_shuffle_epi32( Second, _MM_SHUFFLE( 3,1,2,0 ) );
+    return _mm_unpacklo_epi64( First, Second );
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+void ConvertLumaRow( const GPUColor* Pixels, uint8_t* Luma )
+{
+    int x = 0;
+    
+    #if defined(VIDEO_RECORDER_SSE2)
+    
+      for( ; x + 16 <= Constants::ScreenWidth; x += 16 )
+      {
+          const __m128i* Source = (const __m128i*)&Pixels[ x ];
+          __m128i Luma1 = _mm_packs_epi32( Luma_SSE2( _mm_loadu_si128( Source+0 ) ), Luma_SSE2( _mm_loadu_si128( Source+1 ) ) );
+          __m128i Luma2 = _mm_packs_epi32( Luma_SSE2( _mm_loadu_si128( Source+2 ) ), Luma_SSE2( _mm_loadu_si128( Source+3 ) ) );
+          _mm_storeu_si128( (__m128i*)&Luma[ x ], _mm_packus_epi16( Luma1, Luma2 ) );
+      }
+      
+    #elif defined(VIDEO_RECORDER_NEON)
+    
+      for( ; x + 8 <= Constants::ScreenWidth; x += 8 )
+      {
+          uint8x8x4_t Source = vld4_u8( (const uint8_t*)&Pixels[ x ] );
+          uint16x8_t Sum = vmull_u8( Source.val[ 0 ], vdup_n_u8( 77 ) );
+          Sum = vmlal_u8( Sum, Source.val[ 1 ], vdup_n_u8( 150 ) );
+          Sum = vmlal_u8( Sum, Source.val[ 2 ], vdup_n_u8( 29 ) );
+          vst1_u8( &Luma[ x ], vrshrn_n_u16( Sum, 8 ) );
+      }
+      
+    #endif
+    
+    for( ; x < Constants::ScreenWidth; x++ )
+      Luma[ x ] = LumaFromRGB( Pixels[ x ].R, Pixels[ x ].G, Pixels[ x ].B );
+}
+
+// -----------------------------------------------------------------------------
+
+void ConvertChromaRows( const GPUColor* Pixels1, const GPUColor* Pixels2, uint8_t* ChromaU, uint8_t* ChromaV )
+{
+    int x = 0;
+    
+    #if defined(VIDEO_RECORDER_SSE2)
+    
+      for( ; x + 16 <= Constants::ScreenWidth; x += 16 )
+      {
+          const __m128i* Source1 = (const __m128i*)&Pixels1[ x ];
+          const __m128i* Source2 = (const __m128i*)&Pixels2[ x ];
+          __m128i U[ 4 ], V[ 4 ];
+          
+          for( int i = 0; i < 4; i++ )
+            Chroma_SSE2( _mm_loadu_si128( Source1+i ), _mm_loadu_si128( Source2+i ), U[ i ], V[ i ] );
+            
+          __m128i U16 = _mm_packs_epi32( JoinEvenLanes_SSE2( U[0], U[1] ), JoinEvenLanes_SSE2( U[2], U[3] ) );
+          __m128i V16 = _mm_packs_epi32( JoinEvenLanes_SSE2( V[0], V[1] ), JoinEvenLanes_SSE2( V[2], V[3] ) );
+          _mm_storel_epi64( (__m128i*)&ChromaU[ x/2 ], _mm_packus_epi16( U16, U16 ) );
+          _mm_storel_epi64( (__m128i*)&ChromaV[ x/2 ], _mm_packus_epi16( V16, V16 ) );
+      }
+      
+    #elif defined(VIDEO_RECORDER_NEON)
+    
+      for( ; x + 16 <= Constants::ScreenWidth; x += 16 )
+      {
+          uint8x16x4_t Source1 = vld4q_u8( (const uint8_t*)&Pixels1[ x ] );
+          uint8x16x4_t Source2 = vld4q_u8( (const uint8_t*)&Pixels2[ x ] );
+          
+          // add each pair of columns, then each pair of rows
+          int16x8_t R = vreinterpretq_s16_u16( vaddq_u16( vpaddlq_u8( Source1.val[ 0 ] ), vpaddlq_u8( Source2.val[ 0 ] ) ) );
+          int16x8_t G = vreinterpretq_s16_u16( vaddq_u16( vpaddlq_u8( Source1.val[ 1 ] ), vpaddlq_u8( Source2.val[ 1 ] ) ) );
+          int16x8_t B = vreinterpretq_s16_u16( vaddq_u16( vpaddlq_u8( Source1.val[ 2 ] ), vpaddlq_u8( Source2.val[ 2 ] ) ) );
+          int32x4_t Offset = vdupq_n_s32( (128 << 10) + 512 );
+          
+          int32x4_t ULow  = vmlal_n_s16( vmlal_n_s16( vmlal_n_s16( Offset, vget_low_s16 ( R ), -43 ), vget_low_s16 ( G ), -85 ), vget_low_s16 ( B ), 128 );
+          int32x4_t UHigh = vmlal_n_s16( vmlal_n_s16( vmlal_n_s16( Offset, vget_high_s16( R ), -43 ), vget_high_s16( G ), -85 ), vget_high_s16( B ), 128 );
+          int32x4_t VLow  = vmlal_n_s16( vmlal_n_s16( vmlal_n_s16( Offset, vget_low_s16 ( R ), 128 ), vget_low_s16 ( G ), -107 ), vget_low_s16 ( B ), -21 );
+          int32x4_t VHigh = vmlal_n_s16( vmlal_n_s16( vmlal_n_s16( Offset, vget_high_s16( R ), 128 ), vget_high_s16( G ), -107 ), vget_high_s16( B ), -21 );
+          
+          int16x8_t U16 = vcombine_s16( vmovn_s32( vshrq_n_s32( ULow, 10 ) ), vmovn_s32( vshrq_n_s32( UHigh, 10 ) ) );
+          int16x8_t V16 = vcombine_s16( vmovn_s32( vshrq_n_s32( VLow, 10 ) ), vmovn_s32( vshrq_n_s32( VHigh, 10 ) ) );
+          vst1_u8( &ChromaU[ x/2 ], vqmovun_s16( U16 ) );
+          vst1_u8( &ChromaV[ x/2 ], vqmovun_s16( V16 ) );
+      }
+      
+    #endif
+    
+    for( ; x < Constants::ScreenWidth; x += 2 )
+    {
+        int R4 = Pixels1[ x ].R + Pixels1[ x+1 ].R + Pixels2[ x ].R + Pixels2[ x+1 ].R;
+        int G4 = Pixels1[ x ].G + Pixels1[ x+1 ].G + Pixels2[ x ].G + Pixels2[ x+1 ].G;
+        int B4 = Pixels1[ x ].B + Pixels1[ x+1 ].B + Pixels2[ x ].B + Pixels2[ x+1 ].B;
+        ChromaU[ x/2 ] = ChromaUFromRGBSums( R4, G4, B4 );
+        ChromaV[ x/2 ] = ChromaVFromRGBSums( R4, G4, B4 );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// output has the 3 planes one after the other
+void ConvertFrameToYUV420( const GPUColor* Pixels, uint8_t* YUV )
+{
+    const int ChromaWidth = Constants::ScreenWidth / 2;
+    const int ChromaPlaneSize = ChromaWidth * (Constants::ScreenHeight / 2);
+    uint8_t* PlaneY = YUV;
+    uint8_t* PlaneU = PlaneY + Constants::ScreenPixels;
+    uint8_t* PlaneV = PlaneU + ChromaPlaneSize;
+    
+    for( int y = 0; y < Constants::ScreenHeight; y += 2 )
+    {
+        const GPUColor* Row1 = &Pixels[ y * Constants::ScreenWidth ];
+        const GPUColor* Row2 = Row1 + Constants::ScreenWidth;
+        
+        ConvertLumaRow( Row1, &PlaneY[ y * Constants::ScreenWidth ] );
+        ConvertLumaRow( Row2, &PlaneY[ (y+1) * Constants::ScreenWidth ] );
+        ConvertChromaRows( Row1, Row2, &PlaneU[ (y/2) * ChromaWidth ], &PlaneV[ (y/2) * ChromaWidth ] );
+    }
+}
+
+
+// =============================================================================
+//      VIDEO ENCODER THREAD
+// =============================================================================
+
+
+// The thread wakes up whenever new data is queued. On
+// exit it first saves anything left in the queues, so
+// no data already accepted by the recorder is lost
+int VideoEncoderThread( void* Parameters )
+{
+    VideoRecorder* Recorder = (VideoRecorder*)Parameters;
+    
+    while( true )
+    {
+        SDL_SemWait( Recorder->EncoderSemaphore );
+        Recorder->EncodeQueuedData();
+        
+        if( Recorder->ThreadExitFlag )
+          break;
+    }
+    
+    return 0;
+}
+
+
+// =============================================================================
+//      VIDEO RECORDER: INSTANCE HANDLING
+// =============================================================================
+
+
+VideoRecorder::VideoRecorder()
+{
+    Recording = false;
+    
+    SDL_AtomicSet( &QueuedVideoFrames, 0 );
+    SDL_AtomicSet( &EncodedVideoFrames, 0 );
+    SDL_AtomicSet( &QueuedAudioBlocks, 0 );
+    SDL_AtomicSet( &EncodedAudioBlocks, 0 );
+    DroppedVideoFrames = 0;
+    DroppedAudioBlocks = 0;
+    
+    LastFrameNumber = 0;
+    WrittenVideoFrames = 0;
+    RepeatedVideoFrames = 0;
+    WrittenAudioBytes = 0;
+    
+    EncoderThread = nullptr;
+    EncoderSemaphore = nullptr;
+    ThreadExitFlag = false;
+}
+
+// -----------------------------------------------------------------------------
+
+VideoRecorder::~VideoRecorder()
+{
+    // the thread must have been stopped before SDL
+    // is closed, so here we can only check for that
+    if( Recording )
+      LOG( "WARNING: Video recorder was destroyed while still recording" );
+}
+
+
+// =============================================================================
+//      VIDEO RECORDER: WORK DONE IN THE ENCODER THREAD
+// =============================================================================
+
+
+void VideoRecorder::EncodeQueuedData()
+{
+    // save all queued frames
+    unsigned Encoded = SDL_AtomicGet( &EncodedVideoFrames );
+    unsigned Queued = SDL_AtomicGet( &QueuedVideoFrames );
+    
+    for( ; Encoded != Queued; Encoded++ )
+    {
+        WriteVideoFrame( VideoQueue[ Encoded % VIDEO_QUEUE_FRAMES ] );
+        SDL_AtomicSet( &EncodedVideoFrames, (int)(Encoded + 1) );
+    }
+    
+    // save all queued sound
+    Encoded = SDL_AtomicGet( &EncodedAudioBlocks );
+    Queued = SDL_AtomicGet( &QueuedAudioBlocks );
+    
+    for( ; Encoded != Queued; Encoded++ )
+    {
+        WriteAudioBlock( AudioQueue[ Encoded % AUDIO_QUEUE_BLOCKS ] );
+        SDL_AtomicSet( &EncodedAudioBlocks, (int)(Encoded + 1) );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void VideoRecorder::WriteVideoFrame( const QueuedVideoFrame& Frame )
+{
+    // while paused the emulator shows the same frame,
+    // but it produces no sound so neither should we
+    if( WrittenVideoFrames > 0 && Frame.FrameNumber == LastFrameNumber )
+      return;
+      
+    // frames that were dropped (here or in the framebuffer
+    // readback) are replaced with copies of the last one,
+    // so that video keeps in sync with the sound
+    if( WrittenVideoFrames > 0 && Frame.FrameNumber > LastFrameNumber )
+      for( uint64_t Missing = LastFrameNumber + 1; Missing < Frame.FrameNumber; Missing++ )
+      {
+          VideoFile << "FRAME\n";
+          VideoFile.write( (char*)(&YUVFrame[ 0 ]), YUVFrame.size() );
+          RepeatedVideoFrames++;
+      }
+      
+    ConvertFrameToYUV420( &Frame.Pixels[ 0 ], &YUVFrame[ 0 ] );
+    VideoFile << "FRAME\n";
+    VideoFile.write( (char*)(&YUVFrame[ 0 ]), YUVFrame.size() );
+    
+    LastFrameNumber = Frame.FrameNumber;
+    WrittenVideoFrames++;
+}
+
+// -----------------------------------------------------------------------------
+
+void VideoRecorder::WriteAudioBlock( const QueuedAudioBlock& Block )
+{
+    unsigned Bytes = Block.NumberOfSamples * sizeof( SPUSample );
+    AudioFile.write( (char*)(&Block.Samples[ 0 ]), Bytes );
+    WrittenAudioBytes += Bytes;
+}
+
+// -----------------------------------------------------------------------------
+
+// sizes are only known at the end, so this is
+// written once at start and again when stopping
+void VideoRecorder::WriteWAVHeader()
+{
+    ::WriteWAVHeader( AudioFile, WrittenAudioBytes );
+}
+
+
+// =============================================================================
+//      VIDEO RECORDER: RECORDING CONTROL
+// =============================================================================
+
+
+// extensions are added to the given path
+// to form the names for both output files
+void VideoRecorder::StartRecording( const string& BaseFilePath )
+{
+    StopRecording();
+    
+    // open the files
+    VideoFilePath = BaseFilePath + ".y4m";
+    AudioFilePath = BaseFilePath + ".wav";
+    LOG( "Recording video to files \"" << VideoFilePath << "\" and \"" << AudioFilePath << "\"" );
+    
+    VideoFile.open( VideoFilePath, ios::binary );
+    AudioFile.open( AudioFilePath, ios::binary );
+    
+    if( VideoFile.fail() || AudioFile.fail() )
+    {
+        VideoFile.close();
+        AudioFile.close();
+        THROW( "Cannot open video recording files" );
+    }
+    
+    // save the file headers
+    VideoFile << "YUV4MPEG2 W" << Constants::ScreenWidth << " H" << Constants::ScreenHeight;
+    VideoFile << " F" << Constants::FramesPerSecond << ":1 Ip A1:1 C420jpeg\n";
+    
+    WrittenAudioBytes = 0;
+    WriteWAVHeader();
+    
+    // prepare all buffers in advance
+    for( QueuedVideoFrame& Frame: VideoQueue )
+      Frame.Pixels.resize( Constants::ScreenPixels );
+      
+    YUVFrame.resize( Constants::ScreenPixels * 3 / 2 );
+    
+    // reset the queues
+    SDL_AtomicSet( &QueuedVideoFrames, 0 );
+    SDL_AtomicSet( &EncodedVideoFrames, 0 );
+    SDL_AtomicSet( &QueuedAudioBlocks, 0 );
+    SDL_AtomicSet( &EncodedAudioBlocks, 0 );
+    DroppedVideoFrames = 0;
+    DroppedAudioBlocks = 0;
+    LastFrameNumber = 0;
+    WrittenVideoFrames = 0;
+    RepeatedVideoFrames = 0;
+    
+    // start the encoder thread
+    EncoderSemaphore = SDL_CreateSemaphore( 0 );
+    
+    if( !EncoderSemaphore )
+      THROW( "Cannot create semaphore for video encoder thread" );
+      
+    ThreadExitFlag = false;
+    EncoderThread = SDL_CreateThread( VideoEncoderThread, "VideoEncoder", this );
+    
+    if( !EncoderThread )
+      THROW( string("Cannot create video encoder thread: ") + SDL_GetError() );
+      
+    Recording = true;
+}
+
+// -----------------------------------------------------------------------------
+
+// all producers must have been disconnected first
+void VideoRecorder::StopRecording()
+{
+    if( !Recording )
+      return;
+      
+    // let the thread save the remaining data and exit
+    ThreadExitFlag = true;
+    SDL_SemPost( EncoderSemaphore );
+    SDL_WaitThread( EncoderThread, nullptr );
+    SDL_DestroySemaphore( EncoderSemaphore );
+    EncoderThread = nullptr;
+    EncoderSemaphore = nullptr;
+    ThreadExitFlag = false;
+    
+    // now the sound size is known
+    WriteWAVHeader();
+    VideoFile.close();
+    AudioFile.close();
+    Recording = false;
+    
+    LOG( "Recorded " << WrittenVideoFrames + RepeatedVideoFrames << " video frames and "
+         << WrittenAudioBytes / sizeof( SPUSample ) << " sound samples" );
+         
+    if( RepeatedVideoFrames > 0 || DroppedAudioBlocks > 0 )
+      LOG( "WARNING: Video recording could not keep up: " << RepeatedVideoFrames
+           << " frames were repeated and " << DroppedAudioBlocks << " sound blocks were dropped" );
+}
+
+
+// =============================================================================
+//      VIDEO RECORDER: RECEIVING DATA
+// =============================================================================
+
+
+// called from the framebuffer readback thread
+void VideoRecorder::ProcessFrame( const GPUColor* Pixels, uint64_t FrameNumber )
+{
+    unsigned Queued = SDL_AtomicGet( &QueuedVideoFrames );
+    unsigned Encoded = SDL_AtomicGet( &EncodedVideoFrames );
+    
+    // when the queue is full, the encoder will
+    // later cover the gap by repeating a frame
+    if( Queued - Encoded >= VIDEO_QUEUE_FRAMES )
+    {
+        DroppedVideoFrames++;
+        return;
+    }
+    
+    QueuedVideoFrame& Frame = VideoQueue[ Queued % VIDEO_QUEUE_FRAMES ];
+    Frame.FrameNumber = FrameNumber;
+    memcpy( &Frame.Pixels[ 0 ], Pixels, Constants::ScreenPixels * sizeof( GPUColor ) );
+    
+    SDL_AtomicSet( &QueuedVideoFrames, (int)(Queued + 1) );
+    SDL_SemPost( EncoderSemaphore );
+}
+
+// -----------------------------------------------------------------------------
+
+// called from the main thread
+void VideoRecorder::ProcessSound( const SPUSample* Samples, unsigned NumberOfSamples )
+{
+    unsigned Queued = SDL_AtomicGet( &QueuedAudioBlocks );
+    unsigned Encoded = SDL_AtomicGet( &EncodedAudioBlocks );
+    
+    if( Queued - Encoded >= AUDIO_QUEUE_BLOCKS )
+    {
+        DroppedAudioBlocks++;
+        return;
+    }
+    
+    // vectors keep their capacity, so after the first
+    // few blocks this will not allocate any memory
+    QueuedAudioBlock& Block = AudioQueue[ Queued % AUDIO_QUEUE_BLOCKS ];
+    Block.NumberOfSamples = NumberOfSamples;
+    Block.Samples.assign( Samples, Samples + NumberOfSamples );
+    
+    SDL_AtomicSet( &QueuedAudioBlocks, (int)(Queued + 1) );
+    SDL_SemPost( EncoderSemaphore );
+}
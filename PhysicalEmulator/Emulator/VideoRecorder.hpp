@@ -0,0 +1,136 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef VIDEORECORDER_HPP
+    #define VIDEORECORDER_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/FrameConsumerInterface.hpp"
+    #include "../DesktopInfrastructure/SoundConsumerInterface.hpp"
+    
+    // include C/C++ headers
+    #include <string>       // [ C++ STL ] Strings
+    #include <vector>       // [ C++ STL ] Vectors
+    #include <fstream>      // [ C++ STL ] File streams
+    
+    // include SDL2 headers
+    #define SDL_MAIN_HANDLED
+    #include <SDL2/SDL.h>   // [ SDL2 ] Main header
+// *****************************************************************************
+
+
+// =============================================================================
+//      DEFINITIONS FOR VIDEO RECORDING
+// =============================================================================
+
+
+// Frames and sound are passed to the encoder thread through
+// queues of these sizes. When a queue is full the new data
+// is dropped, so that the emulator never waits for the disk
+#define VIDEO_QUEUE_FRAMES     8   // ~0.13 seconds of video
+#define AUDIO_QUEUE_BLOCKS   160   // ~0.5 seconds of sound, in blocks of 1/5 frame
+
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t FrameNumber;
+    std::vector< GPUColor > Pixels;
+}
+QueuedVideoFrame;
+
+// -----------------------------------------------------------------------------
+
+typedef struct
+{
+    unsigned NumberOfSamples;
+    std::vector< SPUSample > Samples;
+}
+QueuedAudioBlock;
+
+
+// =============================================================================
+//      FUNCTIONS EXTERNAL TO THE RECORDER
+// =============================================================================
+
+
+// thread function that converts and saves all queued data
+int VideoEncoderThread( void* Parameters );
+
+
+// =============================================================================
+//      VIDEO RECORDER CLASS
+// =============================================================================
+
+
+// Records the emulator output as an uncompressed Y4M video
+// (YUV 4:2:0 at 60 fps) plus a WAV file with its sound. Both
+// files can later be joined and compressed with any external
+// tool. All conversion and file writing is done by a separate
+// thread, so producers only need to copy their data
+class VideoRecorder: public FrameConsumerInterface, public SoundConsumerInterface
+{
+    public:
+    
+        // output files
+        std::string VideoFilePath;
+        std::string AudioFilePath;
+        std::ofstream VideoFile;
+        std::ofstream AudioFile;
+        bool Recording;
+        
+        // each queue has a single producer and a single
+        // consumer, so only their counts need to be atomic;
+        // slots are taken modulo the queue size
+        QueuedVideoFrame VideoQueue[ VIDEO_QUEUE_FRAMES ];
+        QueuedAudioBlock AudioQueue[ AUDIO_QUEUE_BLOCKS ];
+        SDL_atomic_t QueuedVideoFrames;
+        SDL_atomic_t EncodedVideoFrames;
+        SDL_atomic_t QueuedAudioBlocks;
+        SDL_atomic_t EncodedAudioBlocks;
+        unsigned DroppedVideoFrames;
+        unsigned DroppedAudioBlocks;
+        
+        // encoder state
+        std::vector< uint8_t > YUVFrame;
+        uint64_t LastFrameNumber;
+        unsigned WrittenVideoFrames;
+        unsigned RepeatedVideoFrames;
+        uint32_t WrittenAudioBytes;
+        
+        // variables for the encoder thread
+        friend int VideoEncoderThread( void* );
+        SDL_Thread* EncoderThread;
+        SDL_sem* EncoderSemaphore;
+        bool ThreadExitFlag;
+        
+    private:
+    
+        // work done in the encoder thread
+        void EncodeQueuedData();
+        void WriteVideoFrame( const QueuedVideoFrame& Frame );
+        void WriteAudioBlock( const QueuedAudioBlock& Block );
+        void WriteWAVHeader();
+        
+    public:
+    
+        // instance handling
+        VideoRecorder();
+       ~VideoRecorder();
+       
+        // recording control
+        void StartRecording( const std::string& BaseFilePath );
+        void StopRecording();
+        
+        // receiving data
+        virtual void ProcessFrame( const GPUColor* Pixels, uint64_t FrameNumber );
+        virtual void ProcessSound( const SPUSample* Samples, unsigned NumberOfSamples );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
@@ -7,6 +7,8 @@
     #include "../DesktopInfrastructure/FilePaths.hpp"
     #include "../DesktopInfrastructure/LogStream.hpp"
     #include "../DesktopInfrastructure/OpenGL2DContext.hpp"
+    #include "../DesktopInfrastructure/MappedFile.hpp"
+    #include "../DesktopInfrastructure/HashFunctions.hpp"
     
     // include project headers
     #include "VirconEmulator.hpp"
@@ -14,6 +16,11 @@
     #include "GUI.hpp"
     #include "Settings.hpp"
     
+    // include C/C++ headers
+    #include <cstring>          // [ ANSI C ] Strings
+    #include <exception>        // [ C++ STL ] Exceptions
+    #include <unordered_map>    // [ C++ STL ] Unordered maps
+    
     // declare used namespaces
     using namespace std;
 // *****************************************************************************
@@ -53,14 +60,31 @@ VirconEmulator::VirconEmulator()
     // connect main RAM
     RAM.Connect( Constants::RAMSize );
     
+    // GPU draws with OpenGL unless configured otherwise
+    GPU.Renderer = &OpenGL2D;
+    
+    // SPU plays through OpenAL unless configured otherwise
+    SPU.Sink = &OpenALSink;
+    
     // set initial state
     PowerIsOn = false;
     Paused = false;
     
+    // by default, load whole cartridges
+    StreamCartridgeSounds = false;
+    
     // initial loads are 0
     LastCPULoads[0] = LastCPULoads[1] = 0;
     LastGPULoads[0] = LastGPULoads[1] = 0;
     
+    // by default, do not run ahead
+    RunAheadFrames = 0;
+    RunningAhead = false;
+    
+    RealFramesTime = AheadFramesTime = RollBackTime = 0;
+    JournaledWrites = 0;
+    MeasuredUpdates = 0;
+    
     // do NOT reset until power on
 }
 
@@ -238,7 +262,7 @@ void VirconEmulator::LoadBios( const std::string& FilePath )
     vector< SPUSample > LoadedSound;
     LoadedSound.resize( SoundHeader.SoundSamples );
     InputFile.read( (char*)(&LoadedSound[0]), SoundHeader.SoundSamples*4 );
-    SPU.LoadSound( SPU.BiosSound, &LoadedSound[0], SoundHeader.SoundSamples );
+    SPU.LoadBiosSound( &LoadedSound[0], SoundHeader.SoundSamples );
     
     // discard the temporary buffer
     LoadedSound.clear();
@@ -248,11 +272,258 @@ void VirconEmulator::LoadBios( const std::string& FilePath )
 }
 
 
+// =============================================================================
+//      CARTRIDGE LOADING THREADS
+// =============================================================================
+
+
+// reading speed is limited by the storage device,
+// so a few threads are enough to keep it busy
+#define MAX_CARTRIDGE_LOADER_THREADS  4
+
+// -----------------------------------------------------------------------------
+
+// a texture or sound stored in the mapped file
+typedef struct
+{
+    const uint8_t* Data;
+    size_t Bytes;
+    uint64_t Shape;             // contents can only match for the same shape
+    uint64_t Hash;
+    int Original;               // first identical asset, or -1 if none
+}
+CartridgeAsset;
+
+// -----------------------------------------------------------------------------
+
+// either hashing an asset, or a copy
+// from the mapped file into the emulator
+typedef struct
+{
+    CartridgeAsset* HashedAsset;    // null for copies
+    const void* Source;
+    uint32_t Words;
+    SPUSound* TargetSound;          // null for the program ROM
+    uint64_t ArenaPosition;         // where sounds are placed in the sample arena
+}
+CartridgeLoadJob;
+
+// -----------------------------------------------------------------------------
+
+// work shared by all loading threads
+typedef struct
+{
+    VirconEmulator* Emulator;
+    vector< CartridgeLoadJob > Jobs;
+    SDL_atomic_t NextJob;
+    SDL_SpinLock ErrorLock;
+    exception_ptr JobError;
+}
+CartridgeLoader;
+
+// -----------------------------------------------------------------------------
+
+// gives the next section of a mapped file; unlike with
+// ifstream, reading past the end would not just fail
+const uint8_t* ReadMappedSection( const MappedFile& File, size_t& Position, size_t Bytes )
+{
+    if( Bytes > File.Size - Position )
+      THROW( "Incorrect V32 file format (file contents go beyond its end)" );
+      
+    const uint8_t* Section = File.Data + Position;
+    Position += Bytes;
+    return Section;
+}
+
+// -----------------------------------------------------------------------------
+
+// Workers take jobs in file order from a shared counter,
+// so that reads stay mostly sequential. Each job writes
+// to a different destination so they need no locking
+void RunCartridgeLoadJobs( CartridgeLoader& Loader )
+{
+    while( true )
+    {
+        int JobIndex = SDL_AtomicAdd( &Loader.NextJob, 1 );
+        
+        if( JobIndex >= (int)Loader.Jobs.size() )
+          return;
+          
+        CartridgeLoadJob& Job = Loader.Jobs[ JobIndex ];
+        
+        try
+        {
+            if( Job.HashedAsset )
+              Job.HashedAsset->Hash = HashXXH64( Job.HashedAsset->Data, Job.HashedAsset->Bytes );
+            else if( Job.TargetSound )
+              Loader.Emulator->SPU.LoadSound( *Job.TargetSound, Job.ArenaPosition, (const SPUSample*)Job.Source, Job.Words );
+            else
+              Loader.Emulator->CartridgeController.Connect( (void*)Job.Source, Job.Words );
+        }
+        
+        // only the first error is kept
+        catch( ... )
+        {
+            SDL_AtomicLock( &Loader.ErrorLock );
+            
+            if( !Loader.JobError )
+              Loader.JobError = current_exception();
+              
+            SDL_AtomicUnlock( &Loader.ErrorLock );
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+int CartridgeLoaderThread( void* Parameters )
+{
+    RunCartridgeLoadJobs( *(CartridgeLoader*)Parameters );
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// starts the threads for the current list of jobs; the
+// calling thread can then do other work before it helps
+vector< SDL_Thread* > StartCartridgeLoaderThreads( CartridgeLoader& Loader )
+{
+    SDL_AtomicSet( &Loader.NextJob, 0 );
+    
+    // this thread also takes jobs, so leave one CPU
+    // (and one job) for it
+    int NumberOfThreads = min( SDL_GetCPUCount() - 1, MAX_CARTRIDGE_LOADER_THREADS );
+    NumberOfThreads = min( NumberOfThreads, (int)Loader.Jobs.size() - 1 );
+    vector< SDL_Thread* > LoaderThreads;
+    
+    for( int i = 0; i < NumberOfThreads; i++ )
+    {
+        SDL_Thread* NewThread = SDL_CreateThread( CartridgeLoaderThread, "CartridgeLoader", &Loader );
+        
+        // remaining work will be done by this thread
+        if( !NewThread )
+        {
+            LOG( "WARNING: Cannot create cartridge loader thread: " << SDL_GetError() );
+            break;
+        }
+        
+        LoaderThreads.push_back( NewThread );
+    }
+    
+    return LoaderThreads;
+}
+
+// -----------------------------------------------------------------------------
+
+// helps with any remaining jobs and waits for all threads
+void FinishCartridgeLoadJobs( CartridgeLoader& Loader, vector< SDL_Thread* >& LoaderThreads )
+{
+    RunCartridgeLoadJobs( Loader );
+    
+    for( SDL_Thread* Thread: LoaderThreads )
+      SDL_WaitThread( Thread, nullptr );
+      
+    LoaderThreads.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+// Some cartridges contain the same texture or sound more
+// than once. Only assets with the same shape can match,
+// so most of them don't need to be hashed at all; the
+// rest are hashed by the loading threads, in parallel
+void AddAssetHashJobs( vector< CartridgeAsset >& Assets, CartridgeLoader& Loader )
+{
+    unordered_map< uint64_t, unsigned > ShapeCounts;
+    
+    for( CartridgeAsset& Asset: Assets )
+    {
+        Asset.Original = -1;
+        Asset.Hash = 0;
+        ShapeCounts[ Asset.Shape ]++;
+    }
+    
+    for( CartridgeAsset& Asset: Assets )
+    {
+        if( ShapeCounts[ Asset.Shape ] < 2 )
+          continue;
+          
+        CartridgeLoadJob HashJob;
+        HashJob.HashedAsset = &Asset;
+        HashJob.Source = nullptr;
+        HashJob.Words = 0;
+        HashJob.TargetSound = nullptr;
+        HashJob.ArenaPosition = 0;
+        Loader.Jobs.push_back( HashJob );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// once assets are hashed, hash matches
+// are confirmed by comparing the contents
+void FindDuplicateAssets( vector< CartridgeAsset >& Assets )
+{
+    unordered_map< uint64_t, vector< unsigned > > ShapeGroups;
+    
+    for( unsigned i = 0; i < Assets.size(); i++ )
+      ShapeGroups[ Assets[ i ].Shape ].push_back( i );
+      
+    for( auto& Group: ShapeGroups )
+    {
+        vector< unsigned >& Members = Group.second;
+        
+        // members are in file order, so the first
+        // of each set of identical assets is kept
+        for( unsigned m = 1; m < Members.size(); m++ )
+        {
+            CartridgeAsset& Asset = Assets[ Members[ m ] ];
+            
+            for( unsigned n = 0; n < m; n++ )
+            {
+                CartridgeAsset& Previous = Assets[ Members[ n ] ];
+                
+                if( Previous.Original < 0 && Previous.Hash == Asset.Hash
+                &&  !memcmp( Previous.Data, Asset.Data, Asset.Bytes ) )
+                {
+                    Asset.Original = Members[ n ];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void LogDuplicateAssets( const vector< CartridgeAsset >& Assets, const string& AssetName )
+{
+    unsigned Duplicates = 0;
+    size_t SavedBytes = 0;
+    
+    for( const CartridgeAsset& Asset: Assets )
+      if( Asset.Original >= 0 )
+      {
+          Duplicates++;
+          SavedBytes += Asset.Bytes;
+      }
+      
+    if( Duplicates > 0 )
+      LOG( "Found " << Duplicates << " duplicate " << AssetName << " (" << (SavedBytes >> 10) << " KB saved)" );
+}
+
+
 // =============================================================================
 //      VIRCON EMULATOR: CARTRIDGE MANAGEMENT
 // =============================================================================
 
 
+// Loading is done in 2 passes. First all headers are read
+// and checked, in the same order as they appear in the file.
+// Then contents are copied from the mapped file by worker
+// threads: first they hash assets to find duplicates; then
+// they copy program ROM and sounds while this thread creates
+// the textures (GL can only be used from this thread)
 void VirconEmulator::LoadCartridge( const std::string& FilePath )
 {
     LOG_SCOPE( "Loading cartridge" );
@@ -261,11 +532,8 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
     // unload any previous cartridge
     UnloadCartridge();
     
-    // open cartridge file
-    ifstream InputFile;
-    InputFile.open( FilePath, ios_base::binary | ios_base::ate );
-    
-    if( InputFile.fail() )
+    // map cartridge file
+    if( !CartridgeFile.Open( FilePath ) )
       THROW( "Cannot open cartridge file" );
     
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -274,7 +542,7 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
     
     // get size and ensure it is a multiple of 4
     // (otherwise file contents are wrong)
-    unsigned FileBytes = InputFile.tellg();
+    size_t FileBytes = CartridgeFile.Size;
     
     if( (FileBytes % 4) != 0 )
       throw runtime_error( "Incorrect V32 file format (file size must be a multiple of 4)" );
@@ -284,9 +552,9 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
       throw runtime_error( "Incorrect V32 file format (file is too small)" );
     
     // now we can safely read the global header
-    InputFile.seekg( 0, ios_base::beg );
+    size_t FilePosition = 0;
     ROMFileHeader ROMHeader;
-    InputFile.read( (char*)(&ROMHeader), sizeof(ROMFileHeader) );
+    memcpy( &ROMHeader, ReadMappedSection( CartridgeFile, FilePosition, sizeof(ROMFileHeader) ), sizeof(ROMFileHeader) );
     
     // check if the ROM is actually a BIOS
     if( CheckSignature( ROMHeader.Signature, Signatures::BiosFile ) )
@@ -343,15 +611,24 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
     if( FileBytes != SizeAfterAudioROM )
       THROW( "Incorrect V32 file format (file size does not match indicated ROM contents)" );
     
+    // the rest of the file will be needed soon,
+    // so have the OS start reading it already
+    CartridgeFile.PrefetchRange( FilePosition, FileBytes - FilePosition );
+    
+    // jobs for the loading threads
+    CartridgeLoader Loader;
+    Loader.Emulator = this;
+    Loader.ErrorLock = 0;
+    
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    // STEP 3: Load program rom
+    // STEP 3: Check program rom
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     {
         LOG_SCOPE( "Loading cartridge program ROM" );
         
         // load a binary file signature
         BinaryFileHeader BinaryHeader;
-        InputFile.read( (char*)(&BinaryHeader), sizeof(BinaryFileHeader) );
+        memcpy( &BinaryHeader, ReadMappedSection( CartridgeFile, FilePosition, sizeof(BinaryFileHeader) ), sizeof(BinaryFileHeader) );
         
         // check signature for embedded binary
         if( !CheckSignature( BinaryHeader.Signature, Signatures::BinaryFile ) )
@@ -363,28 +640,31 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
         if( !IsBetween( BinaryHeader.NumberOfWords, 1, Constants::MaximumCartridgeProgramROM ) )
           THROW( "Cartridge program ROM does not have a correct size (from 1 word up to 128M words)" );
         
-        // load the binary contents
-        vector< VirconWord > LoadedBinary;
-        LoadedBinary.resize( BinaryHeader.NumberOfWords );
-        InputFile.read( (char*)(&LoadedBinary[0]), BinaryHeader.NumberOfWords*4 );
-        CartridgeController.Connect( &LoadedBinary[0], BinaryHeader.NumberOfWords );
-        
-        // discard the temporary buffer
-        LoadedBinary.clear();
+        // the binary contents are copied later
+        CartridgeLoadJob ProgramJob;
+        ProgramJob.HashedAsset = nullptr;
+        ProgramJob.Source = ReadMappedSection( CartridgeFile, FilePosition, BinaryHeader.NumberOfWords*4 );
+        ProgramJob.Words = BinaryHeader.NumberOfWords;
+        ProgramJob.TargetSound = nullptr;
+        ProgramJob.ArenaPosition = 0;
+        Loader.Jobs.push_back( ProgramJob );
     }
     
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    // STEP 4: Load video rom
+    // STEP 4: Check video rom
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    vector< TextureFileHeader > TextureHeaders;
+    vector< CartridgeAsset > TextureAssets;
+    
     {
         LOG_SCOPE( "Loading cartridge video ROM" );
         
-        // load all textures in sequence
+        // check all textures in sequence
         for( unsigned i = 0; i < ROMHeader.NumberOfTextures; i++ )
         {
             // load a texture file signature
             TextureFileHeader TextureHeader;
-            InputFile.read( (char*)(&TextureHeader), sizeof(TextureFileHeader) );
+            memcpy( &TextureHeader, ReadMappedSection( CartridgeFile, FilePosition, sizeof(TextureFileHeader) ), sizeof(TextureFileHeader) );
             
             // check signature for embedded texture
             if( !CheckSignature( TextureHeader.Signature, Signatures::TextureFile ) )
@@ -399,37 +679,35 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
             ||  !IsBetween( TextureHeader.TextureHeight, 0, 1024 ) )
               THROW( "Cartridge texture does not have correct dimensions (1x1 up to 1024x1024 pixels)" );
             
-            // load the texture pixels
-            uint32_t TexturePixels = TextureHeader.TextureWidth * TextureHeader.TextureHeight;
-            vector< VirconWord > LoadedTexture;
-            LoadedTexture.resize( TexturePixels );
-            InputFile.read( (char*)(&LoadedTexture[0]), TexturePixels*4 );
+            // the texture pixels are used later
+            uint32_t TexturePixelCount = TextureHeader.TextureWidth * TextureHeader.TextureHeight;
+            TextureHeaders.push_back( TextureHeader );
             
-            // create a new GPU texture and load data into it
-            GPU.CartridgeTextures.emplace_back();
-            GPU.LoadTexture( GPU.CartridgeTextures.back(), &LoadedTexture[0],
-                             TextureHeader.TextureWidth, TextureHeader.TextureHeight );
-            
-            // discard the temporary buffer
-            LoadedTexture.clear();
+            CartridgeAsset TextureAsset;
+            TextureAsset.Data = ReadMappedSection( CartridgeFile, FilePosition, TexturePixelCount*4 );
+            TextureAsset.Bytes = TexturePixelCount*4;
+            TextureAsset.Shape = ((uint64_t)TextureHeader.TextureWidth << 32) | TextureHeader.TextureHeight;
+            TextureAssets.push_back( TextureAsset );
         }
     }
     
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    // STEP 5: Load audio rom
+    // STEP 5: Check audio rom
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    vector< CartridgeAsset > SoundAssets;
+    
     {
         LOG_SCOPE( "Loading cartridge audio ROM" );
         
         // keep count of the total sound samples
         uint32_t TotalSPUSamples = 0;
         
-        // load all sounds in sequence
+        // check all sounds in sequence
         for( unsigned i = 0; i < ROMHeader.NumberOfSounds; i++ )
         {
             // load a sound file signature
             SoundFileHeader SoundHeader;
-            InputFile.read( (char*)(&SoundHeader), sizeof(SoundFileHeader) );
+            memcpy( &SoundHeader, ReadMappedSection( CartridgeFile, FilePosition, sizeof(SoundFileHeader) ), sizeof(SoundFileHeader) );
             
             // check signature for embedded sound
             if( !CheckSignature( SoundHeader.Signature, Signatures::SoundFile ) )
@@ -449,22 +727,135 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
             if( TotalSPUSamples > (uint32_t)Constants::SPUMaximumCartridgeSamples )
               THROW( "Cartridge sounds contain too many total samples (Vircon SPU only allows up to 256M total samples)" );
             
-            // load the sound samples
-            vector< SPUSample > LoadedSound;
-            LoadedSound.resize( SoundHeader.SoundSamples );
-            InputFile.read( (char*)(&LoadedSound[0]), SoundHeader.SoundSamples*4 );
+            // the sound samples are used later
+            CartridgeAsset SoundAsset;
+            SoundAsset.Data = ReadMappedSection( CartridgeFile, FilePosition, SoundHeader.SoundSamples*4 );
+            SoundAsset.Bytes = SoundHeader.SoundSamples*4;
+            SoundAsset.Shape = SoundHeader.SoundSamples;
+            SoundAssets.push_back( SoundAsset );
+        }
+    }
+    
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // STEP 6: Prepare all contents
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    {
+        // identical contents are only loaded once; possible
+        // duplicates are first hashed by all loading threads
+        CartridgeLoader AssetHasher;
+        AssetHasher.Emulator = this;
+        AssetHasher.ErrorLock = 0;
+        AddAssetHashJobs( TextureAssets, AssetHasher );
+        AddAssetHashJobs( SoundAssets, AssetHasher );
+        
+        vector< SDL_Thread* > HasherThreads = StartCartridgeLoaderThreads( AssetHasher );
+        FinishCartridgeLoadJobs( AssetHasher, HasherThreads );
+        
+        FindDuplicateAssets( TextureAssets );
+        FindDuplicateAssets( SoundAssets );
+        LogDuplicateAssets( TextureAssets, "textures" );
+        LogDuplicateAssets( SoundAssets, "sounds" );
+        
+        // sounds are created in advance so that
+        // threads can fill them in any order
+        SPU.CartridgeSounds.assign( ROMHeader.NumberOfSounds, SPUSound() );
+        SPU.ResidentBytes = 0;
+        SPU.PlayCounter = 0;
+        
+        if( StreamCartridgeSounds )
+          SPU.StreamingFile = &CartridgeFile;
+          
+        // copied sounds are placed one after another
+        // in the arena, each at an aligned position
+        uint64_t ArenaSamples = 0;
+        
+        for( unsigned i = 0; i < SoundAssets.size(); i++ )
+        {
+            CartridgeAsset& Sound = SoundAssets[ i ];
+            uint32_t SoundSamples = Sound.Bytes / 4;
             
-            // create a new SPU sound and load data into it
-            SPU.CartridgeSounds.emplace_back();
-            SPU.LoadSound( SPU.CartridgeSounds.back(), &LoadedSound[0], SoundHeader.SoundSamples );
+            // streamed sounds are read from the file as needed,
+            // and duplicates just read from the same position
+            if( StreamCartridgeSounds )
+            {
+                const CartridgeAsset& Source = (Sound.Original >= 0)? SoundAssets[ Sound.Original ] : Sound;
+                SPU.MapSound( SPU.CartridgeSounds[ i ], (const SPUSample*)Source.Data, SoundSamples );
+            }
             
-            // discard the temporary buffer
-            LoadedSound.clear();
+            // otherwise, only originals need to be copied
+            else if( Sound.Original < 0 )
+            {
+                CartridgeLoadJob SoundJob;
+                SoundJob.HashedAsset = nullptr;
+                SoundJob.Source = Sound.Data;
+                SoundJob.Words = SoundSamples;
+                SoundJob.TargetSound = &SPU.CartridgeSounds[ i ];
+                SoundJob.ArenaPosition = ArenaSamples;
+                Loader.Jobs.push_back( SoundJob );
+                
+                uint64_t Alignment = SOUND_ALIGNMENT_SAMPLES;
+                ArenaSamples += (SoundSamples + Alignment - 1) / Alignment * Alignment;
+            }
         }
+        
+        // the arena is needed before any copy starts
+        if( !StreamCartridgeSounds )
+          SPU.CreateSampleArena( ArenaSamples );
     }
     
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-    // STEP 5: General Vircon setup
+    // STEP 7: Load all contents
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    {
+        LOG_SCOPE( "Loading cartridge contents" );
+        vector< SDL_Thread* > LoaderThreads = StartCartridgeLoaderThreads( Loader );
+        
+        // create all textures, directly from the mapped file
+        exception_ptr TextureError;
+        
+        try
+        {
+            for( unsigned i = 0; i < TextureHeaders.size(); i++ )
+            {
+                GPU.CartridgeTextures.emplace_back();
+                int Original = TextureAssets[ i ].Original;
+                
+                if( Original >= 0 )
+                  GPU.ShareTexture( GPU.CartridgeTextures.back(), GPU.CartridgeTextures[ Original ], (void*)TextureAssets[ i ].Data,
+                                    TextureHeaders[ i ].TextureWidth, TextureHeaders[ i ].TextureHeight );
+                else
+                  GPU.LoadTexture( GPU.CartridgeTextures.back(), (void*)TextureAssets[ i ].Data,
+                                   TextureHeaders[ i ].TextureWidth, TextureHeaders[ i ].TextureHeight );
+            }
+        }
+        
+        catch( ... )
+        {
+            TextureError = current_exception();
+        }
+        
+        // help with any remaining jobs, unless we failed
+        if( TextureError )
+          SDL_AtomicSet( &Loader.NextJob, (int)Loader.Jobs.size() );
+          
+        FinishCartridgeLoadJobs( Loader, LoaderThreads );
+        
+        if( TextureError )
+          rethrow_exception( TextureError );
+          
+        if( Loader.JobError )
+          rethrow_exception( Loader.JobError );
+          
+        // copied duplicates can only use the
+        // original sounds once they are loaded
+        if( !StreamCartridgeSounds )
+          for( unsigned i = 0; i < SoundAssets.size(); i++ )
+            if( SoundAssets[ i ].Original >= 0 )
+              SPU.ShareSound( SPU.CartridgeSounds[ i ], SPU.CartridgeSounds[ SoundAssets[ i ].Original ] );
+    }
+    
+    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+    // STEP 8: General Vircon setup
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     
     // only when loading was successful:
@@ -477,8 +868,13 @@ void VirconEmulator::LoadCartridge( const std::string& FilePath )
     CartridgeController.CartridgeVersion = ROMHeader.ROMVersion;
     CartridgeController.CartridgeRevision = ROMHeader.ROMRevision;
     
-    // finally, close input file
-    InputFile.close();
+    // finally, close input file unless
+    // sounds will be read from it
+    if( StreamCartridgeSounds )
+      LOG( "Cartridge sounds are streamed from file (up to " << (SPU.MaxResidentBytes >> 20) << " MB in memory)" );
+      
+    else
+      CartridgeFile.Close();
     
     // set window title
     string WindowTitle = string("Vircon32: ") + ROMHeader.Title;
@@ -511,6 +907,11 @@ void VirconEmulator::UnloadCartridge()
       SPU.UnloadSound( S );
     
     SPU.CartridgeSounds.clear();
+    SPU.ReleaseSampleArena();
+    
+    // sounds no longer use the cartridge file
+    SPU.StreamingFile = nullptr;
+    CartridgeFile.Close();
     
     // set window title
     SDL_SetWindowTitle( OpenGL2D.Window, "Vircon32: No cartridge" );
@@ -586,26 +987,49 @@ void VirconEmulator::RunNextFrame()
     if( !PowerIsOn || Paused )
       return;
     
+    // real frames are only measured to compare
+    // them with the costs of running ahead
+    Uint64 StartTime = 0;
+    
+    if( RunAheadFrames > 0 && !RunningAhead )
+      StartTime = SDL_GetPerformanceCounter();
+      
     // STEP 1: Begin a new frame by sending
     // a frame change message to components
     Timer.ChangeFrame();
     CPU.ChangeFrame();
     GPU.ChangeFrame();
     SPU.ChangeFrame();
-    MemoryCardController.ChangeFrame();
     GamepadController.ChangeFrame();
     
-    // STEP 2: Run a frame's worth of cycles
-    for( int i = 0; i < Constants::CyclesPerFrame; i++ )
+    // speculative card contents are never saved
+    if( !RunningAhead )
+      MemoryCardController.ChangeFrame();
+      
+    // STEP 2: Run a frame's worth of cycles; the frame is
+    // split in sound blocks, each one mixed when the cycle
+    // counter reaches its end, so that SPU commands are
+    // heard from the next block and not the next frame
+    bool CPUStopped = false;
+    
+    for( int Block = 1; Block <= BLOCKS_PER_FRAME; Block++ )
     {
-        // only these components need to
-        // be notified of each CPU cycle
-        Timer.RunNextCycle();
-        CPU.RunNextCycle();
-        
-        // end loop early when CPU is set to wait
-        if( CPU.Waiting || CPU.Halted )
-          break;
+        int BlockEndCycle = (Block * Constants::CyclesPerFrame) / BLOCKS_PER_FRAME;
+        
+        while( !CPUStopped && Timer.CycleCounter < BlockEndCycle )
+        {
+            // only these components need to
+            // be notified of each CPU cycle
+            Timer.RunNextCycle();
+            CPU.RunNextCycle();
+            
+            // end loop early when CPU is set to wait
+            CPUStopped = (CPU.Waiting || CPU.Halted);
+        }
+        
+        // a stopped CPU cannot change sound until next
+        // frame, so the remaining blocks are mixed now
+        SPU.FillNextSoundBuffer();
     }
     
     // after runnning the frame, update load info
@@ -618,7 +1042,10 @@ void VirconEmulator::RunNextFrame()
     
     // STEP 3: after running, ensure that all GPU
     // commands run in the current frame are drawn
-    glFlush();
+    GPU.Renderer->FinishFrame();
+    
+    if( StartTime )
+      RealFramesTime += SDL_GetPerformanceCounter() - StartTime;
 }
 
 // -----------------------------------------------------------------------------
@@ -681,8 +1108,7 @@ void VirconEmulator::Pause()
     // take pause actions
     Paused = true;
     
-    SPU.ThreadPauseFlag = true;
-    alSourcePause( SPU.SoundSourceID );
+    SPU.PauseAudio();
 }
 
 // -----------------------------------------------------------------------------
@@ -695,8 +1121,176 @@ void VirconEmulator::Resume()
     // take resume actions
     Paused = false;
     
-    alSourcePlay( SPU.SoundSourceID );
-    SPU.ThreadPauseFlag = false;
+    SPU.ResumeAudio();
+}
+
+
+// =============================================================================
+//      VIRCON EMULATOR: RUNNING AHEAD
+// =============================================================================
+
+
+void VirconEmulator::SaveRunAheadState()
+{
+    SavedState.CPU = CPU;
+    SavedState.Timer = Timer;
+    SavedState.RNG = RNG;
+    SavedState.GamepadController = GamepadController;
+    SavedState.MemoryCardPendingSave = MemoryCardController.PendingSave;
+    
+    SavedState.PointedTexture  = GPU.PointedTexture;
+    SavedState.PointedRegion   = GPU.PointedRegion;
+    SavedState.GPUCommand      = GPU.Command;
+    SavedState.RemainingPixels = GPU.RemainingPixels;
+    SavedState.ClearColor      = GPU.ClearColor;
+    SavedState.MultiplyColor   = GPU.MultiplyColor;
+    SavedState.ActiveBlending  = GPU.ActiveBlending;
+    SavedState.SelectedTexture = GPU.SelectedTexture;
+    SavedState.SelectedRegion  = GPU.SelectedRegion;
+    SavedState.DrawingPointX   = GPU.DrawingPointX;
+    SavedState.DrawingPointY   = GPU.DrawingPointY;
+    SavedState.DrawingScaleX   = GPU.DrawingScaleX;
+    SavedState.DrawingScaleY   = GPU.DrawingScaleY;
+    SavedState.DrawingAngle    = GPU.DrawingAngle;
+    SavedState.GPURecording    = GPU.Recorder.Recording;
+    
+    SavedState.PointedSound    = SPU.PointedSound;
+    SavedState.PointedChannel  = SPU.PointedChannel;
+    SavedState.SPUCommand      = SPU.Command;
+    SavedState.GlobalVolume    = SPU.GlobalVolume;
+    SavedState.SelectedSound   = SPU.SelectedSound;
+    SavedState.SelectedChannel = SPU.SelectedChannel;
+    memcpy( SavedState.Channels, SPU.Channels, sizeof( SPU.Channels ) );
+    
+    memcpy( SavedState.LastCPULoads, LastCPULoads, sizeof( LastCPULoads ) );
+    memcpy( SavedState.LastGPULoads, LastGPULoads, sizeof( LastGPULoads ) );
+}
+
+// -----------------------------------------------------------------------------
+
+void VirconEmulator::RestoreRunAheadState()
+{
+    CPU = SavedState.CPU;
+    Timer = SavedState.Timer;
+    RNG = SavedState.RNG;
+    GamepadController = SavedState.GamepadController;
+    MemoryCardController.PendingSave = SavedState.MemoryCardPendingSave;
+    
+    GPU.PointedTexture  = SavedState.PointedTexture;
+    GPU.PointedRegion   = SavedState.PointedRegion;
+    GPU.Command         = SavedState.GPUCommand;
+    GPU.RemainingPixels = SavedState.RemainingPixels;
+    GPU.ClearColor      = SavedState.ClearColor;
+    GPU.MultiplyColor   = SavedState.MultiplyColor;
+    GPU.ActiveBlending  = SavedState.ActiveBlending;
+    GPU.SelectedTexture = SavedState.SelectedTexture;
+    GPU.SelectedRegion  = SavedState.SelectedRegion;
+    GPU.DrawingPointX   = SavedState.DrawingPointX;
+    GPU.DrawingPointY   = SavedState.DrawingPointY;
+    GPU.DrawingScaleX   = SavedState.DrawingScaleX;
+    GPU.DrawingScaleY   = SavedState.DrawingScaleY;
+    GPU.DrawingAngle    = SavedState.DrawingAngle;
+    GPU.Recorder.Recording = SavedState.GPURecording;
+    
+    SPU.PointedSound    = SavedState.PointedSound;
+    SPU.PointedChannel  = SavedState.PointedChannel;
+    SPU.Command         = SavedState.SPUCommand;
+    SPU.GlobalVolume    = SavedState.GlobalVolume;
+    SPU.SelectedSound   = SavedState.SelectedSound;
+    SPU.SelectedChannel = SavedState.SelectedChannel;
+    memcpy( SPU.Channels, SavedState.Channels, sizeof( SPU.Channels ) );
+    
+    memcpy( LastCPULoads, SavedState.LastCPULoads, sizeof( LastCPULoads ) );
+    memcpy( LastGPULoads, SavedState.LastGPULoads, sizeof( LastGPULoads ) );
+}
+
+// -----------------------------------------------------------------------------
+
+void VirconEmulator::RunAhead()
+{
+    // do nothing when not applicable
+    if( RunAheadFrames <= 0 || !PowerIsOn || Paused )
+      return;
+      
+    Uint64 StartTime = SDL_GetPerformanceCounter();
+    SaveRunAheadState();
+    
+    // record all writes to be undone
+    RAM.Journal = &RunAheadJournal;
+    MemoryCardController.Journal = &RunAheadJournal;
+    GPU.Journal = &RunAheadJournal;
+    SPU.Journal = &RunAheadJournal;
+    
+    // nothing from these frames must reach the
+    // outputs, except for the image we will show
+    GPU.Recorder.Recording = false;
+    SPU.OutputDiscarded = true;
+    GPU.Renderer->BeginSpeculativeDrawing();
+    RunningAhead = true;
+    
+    for( int i = 0; i < RunAheadFrames; i++ )
+      RunNextFrame();
+      
+    AheadFramesTime += SDL_GetPerformanceCounter() - StartTime;
+}
+
+// -----------------------------------------------------------------------------
+
+void VirconEmulator::RollBack()
+{
+    // do nothing when not applicable
+    if( !RunningAhead )
+      return;
+      
+    Uint64 StartTime = SDL_GetPerformanceCounter();
+    JournaledWrites += RunAheadJournal.Entries.size();
+    
+    // undo all writes and stop recording them
+    RunAheadJournal.UndoWrites();
+    RAM.Journal = nullptr;
+    MemoryCardController.Journal = nullptr;
+    GPU.Journal = nullptr;
+    SPU.Journal = nullptr;
+    
+    RestoreRunAheadState();
+    SPU.OutputDiscarded = false;
+    RunningAhead = false;
+    
+    // go back to the real framebuffer, and also restore
+    // the state that the renderer keeps on its own
+    GPU.Renderer->EndSpeculativeDrawing();
+    GPU.Renderer->SetMultiplyColor( GPU.MultiplyColor );
+    GPU.Renderer->SetBlendingMode( (IOPortValues)GPU.ActiveBlending );
+    
+    RollBackTime += SDL_GetPerformanceCounter() - StartTime;
+    MeasuredUpdates++;
+    
+    if( MeasuredUpdates >= RUN_AHEAD_REPORT_UPDATES )
+      ReportRunAheadCosts();
+}
+
+// -----------------------------------------------------------------------------
+
+// the headroom is the part of a 60 fps frame left
+// free after emulating both real and ahead frames
+void VirconEmulator::ReportRunAheadCosts()
+{
+    double Milliseconds = 1000.0 / SDL_GetPerformanceFrequency() / MeasuredUpdates;
+    double RealFramesMs = RealFramesTime * Milliseconds;
+    double AheadFramesMs = AheadFramesTime * Milliseconds;
+    double RollBackMs = RollBackTime * Milliseconds;
+    double Headroom = 100.0 * (1.0 - (RealFramesMs + AheadFramesMs + RollBackMs) / (1000.0 / 60));
+    
+    LOG( "Run-ahead of " << RunAheadFrames << " frames, per update: "
+         << "real frames " << RealFramesMs << " ms"
+         << ", ahead frames " << AheadFramesMs << " ms"
+         << ", rollback " << RollBackMs << " ms"
+         << " (" << (JournaledWrites / MeasuredUpdates) << " writes)"
+         << "; headroom " << Headroom << "% of frame time" );
+         
+    RealFramesTime = AheadFramesTime = RollBackTime = 0;
+    JournaledWrites = 0;
+    MeasuredUpdates = 0;
 }
 
 
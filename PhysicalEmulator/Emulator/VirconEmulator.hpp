@@ -14,9 +14,72 @@
     #include "VirconCartridgeController.hpp"
     #include "VirconMemoryCardController.hpp"
     #include "VirconNullController.hpp"
+    #include "VirconJournal.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/MappedFile.hpp"
 // *****************************************************************************
 
 
+// =============================================================================
+//      DEFINITIONS FOR RUN-AHEAD
+// =============================================================================
+
+
+// each frame run ahead costs as much as a real one
+#define MAX_RUN_AHEAD_FRAMES     2
+
+// run-ahead costs are reported after this many updates
+#define RUN_AHEAD_REPORT_UPDATES 600
+
+// -----------------------------------------------------------------------------
+
+// Console state that must be restored after running ahead.
+// Memories are not copied: their writes are journaled.
+// Textures and sounds are never written at runtime, so
+// only their regions and loop settings are journaled too
+typedef struct
+{
+    // hardwired motherboard components
+    VirconCPU CPU;
+    VirconTimer Timer;
+    VirconRNG RNG;
+    VirconGamepadController GamepadController;
+    bool MemoryCardPendingSave;
+    
+    // GPU registers
+    GPUTexture* PointedTexture;
+    GPURegion*  PointedRegion;
+    int32_t  GPUCommand;
+    int32_t  RemainingPixels;
+    GPUColor ClearColor;
+    GPUColor MultiplyColor;
+    int32_t  ActiveBlending;
+    int32_t  SelectedTexture;
+    int32_t  SelectedRegion;
+    int32_t  DrawingPointX;
+    int32_t  DrawingPointY;
+    float    DrawingScaleX;
+    float    DrawingScaleY;
+    float    DrawingAngle;
+    bool     GPURecording;
+    
+    // SPU registers and channels
+    SPUSound*   PointedSound;
+    SPUChannel* PointedChannel;
+    int32_t SPUCommand;
+    float   GlobalVolume;
+    int32_t SelectedSound;
+    int32_t SelectedChannel;
+    SPUChannel Channels[ Constants::SPUSoundChannels ];
+    
+    // performance info
+    float LastCPULoads[ 2 ];
+    float LastGPULoads[ 2 ];
+}
+RunAheadState;
+
+
 // =============================================================================
 //      EMULATOR CLASS
 // =============================================================================
@@ -49,10 +112,35 @@ class VirconEmulator
         bool PowerIsOn;
         bool Paused;
         
+        // when sounds are streamed, the cartridge
+        // file is kept mapped while it is loaded
+        MappedFile CartridgeFile;
+        bool StreamCartridgeSounds;
+        
         // performance info (given in %)
         float LastCPULoads[ 2 ];
         float LastGPULoads[ 2 ];
         
+        // to reduce input latency, each update can show a
+        // frame emulated ahead with the current inputs
+        int RunAheadFrames;
+        bool RunningAhead;
+        RunAheadState SavedState;
+        VirconJournal RunAheadJournal;
+        
+        // measured costs of running ahead
+        Uint64 RealFramesTime;
+        Uint64 AheadFramesTime;
+        Uint64 RollBackTime;
+        uint64_t JournaledWrites;
+        unsigned MeasuredUpdates;
+        
+    private:
+    
+        void SaveRunAheadState();
+        void RestoreRunAheadState();
+        void ReportRunAheadCosts();
+        
     public:
         
         // instance handling
@@ -85,6 +173,12 @@ class VirconEmulator
         void Pause();
         void Resume();
         
+        // input latency reduction: frames run ahead
+        // are shown, and then the console is rolled
+        // back to the state before running them
+        void RunAhead();
+        void RollBack();
+        
         // external queries
         bool HasCartridge();
         bool HasMemoryCard();
@@ -4,12 +4,10 @@
     #include "../../VirconDefinitions/VirconEnumerations.hpp"
     
     // include infrastructure headers
-    #include "../DesktopInfrastructure/OpenGL2DContext.hpp"
     #include "../DesktopInfrastructure/LogStream.hpp"
     
     // include project headers
     #include "VirconGPU.hpp"
-    #include "Globals.hpp"
     
     // declare used namespaces
     using namespace std;
@@ -56,8 +54,12 @@ const GPUPortWriter GPUPortWriterTable[] =
 
 VirconGPU::VirconGPU()
 {
+    // renderer must be connected externally
+    Renderer = nullptr;
+    
     PointedTexture = nullptr;
     PointedRegion = nullptr;
+    Journal = nullptr;
     
     BiosTexture.TextureID = 0;
 }
@@ -92,64 +94,31 @@ void VirconGPU::LoadTexture( GPUTexture& TargetTexture, void* Pixels, unsigned W
     if( (int)Width > Constants::GPUTextureSize || (int)Height > Constants::GPUTextureSize )
       THROW( "Loaded image is too large to fit in a GPU texture" );
     
-    // create a new OpenGL texture and select it
-    GLuint TextureID;
-    glGenTextures( 1, &TextureID );
-    glBindTexture( GL_TEXTURE_2D, TextureID );
-    
-    // check correct texture ID
-    if( !TextureID )
-      THROW( "OpenGL failed to generate a new texture" );
-    
-    // clear OpenGL errors
-    glGetError();
-    
-    // (1) first we build an empty texture of the extented size
-    glTexImage2D
-    (
-        GL_TEXTURE_2D,              // texture is a 2D rectangle
-        0,                          // level of detail (0 = normal size)
-        GL_RGBA,                    // color components in the texture
-        Constants::GPUTextureSize,  // texture width in pixels
-        Constants::GPUTextureSize,  // texture height in pixels
-        0,                          // border width (must be 0 or 1)
-        GL_RGBA,                    // color components in the source
-        GL_UNSIGNED_BYTE,           // each color component is a byte
-        nullptr                     // buffer storing the texture data
-    );
-    
-    // check correct conversion
-    if( glGetError() != GL_NO_ERROR )
-      THROW( "Could not create an empty OpenGL texture" );
-    
-    // (2) then we modify the part of our image
-    glTexSubImage2D
-    (
-        GL_TEXTURE_2D,       // texture is a 2D rectangle
-        0,                   // level of detail (0 = normal size)
-        0,                   // x offset
-        0,                   // y offset
-        Width,               // image width in pixels
-        Height,              // image height in pixels
-        GL_RGBA,             // color components in the source
-        GL_UNSIGNED_BYTE,    // each color component is a byte
-        Pixels               // buffer storing the texture data
-    );
-    
-    // check correct conversion
-    if( glGetError() != GL_NO_ERROR )
-      THROW( "Could not copy the loaded SDL image to the OpenGL texture" );
-    
-    // textures must be scaled using only nearest neighbour
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );         
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-    
-    // out-of-texture coordinates must clamp, not wrap
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-    glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-    
-    // finally assign the OpenGL ID to target GPU texture
-    TargetTexture.TextureID = TextureID;
+    // create the texture in the renderer
+    TargetTexture.TextureID = Renderer->CreateTexture( Pixels, Width, Height );
+    TextureUsers[ TargetTexture.TextureID ] = 1;
+    
+    if( Recorder.Recording )
+      Recorder.RecordLoadTexture( GetTextureNumber( TargetTexture ), Pixels, Width, Height );
+}
+    
+// -----------------------------------------------------------------------------
+    
+// used instead of LoadTexture when the pixels are the same
+// as in an already loaded texture; regions are not shared.
+// Recordings still get the pixels, so they can be replayed
+// without knowing about shared textures
+void VirconGPU::ShareTexture( GPUTexture& TargetTexture, GPUTexture& SourceTexture, void* Pixels, unsigned Width, unsigned Height )
+{
+    // check for page number limit
+    if( (int)CartridgeTextures.size() >= Constants::GPUMaximumCartridgeTextures )
+      THROW( "All available GPU textures are already loaded" );
+    
+    TargetTexture.TextureID = SourceTexture.TextureID;
+    TextureUsers[ TargetTexture.TextureID ]++;
+    
+    if( Recorder.Recording )
+      Recorder.RecordLoadTexture( GetTextureNumber( TargetTexture ), Pixels, Width, Height );
 }
 
 // -----------------------------------------------------------------------------
@@ -159,8 +128,28 @@ void VirconGPU::UnloadTexture( GPUTexture& TargetTexture )
     if( TargetTexture.TextureID == 0 )
       return;
     
-    glDeleteTextures( 1, &TargetTexture.TextureID );
+    // only destroy it when no other textures use it
+    if( --TextureUsers[ TargetTexture.TextureID ] <= 0 )
+    {
+        Renderer->DestroyTexture( TargetTexture.TextureID );
+        TextureUsers.erase( TargetTexture.TextureID );
+    }
+    
     TargetTexture.TextureID = 0;
+    
+    if( Recorder.Recording )
+      Recorder.RecordUnloadTexture( GetTextureNumber( TargetTexture ) );
+}
+
+// -----------------------------------------------------------------------------
+
+// gives the number used by programs to select a texture
+int32_t VirconGPU::GetTextureNumber( GPUTexture& Texture )
+{
+    if( &Texture == &BiosTexture )
+      return -1;
+      
+    return &Texture - &CartridgeTextures[ 0 ];
 }
 
 
@@ -205,6 +194,16 @@ bool VirconGPU::WritePort( int32_t LocalPort, VirconWord Value )
     if( LocalPort > GPU_LastPort )
       return false;
     
+    // save all writes (even invalid values)
+    // so that the GPU can later replay them
+    if( Recorder.Recording )
+      Recorder.RecordPortWrite( LocalPort, Value );
+      
+    // region ports are stored in the pointed region,
+    // in the same order, instead of in GPU registers
+    if( Journal && LocalPort >= (int32_t)GPU_LocalPorts::RegionMinX )
+      Journal->RecordWrite( (VirconWord*)&PointedRegion->MinX + (LocalPort - (int32_t)GPU_LocalPorts::RegionMinX) );
+      
     // redirect to the needed specific writer
     GPUPortWriterTable[ LocalPort ]( *this, Value );
     return true;
@@ -218,6 +217,9 @@ bool VirconGPU::WritePort( int32_t LocalPort, VirconWord Value )
 
 void VirconGPU::ChangeFrame()
 {
+    if( Recorder.Recording )
+      Recorder.RecordFrameStart();
+      
     // restore the drawing capacity for next frame
     RemainingPixels = Constants::GPUPixelCapacityPerFrame;
 }
@@ -226,6 +228,9 @@ void VirconGPU::ChangeFrame()
 
 void VirconGPU::Reset()
 {
+    if( Recorder.Recording )
+      Recorder.RecordReset();
+      
     // reset all global ports to default values
     Command = 0;
     RemainingPixels = Constants::GPUPixelCapacityPerFrame;
@@ -273,12 +278,12 @@ void VirconGPU::Reset()
     }
     
     // initial graphic settings
-    OpenGL2D.SetBlendingMode( IOPortValues::GPUBlendingMode_Alpha );
-    OpenGL2D.SetMultiplyColor( GPUColor{ 255, 255, 255, 255 } );
+    Renderer->SetBlendingMode( IOPortValues::GPUBlendingMode_Alpha );
+    Renderer->SetMultiplyColor( GPUColor{ 255, 255, 255, 255 } );
     
     // clear the screen
-    OpenGL2D.RenderToFramebuffer();
-    OpenGL2D.ClearScreen( GPUColor{ 0, 0, 0, 255 } );
+    Renderer->RenderToFramebuffer();
+    Renderer->ClearScreen( GPUColor{ 0, 0, 0, 255 } );
 }
 
 
@@ -307,7 +312,7 @@ void VirconGPU::ClearScreen()
     }
     
     // clear the screen
-    OpenGL2D.ClearScreen( ClearColor );
+    Renderer->ClearScreen( ClearColor );
 }
 
 // -----------------------------------------------------------------------------
@@ -357,8 +362,7 @@ void VirconGPU::DrawRegion( bool ScalingEnabled, bool RotationEnabled )
     }
     
     // select this texture
-    glBindTexture( GL_TEXTURE_2D, PointedTexture->TextureID );
-    glEnable( GL_TEXTURE_2D );
+    Renderer->BindTexture( PointedTexture->TextureID );
     
     // calculate relative texture coordinates
     float TextureMinX = (Region.MinX+0.5) / Constants::GPUTextureSize;
@@ -367,7 +371,7 @@ void VirconGPU::DrawRegion( bool ScalingEnabled, bool RotationEnabled )
     float TextureMaxY = (Region.MaxY+0.5) / Constants::GPUTextureSize;
     
     // calculate screen coordinates relative to the hotspot
-    // (that way we can use OpenGL transforms to rotate)
+    // (that way we can use renderer transforms to rotate)
     int RelativeMinX = Region.MinX - Region.HotspotX;
     int RelativeMinY = Region.MinY - Region.HotspotY;
     int RelativeMaxX = RelativeMinX + RegionWidth;
@@ -384,28 +388,28 @@ void VirconGPU::DrawRegion( bool ScalingEnabled, bool RotationEnabled )
     }
     
     // set vertex positions (in render coordinates)
-    OpenGL2D.SetQuadVertexPosition( 0, RelativeMinX, RelativeMinY );
-    OpenGL2D.SetQuadVertexPosition( 1, RelativeMaxX, RelativeMinY );
-    OpenGL2D.SetQuadVertexPosition( 2, RelativeMinX, RelativeMaxY );
-    OpenGL2D.SetQuadVertexPosition( 3, RelativeMaxX, RelativeMaxY );
+    Renderer->SetQuadVertexPosition( 0, RelativeMinX, RelativeMinY );
+    Renderer->SetQuadVertexPosition( 1, RelativeMaxX, RelativeMinY );
+    Renderer->SetQuadVertexPosition( 2, RelativeMinX, RelativeMaxY );
+    Renderer->SetQuadVertexPosition( 3, RelativeMaxX, RelativeMaxY );
     
     // and texture coordinates (relative to texture: [0-1])
-    OpenGL2D.SetQuadVertexTexCoords( 0, TextureMinX, TextureMinY );
-    OpenGL2D.SetQuadVertexTexCoords( 1, TextureMaxX, TextureMinY );
-    OpenGL2D.SetQuadVertexTexCoords( 2, TextureMinX, TextureMaxY );
-    OpenGL2D.SetQuadVertexTexCoords( 3, TextureMaxX, TextureMaxY );
+    Renderer->SetQuadVertexTexCoords( 0, TextureMinX, TextureMinY );
+    Renderer->SetQuadVertexTexCoords( 1, TextureMaxX, TextureMinY );
+    Renderer->SetQuadVertexTexCoords( 2, TextureMinX, TextureMaxY );
+    Renderer->SetQuadVertexTexCoords( 3, TextureMaxX, TextureMaxY );
     
     // prepare the needed 2D spatial transforms
-    OpenGL2D.SetTranslation( TranslationX, TranslationY );
+    Renderer->SetTranslation( TranslationX, TranslationY );
     
     if( ScalingEnabled )
-      OpenGL2D.SetScale( DrawingScaleX, DrawingScaleY );
+      Renderer->SetScale( DrawingScaleX, DrawingScaleY );
     
     if( RotationEnabled )
-      OpenGL2D.SetRotation( DrawingAngle );
+      Renderer->SetRotation( DrawingAngle );
     
-    OpenGL2D.ComposeTransform( ScalingEnabled, RotationEnabled );
+    Renderer->ComposeTransform( ScalingEnabled, RotationEnabled );
     
     // draw rectangle defined as a quad (4-vertex polygon)
-    OpenGL2D.DrawTexturedQuad();
+    Renderer->DrawTexturedQuad();
 }
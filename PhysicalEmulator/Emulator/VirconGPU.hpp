@@ -3,11 +3,16 @@
     #ifndef VIRCONGPU_HPP
     #define VIRCONGPU_HPP
     
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/Render2DInterface.hpp"
+    
     // include project headers
     #include "VirconBuses.hpp"
+    #include "GPURecorder.hpp"
+    #include "VirconJournal.hpp"
     
-    // include OpenGL headers
-    #include <glad/glad.h>      // [ OpenGL ] GLAD Loader (already includes <GL/gl.h>)
+    // include C/C++ headers
+    #include <map>          // [ C++ STL ] Maps
 // *****************************************************************************
 
 
@@ -64,7 +69,7 @@ GPURegion;
 
 typedef struct
 {
-    GLuint TextureID;
+    unsigned TextureID;     // as given by the renderer
     GPURegion Regions[ Constants::GPURegionsPerTexture ];
 }
 GPUTexture;
@@ -79,10 +84,24 @@ class VirconGPU: public VirconControlInterface
 {
     public:
         
+        // host renderer that performs the drawing
+        Render2DInterface* Renderer;
+        
+        // optional recording of all GPU inputs
+        GPURecorder Recorder;
+        
+        // when connected, writes to texture
+        // regions are recorded to be undone
+        VirconJournal* Journal;
+        
         // textures loaded into GPU
         GPUTexture BiosTexture;
         std::vector< GPUTexture > CartridgeTextures;
         
+        // textures with identical contents can share the
+        // same renderer texture; this counts its users
+        std::map< unsigned, int > TextureUsers;
+        
         // accessors to active entities
         GPUTexture* PointedTexture;
         GPURegion*  PointedRegion;
@@ -113,7 +132,9 @@ class VirconGPU: public VirconControlInterface
         
         // handling video resources
         void LoadTexture( GPUTexture& TargetTexture, void* Pixels, unsigned Width, unsigned Height );
+        void ShareTexture( GPUTexture& TargetTexture, GPUTexture& SourceTexture, void* Pixels, unsigned Width, unsigned Height );
         void UnloadTexture( GPUTexture& TargetTexture );
+        int32_t GetTextureNumber( GPUTexture& Texture );
         
         // connection to control bus
         virtual bool ReadPort( int32_t LocalPort, VirconWord& Result );
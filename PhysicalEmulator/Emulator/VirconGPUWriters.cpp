@@ -2,9 +2,11 @@
     // include common Vircon headers
     #include "../../VirconDefinitions/VirconEnumerations.hpp"
     
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/Definitions.hpp"
+    
     // include project headers
     #include "VirconGPU.hpp"
-    #include "Globals.hpp"
     
     // include C/C++ headers
     #include <cmath>            // [ ANSI C ] Mathematics
@@ -69,8 +71,8 @@ void WriteGPUMultiplyColor( VirconGPU& GPU, VirconWord Value )
     // first write the value
     GPU.MultiplyColor = Value.AsColor;
     
-    // now update the corresponding value for OpenGL shaders
-    OpenGL2D.MultiplyColor = Value.AsColor;
+    // now update the corresponding value for the renderer
+    GPU.Renderer->SetMultiplyColor( Value.AsColor );
 }
 
 // -----------------------------------------------------------------------------
@@ -81,21 +83,21 @@ void WriteGPUActiveBlending( VirconGPU& GPU, VirconWord Value )
     {
         case (int32_t)IOPortValues::GPUBlendingMode_Alpha:
         {
-            OpenGL2D.SetBlendingMode( IOPortValues::GPUBlendingMode_Alpha );
+            GPU.Renderer->SetBlendingMode( IOPortValues::GPUBlendingMode_Alpha );
             GPU.ActiveBlending = Value.AsInteger;
             break;
         }
         
         case (int32_t)IOPortValues::GPUBlendingMode_Add:
         {
-            OpenGL2D.SetBlendingMode( IOPortValues::GPUBlendingMode_Add );
+            GPU.Renderer->SetBlendingMode( IOPortValues::GPUBlendingMode_Add );
             GPU.ActiveBlending = Value.AsInteger;
             break;
         }
         
         case (int32_t)IOPortValues::GPUBlendingMode_Subtract:
         {
-            OpenGL2D.SetBlendingMode( IOPortValues::GPUBlendingMode_Subtract );
+            GPU.Renderer->SetBlendingMode( IOPortValues::GPUBlendingMode_Subtract );
             GPU.ActiveBlending = Value.AsInteger;
             break;
         }
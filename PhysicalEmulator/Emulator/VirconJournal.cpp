@@ -0,0 +1,22 @@
+// *****************************************************************************
+    // include project headers
+    #include "VirconJournal.hpp"
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      VIRCON JOURNAL: UNDOING WRITES
+// =============================================================================
+
+
+void VirconJournal::UndoWrites()
+{
+    for( auto Entry = Entries.rbegin(); Entry != Entries.rend(); Entry++ )
+      *(Entry->Address) = Entry->PreviousValue;
+      
+    // keep the memory for the next use
+    Entries.clear();
+}
@@ -0,0 +1,56 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef VIRCONJOURNAL_HPP
+    #define VIRCONJOURNAL_HPP
+    
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDataStructures.hpp"
+    
+    // include C/C++ headers
+    #include <vector>       // [ C++ STL ] Vectors
+// *****************************************************************************
+
+
+// =============================================================================
+//      JOURNAL OF WRITES
+// =============================================================================
+
+
+typedef struct
+{
+    VirconWord* Address;
+    VirconWord PreviousValue;
+}
+JournalEntry;
+
+// -----------------------------------------------------------------------------
+
+// Keeps the previous values of all words written while
+// it is connected, so that those writes can be undone.
+// This is much cheaper than copying all memories when
+// only a small part of them changes in each frame
+class VirconJournal
+{
+    public:
+    
+        std::vector< JournalEntry > Entries;
+        
+    public:
+    
+        // defined here so that it can be
+        // inlined in all memory writes
+        void RecordWrite( VirconWord* Address )
+        {
+            Entries.push_back( JournalEntry{ Address, *Address } );
+        }
+        
+        // restores all words in reverse order, so that
+        // each one gets its oldest recorded value
+        void UndoWrites();
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
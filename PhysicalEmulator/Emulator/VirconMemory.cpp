@@ -21,6 +21,7 @@
 VirconRAM::VirconRAM()
 {
     MemorySize = 0;
+    Journal = nullptr;
 }
 
 // -----------------------------------------------------------------------------
@@ -127,6 +128,10 @@ bool VirconRAM::WriteAddress( int32_t LocalAddress, VirconWord Value )
     if( LocalAddress >= MemorySize )
       return false;
     
+    // keep the previous value if needed
+    if( Journal )
+      Journal->RecordWrite( &Memory[ LocalAddress ] );
+      
     // write value
     Memory[ LocalAddress ] = Value;
     return true;
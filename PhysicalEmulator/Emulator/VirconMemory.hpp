@@ -5,6 +5,7 @@
     
     // include project headers
     #include "VirconBuses.hpp"
+    #include "VirconJournal.hpp"
     
     // include C/C++ headers
     #include <string>       // [ C++ STL ] Strings
@@ -23,6 +24,9 @@ class VirconRAM: public VirconMemoryInterface
         std::vector< VirconWord > Memory;
         int32_t MemorySize;
         
+        // when connected, writes are recorded to be undone
+        VirconJournal* Journal;
+        
     public:
         
         // instance handling
@@ -9,57 +9,22 @@
     // include C/C++ headers
     #include <stdexcept>        // [ C++ STL ] Exceptions
     #include <iostream>         // [ C++ STL ] I/O Streams
-    #include <climits>          // [ ANSI C ] Numeric limits
+    #include <cmath>            // [ ANSI C ] Mathematics
+    
+    // choose the available SIMD instruction set
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+      #define SPU_MIXER_SSE2
+      #include <emmintrin.h>    // [ x86 ] SSE2 intrinsics
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+      #define SPU_MIXER_NEON
+      #include <arm_neon.h>     // [ ARM ] NEON intrinsics
+    #endif
     
     // declare used namespaces
     using namespace std;
 // *****************************************************************************
 
 
-// =============================================================================
-//      AUXILIARY AUDIO FUNCTIONS
-// =============================================================================
-    
-    
-bool IsOpenALActive()
-{
-    // STEP 1: Check there is an audio context
-    ALCcontext* AudioContext = alcGetCurrentContext();
-    
-    if( !AudioContext )
-      return false;
-    
-    alGetError();
-    
-    // STEP 2: Check there is an audio device
-    ALCdevice* AudioDevice = alcGetContextsDevice( AudioContext );
-    
-    if( !AudioDevice )
-      return false;
-    
-    alGetError();
-    
-    return true;
-}
-
-// -----------------------------------------------------------------------------
-
-ALenum GetSourceState( ALuint SourceID )
-{
-    ALenum State;
-    alGetSourcei( SourceID, AL_SOURCE_STATE, &State );
-    
-    return State;
-}
-
-// -----------------------------------------------------------------------------
-
-bool IsSourcePlaying( ALuint SourceID )
-{
-    return (GetSourceState( SourceID ) == AL_PLAYING);
-}
-
-
 // =============================================================================
 //      SPU PORT WRITERS TABLE
 // =============================================================================
@@ -100,24 +65,37 @@ VirconSPU::VirconSPU()
     PointedChannel = nullptr;
     PointedSound = nullptr;
     
-    // set null IDs for OpenAL objects
-    SoundSourceID = 0;
-    
-    // initial state for buffers
-    for( int i = 0; i < MAX_BUFFERS; i++ )
-      OutputBuffers[ i ].BufferID = 0;
-    
     // set default configuration for sound buffers
-    NumberOfBuffers = 6;      // latency would be (6 / 2) * (1/60 s) = 50 ms audio latency
+    NumberOfBuffers = 4;      // with OpenAL, latency would be (4 / 2) * (1/60 s) = 33 ms audio latency
+    OutputRing.SetCapacity( NumberOfBuffers * BLOCKS_PER_FRAME );
+    
+    // the sink is chosen by the emulator
+    Sink = nullptr;
     
-    // initial state for playback variables
-    PlaybackThread = nullptr;
-    ThreadExitFlag = false;
-    ThreadPauseFlag = true;
+    // rate control is used for sinks that need it
+    RateControlEnabled = true;
+    ReportEnabled = false;
+    ResetRateControl();
     
     // initial state for output volume control
     OutputVolume = 1.0;
     Mute = false;
+    
+    // sound is output unless running ahead
+    OutputDiscarded = false;
+    Journal = nullptr;
+    
+    // by default sounds are copied to memory
+    StreamingFile = nullptr;
+    MaxResidentBytes = 0;
+    ResidentBytes = 0;
+    PlayCounter = 0;
+    
+    // no BIOS sound yet
+    BiosSound.SampleData = nullptr;
+    BiosSound.Resident = false;
+    BiosSound.LastPlayTime = 0;
+    BiosSound.Length = 0;
 }
 
 // -----------------------------------------------------------------------------
@@ -130,10 +108,13 @@ VirconSPU::~VirconSPU()
       
     CartridgeSounds.clear();
     
+    ReleaseSampleArena();
+    
     // release BIOS sound
     UnloadSound( BiosSound );
+    BiosSamples.Release();
     
-    // release OpenAL objects
+    // release the audio output
     TerminateAudio();
 }
 
@@ -145,23 +126,12 @@ VirconSPU::~VirconSPU()
 
 void VirconSPU::InitializeAudio()
 {
-    // don't try next operations without OpenAL active
-    if( !IsOpenALActive() )
-      THROW( "OpenAL is not active" );
-    
-    // create sound buffers to alternate streaming
-    for( int i = 0; i < MAX_BUFFERS; i++ )
-      alGenBuffers( 1, &OutputBuffers[ i ].BufferID );
-    
-    // create a sound SourceID to play the buffers
-    alGenSources( 1, &SoundSourceID );
+    // the ring must match the configured
+    // buffers before the sink uses it
+    OutputRing.SetCapacity( NumberOfBuffers * BLOCKS_PER_FRAME );
     
-    // configure sound source
-    alSource3f( SoundSourceID, AL_POSITION, 0, 0, 0 );
-    alSourcef ( SoundSourceID, AL_GAIN, (Mute? 0 : OutputVolume) );
-    
-    // start the playback thread
-    LaunchPlaybackThread();
+    Sink->SetGain( Mute? 0 : OutputVolume );
+    Sink->Open( OutputRing );
 }
 
 // -----------------------------------------------------------------------------
@@ -169,92 +139,87 @@ void VirconSPU::InitializeAudio()
 void VirconSPU::TerminateAudio()
 {
     // do nothing if audio was not initialized
-    if( !SoundSourceID )
-      return;
-    
-    // don't try next operations without OpenAL active
-    if( !IsOpenALActive() )
+    if( !Sink || !Sink->IsOpen() )
       return;
     
-    // stop sound emission
-    // (must be done before clearing queue or unattaching buffer)
-    alSourceStop( SoundSourceID );
-    
-    // remove any pending queued buffers
-    ClearBufferQueue();
-    
-    // unattach any buffer from the source
-    alSourcei( SoundSourceID, AL_BUFFER, 0 );
-    
-    // stop the playback thread
-    StopPlaybackThread();
-    
-    // delete sound buffers
-    for( int i = 0; i < MAX_BUFFERS; i++ )
-      alDeleteBuffers( 1, &OutputBuffers[ i ].BufferID );
+    Sink->Close();
     
-    // delete sound source
-    alDeleteSources( 1, &SoundSourceID );
+    // report any audio problems found
+    LOG( "SPU sound underruns: " << SDL_AtomicGet( &OutputRing.Underruns ) );
+    LOG( "SPU sound overruns: " << SDL_AtomicGet( &OutputRing.Overruns ) );
+    CloseTimingFile();
+}
+
+// -----------------------------------------------------------------------------
+
+void VirconSPU::PauseAudio()
+{
+    Sink->Pause();
+}
+
+// -----------------------------------------------------------------------------
+
+void VirconSPU::ResumeAudio()
+{
+    Sink->Resume();
 }
 
 
 // =============================================================================
-//      VIRCON SPU: HANDLING PLAYBACK THREAD
+//      VIRCON SPU: AUDIO RESOURCES HANDLING
 // =============================================================================
 
 
-void VirconSPU::LaunchPlaybackThread()
+void VirconSPU::LoadBiosSound( const SPUSample* Samples, unsigned NumberOfSamples )
 {
-    LOG( "Creating SPU playback thread" );
-    
-    // ensure thread continuity, but don't play yet
-    ThreadExitFlag = false;
-    ThreadPauseFlag = true;
+    if( !BiosSamples.Allocate( (size_t)NumberOfSamples * 4, SOUND_ALIGNMENT ) )
+      THROW( "Cannot allocate memory for BIOS sound" );
+      
+    memcpy( BiosSamples.Data, Samples, (size_t)NumberOfSamples * 4 );
+    BiosSound.SampleData = (const SPUSample*)BiosSamples.Data;
+    BiosSound.Resident = true;
     
-    // create thread, if needed
-    if( !PlaybackThread )
-    {
-        PlaybackThread = SDL_CreateThread
-        (
-            SPUPlaybackThread,   // function to use as thread entry point
-            "Playback",          // thread name
-            this                 // function parameters (= the owner SPU instance)
-        );
-    }
+    // update sound length
+    BiosSound.Length = NumberOfSamples;
     
-    if( !PlaybackThread )
-      THROW( "Could not create SPU playback thread" );
+    // set initial loop properties
+    BiosSound.PlayWithLoop = false;
+    BiosSound.LoopStart = 0;
+    BiosSound.LoopEnd = BiosSound.Length - 1;
 }
 
 // -----------------------------------------------------------------------------
 
-void VirconSPU::StopPlaybackThread()
+// the loader gives each sound its position in the arena,
+// rounded up to SOUND_ALIGNMENT_SAMPLES, before copying
+void VirconSPU::CreateSampleArena( uint64_t NumberOfSamples )
 {
-    LOG( "Stopping SPU playback thread" );
-    
-    ThreadExitFlag = true;
-    
-    // wait for thread to terminate (only for a limited time)
-    if( PlaybackThread )
-    {
-        int ExitCode = 0;
-        SDL_WaitThread( PlaybackThread, &ExitCode );
-    }
-    
-    PlaybackThread = nullptr;
+    if( !SampleArena.Allocate( (size_t)NumberOfSamples * 4, SOUND_ALIGNMENT ) )
+      THROW( "Cannot allocate memory for cartridge sounds" );
 }
 
+// -----------------------------------------------------------------------------
 
-// =============================================================================
-//      VIRCON SPU: AUDIO RESOURCES HANDLING
-// =============================================================================
+// all sounds in the arena must have been unloaded
+void VirconSPU::ReleaseSampleArena()
+{
+    SampleArena.Release();
+}
 
+// -----------------------------------------------------------------------------
 
-void VirconSPU::LoadSound( SPUSound& TargetSound, SPUSample* Samples, unsigned NumberOfSamples )
+// each sound is copied to a different part of the arena,
+// so this can be called from several threads at once
+void VirconSPU::LoadSound( SPUSound& TargetSound, uint64_t ArenaPosition, const SPUSample* Samples, unsigned NumberOfSamples )
 {
-    // copy the buffer to target sound
-    TargetSound.Samples.resize( NumberOfSamples );
-    memcpy( &TargetSound.Samples[0], Samples, NumberOfSamples * 4 );
+    if( (ArenaPosition + NumberOfSamples) * 4 > SampleArena.Size )
+      THROW( "Sound does not fit in the sample arena" );
+      
+    // copy the samples to their place in the arena
+    SPUSample* ArenaSamples = (SPUSample*)SampleArena.Data + ArenaPosition;
+    memcpy( ArenaSamples, Samples, (size_t)NumberOfSamples * 4 );
+    TargetSound.SampleData = ArenaSamples;
+    TargetSound.Resident = true;
     
     // update sound length
     TargetSound.Length = NumberOfSamples;
@@ -267,13 +232,135 @@ void VirconSPU::LoadSound( SPUSound& TargetSound, SPUSample* Samples, unsigned N
 
 // -----------------------------------------------------------------------------
 
+// the samples stay in the mapped file, so they are
+// not read until the sound is played for the first time;
+// the file must remain mapped until the sound is unloaded
+void VirconSPU::MapSound( SPUSound& TargetSound, const SPUSample* Samples, unsigned NumberOfSamples )
+{
+    TargetSound.SampleData = Samples;
+    TargetSound.Resident = false;
+    TargetSound.LastPlayTime = 0;
+    
+    // sound properties are available immediately
+    TargetSound.Length = NumberOfSamples;
+    TargetSound.PlayWithLoop = false;
+    TargetSound.LoopStart = 0;
+    TargetSound.LoopEnd = TargetSound.Length - 1;
+}
+
+// -----------------------------------------------------------------------------
+
+// used instead of loading when the samples are the same as
+// in an already loaded sound; loop settings are not shared.
+// Both sounds need to be unloaded together
+void VirconSPU::ShareSound( SPUSound& TargetSound, const SPUSound& SourceSound )
+{
+    TargetSound.SampleData = SourceSound.SampleData;
+    TargetSound.Resident = !IsSoundMapped( SourceSound );
+    TargetSound.LastPlayTime = 0;
+    
+    TargetSound.Length = SourceSound.Length;
+    TargetSound.PlayWithLoop = false;
+    TargetSound.LoopStart = 0;
+    TargetSound.LoopEnd = TargetSound.Length - 1;
+}
+
+// -----------------------------------------------------------------------------
+
+// samples are kept in their buffer or arena,
+// which are released with all of their sounds
 void VirconSPU::UnloadSound( SPUSound& TargetSound )
 {
-    TargetSound.Samples.clear();
+    // a mapped sound only needs to be forgotten
+    if( IsSoundMapped( TargetSound ) && TargetSound.Resident )
+      ResidentBytes -= (uint64_t)TargetSound.Length * 4;
+      
+    TargetSound.SampleData = nullptr;
+    TargetSound.Resident = false;
+    TargetSound.LastPlayTime = 0;
     TargetSound.Length = 0;
 }
 
 
+// =============================================================================
+//      VIRCON SPU: STREAMING SOUNDS FROM FILE
+// =============================================================================
+
+
+// called when a sound starts playing; its samples are
+// requested in advance, and if too much memory is used
+// by streamed sounds, the least recently played ones
+// are released (except those in use by any channel)
+void VirconSPU::MakeSoundResident( SPUSound& TargetSound )
+{
+    // sounds in memory need nothing
+    if( !IsSoundMapped( TargetSound ) )
+      return;
+      
+    TargetSound.LastPlayTime = ++PlayCounter;
+    
+    if( TargetSound.Resident )
+      return;
+      
+    size_t Offset = (const uint8_t*)TargetSound.SampleData - StreamingFile->Data;
+    StreamingFile->PrefetchRange( Offset, (size_t)TargetSound.Length * 4 );
+    TargetSound.Resident = true;
+    ResidentBytes += (uint64_t)TargetSound.Length * 4;
+    
+    // evict sounds until we are below the limit
+    while( ResidentBytes > MaxResidentBytes )
+    {
+        SPUSound* OldestSound = nullptr;
+        
+        for( SPUSound& S: CartridgeSounds )
+          if( S.Resident && &S != &TargetSound && !IsSoundInUse( S ) )
+            if( !OldestSound || S.LastPlayTime < OldestSound->LastPlayTime )
+              OldestSound = &S;
+              
+        // sounds in use are allowed to go over the limit
+        if( !OldestSound )
+          break;
+          
+        ReleaseSound( *OldestSound );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void VirconSPU::ReleaseSound( SPUSound& TargetSound )
+{
+    size_t Offset = (const uint8_t*)TargetSound.SampleData - StreamingFile->Data;
+    StreamingFile->ReleaseRange( Offset, (size_t)TargetSound.Length * 4 );
+    TargetSound.Resident = false;
+    ResidentBytes -= (uint64_t)TargetSound.Length * 4;
+}
+
+// -----------------------------------------------------------------------------
+
+// paused channels count too, since they can resume;
+// sounds sharing the same samples are also in use
+bool VirconSPU::IsSoundInUse( const SPUSound& TargetSound )
+{
+    for( SPUChannel& C: Channels )
+      if( C.CurrentSound->SampleData == TargetSound.SampleData && C.State != IOPortValues::SPUChannelState_Stopped )
+        return true;
+        
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+// sounds that point into the file are read from it
+bool VirconSPU::IsSoundMapped( const SPUSound& TargetSound )
+{
+    if( !StreamingFile || !TargetSound.SampleData )
+      return false;
+      
+    const uint8_t* SoundStart = (const uint8_t*)TargetSound.SampleData;
+    return (SoundStart >= StreamingFile->Data && SoundStart < StreamingFile->Data + StreamingFile->Size);
+}
+
+
 // =============================================================================
 //      VIRCON SPU: I/O BUS CONNECTION
 // =============================================================================
@@ -307,9 +394,9 @@ bool VirconSPU::ReadPort( int32_t LocalPort, VirconWord& Result )
     // CASE 3: Read from channel-level parameters
     else
     {
-        // position is a double, so we need to truncate it to its integer part
+        // position is fixed point, so we only read its integer part
         if( LocalPort == (int32_t)SPU_LocalPorts::ChannelPosition )
-          Result.AsInteger = (int32_t)PointedChannel->Position;
+          Result.AsInteger = (int32_t)(PointedChannel->Position >> POSITION_FRACTION_BITS);
         
         // other channel ports can just be read as a word
         else
@@ -331,6 +418,12 @@ bool VirconSPU::WritePort( int32_t LocalPort, VirconWord Value )
     if( LocalPort > SPU_LastPort )
       return false;
     
+    // sound ports are stored in the pointed sound,
+    // in the same order, instead of in SPU registers
+    if( Journal )
+      if( LocalPort >= (int32_t)SPU_LocalPorts::SoundPlayWithLoop && LocalPort <= (int32_t)SPU_LocalPorts::SoundLoopEnd )
+        Journal->RecordWrite( (VirconWord*)&PointedSound->Length + (LocalPort - (int32_t)SPU_LocalPorts::SoundLength) );
+        
     // redirect to the needed specific writer
     SPUPortWriterTable[ LocalPort ]( *this, Value );
     
@@ -351,27 +444,19 @@ void VirconSPU::ChangeFrame()
     // actually running (this is a fail-safe mechanism
     // to prevent the emulator from losing audio in
     // some specific window, input or file events)
-    if( !IsSourcePlaying( SoundSourceID ) )
-      alSourcePlay( SoundSourceID );
-    
-    if( ThreadPauseFlag )
-      ThreadPauseFlag = false;
+    Sink->Resume();
     
-    // generate sound for next frame
-    FillNextSoundBuffer();
+    // sound is not generated here, but in blocks
+    // while the frame runs (see FillNextSoundBuffer)
 }
 
 // -----------------------------------------------------------------------------
 
 void VirconSPU::Reset()
 {
-    // reset playback variables
-    ThreadExitFlag = false;
-    ThreadPauseFlag = true;
-    
-    // stop any currently playing sounds
-    alSourceStop( SoundSourceID );
-    ClearBufferQueue();
+    // stop any currently playing sounds; the ring
+    // can only be emptied while the sink is stopped
+    Sink->Stop();
     
     // reset registers
     GlobalVolume = 1.0;
@@ -391,20 +476,14 @@ void VirconSPU::Reset()
         C.Speed = 1.0;
         C.LoopEnabled = false;
         
-        C.Position = 0.0;
+        C.Position = 0;
         C.CurrentSound = &BiosSound;
     }
     
-    // reset all output buffers
-    for( int i = 0; i < MAX_BUFFERS; i++ )
-    {
-        memset( OutputBuffers[i].Samples, 0, BYTES_PER_BUFFER );
-        OutputBuffers[i].State = SoundBufferStates::ToBeFilled;
-        OutputBuffers[i].SequenceNumber = 0;
-    }
-    
-    // begin a new buffer sequence count
-    NextBufferSequenceNumber = 0;
+    // empty the output ring; this also resets
+    // its counts for underruns and overruns
+    OutputRing.SetCapacity( NumberOfBuffers * BLOCKS_PER_FRAME );
+    ResetRateControl();
     
     // reset state of the BIOS sound
     BiosSound.PlayWithLoop = false;
@@ -419,13 +498,17 @@ void VirconSPU::Reset()
         S.LoopEnd = S.Length - 1;
     }
     
-    // reinitialize audio playback
-    InitializeBufferQueue();
-    ThreadPauseFlag = false;
-    alSourcePlay( SoundSourceID );
+    // reinitialize audio playback with the
+    // sound that the sink needs to begin
+    unsigned StartingBlocks = Sink->GetStartingBlocks();
+    
+    for( unsigned i = 0; i < StartingBlocks; i++ )
+      FillNextSoundBuffer();
+      
+    Sink->Start();
     
     // reset sound volume
-    alSourcef( SoundSourceID, AL_GAIN, (Mute? 0 : OutputVolume) );
+    Sink->SetGain( Mute? 0 : OutputVolume );
     
     // do NOT reset output volume configuration!
 }
@@ -438,6 +521,9 @@ void VirconSPU::Reset()
 
 void VirconSPU::PlayChannel( SPUChannel& TargetChannel )
 {
+    // streamed sounds need to be loaded first
+    MakeSoundResident( *TargetChannel.CurrentSound );
+    
     // case 1: for a stopped channel, set the initial play
     if( TargetChannel.State == IOPortValues::SPUChannelState_Stopped )
     {
@@ -507,258 +593,386 @@ void VirconSPU::StopAllChannels()
 
 
 // =============================================================================
-//      VIRCON SPU: GENERATING SOUND
+//      AUXILIARY FUNCTIONS FOR MIXING
 // =============================================================================
 
 
-// this function is only called from the main thread;
-// returns true if successful
-bool VirconSPU::FillNextSoundBuffer()
+// Channels are mixed one by one into 32-bit values, so
+// that intermediate sums cannot overflow. Each addition
+// is still truncated like when the mix was kept in the
+// 16-bit samples themselves, so results are the same
+inline void AddToMix( int32_t* MixedValues, const int16_t* ChannelValues, int NumberOfValues, float Volume )
 {
-    SoundBuffer* Buffer = FindNextBufferToFill();
-    if( !Buffer ) return false;
+    int i = 0;
     
-    // assign the next sequence number to this buffer
-    Buffer->SequenceNumber = NextBufferSequenceNumber;
-    NextBufferSequenceNumber++;
+    #if defined(SPU_MIXER_SSE2)
     
-    // determine the value for each sample in the buffer
-    for( int s = 0; s < BUFFER_SAMPLES; s++ )
-    {
-        // use a local variable for speed
-        SPUSample ThisSample = {0,0};
-        
-        // generate sound for all channels
-        for( int c = 0; c < Constants::SPUSoundChannels; c++ )
-        {
-            // process only playing channels
-            SPUChannel* ThisChannel = &Channels[ c ];
-            
-            if( ThisChannel->State != IOPortValues::SPUChannelState_Playing )
-              continue;
-            
-            // pick sample at this position
-            SPUSample PickedSample = ThisChannel->CurrentSound->Samples[ (int)ThisChannel->Position ];
-            
-            // mix the sample
-            float TotalVolume = GlobalVolume * ThisChannel->Volume;
-            ThisSample.LeftSample  += TotalVolume * PickedSample.LeftSample;
-            ThisSample.RightSample += TotalVolume * PickedSample.RightSample;
-            
-            // advance at current speed
-            double PreviousPosition = ThisChannel->Position;
-            ThisChannel->Position += ThisChannel->Speed;
-            
-            // if loop is enabled, check for loop boundary
-            if( ThisChannel->LoopEnabled )
-            {
-                int32_t LoopStart = ThisChannel->CurrentSound->LoopStart;
-                int32_t LoopEnd   = ThisChannel->CurrentSound->LoopEnd;
-                
-                // cannot perform loop with a bad loop configuration!
-                // (otherwise, fmod may throw an exception)
-                if( LoopEnd > LoopStart )
-                  if( PreviousPosition <= LoopEnd && ThisChannel->Position > LoopEnd )
-                  {
-                      // don't just go back to start: for high playback speeds we
-                      // may have overshot the end position, so compensate the excess
-                      double PartialAdvance = fmod( ThisChannel->Position - LoopStart, LoopEnd - LoopStart );
-                      ThisChannel->Position = LoopStart + PartialAdvance;
-                  }
-            }
-            
-            // if the sound ends, stop the channel
-            if( ThisChannel->Position > (ThisChannel->CurrentSound->Length - 1) )
-              StopChannel( *ThisChannel );
-        }
-        
-        Buffer->Samples[ s ] = ThisSample;
-    }
+      __m128 VolumeVector = _mm_set1_ps( Volume );
+      
+      for( ; i + 8 <= NumberOfValues; i += 8 )
+      {
+          // sign-extend 8 values to 32 bits
+          __m128i Values = _mm_loadu_si128( (const __m128i*)&ChannelValues[ i ] );
+          __m128i ValuesLow  = _mm_srai_epi32( _mm_unpacklo_epi16( Values, Values ), 16 );
+          __m128i ValuesHigh = _mm_srai_epi32( _mm_unpackhi_epi16( Values, Values ), 16 );
+          
+          __m128 MixedLow  = _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*)&MixedValues[ i ] ) );
+          __m128 MixedHigh = _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*)&MixedValues[ i + 4 ] ) );
+          MixedLow  = _mm_add_ps( MixedLow,  _mm_mul_ps( VolumeVector, _mm_cvtepi32_ps( ValuesLow  ) ) );
+          MixedHigh = _mm_add_ps( MixedHigh, _mm_mul_ps( VolumeVector, _mm_cvtepi32_ps( ValuesHigh ) ) );
+          
+          _mm_storeu_si128( (__m128i*)&MixedValues[ i ],     _mm_cvttps_epi32( MixedLow  ) );
+          _mm_storeu_si128( (__m128i*)&MixedValues[ i + 4 ], _mm_cvttps_epi32( MixedHigh ) );
+      }
+      
+    #elif defined(SPU_MIXER_NEON)
     
-    // ignore OpenAL errors so far
-    alGetError();
+      float32x4_t VolumeVector = vdupq_n_f32( Volume );
+      
+      for( ; i + 8 <= NumberOfValues; i += 8 )
+      {
+          // sign-extend 8 values to 32 bits
+          int16x8_t Values = vld1q_s16( &ChannelValues[ i ] );
+          int32x4_t ValuesLow  = vmovl_s16( vget_low_s16( Values ) );
+          int32x4_t ValuesHigh = vmovl_s16( vget_high_s16( Values ) );
+          
+          // multiply and add separately, as the scalar code
+          // does, since fused operations would round differently
+          float32x4_t MixedLow  = vcvtq_f32_s32( vld1q_s32( &MixedValues[ i ] ) );
+          float32x4_t MixedHigh = vcvtq_f32_s32( vld1q_s32( &MixedValues[ i + 4 ] ) );
+          MixedLow  = vaddq_f32( MixedLow,  vmulq_f32( VolumeVector, vcvtq_f32_s32( ValuesLow  ) ) );
+          MixedHigh = vaddq_f32( MixedHigh, vmulq_f32( VolumeVector, vcvtq_f32_s32( ValuesHigh ) ) );
+          
+          vst1q_s32( &MixedValues[ i ],     vcvtq_s32_f32( MixedLow  ) );
+          vst1q_s32( &MixedValues[ i + 4 ], vcvtq_s32_f32( MixedHigh ) );
+      }
+      
+    #endif
     
-    // copy our local buffer to internal OpenAL one
-    alBufferData( Buffer->BufferID, AL_FORMAT_STEREO16, Buffer->Samples, BYTES_PER_BUFFER, Constants::SPUSamplingRate );
+    // remaining values
+    for( ; i < NumberOfValues; i++ )
+      MixedValues[ i ] = (int32_t)( (float)MixedValues[ i ] + Volume * (float)ChannelValues[ i ] );
+}
+
+// -----------------------------------------------------------------------------
+
+// converts the mix to 16-bit samples, clipping values
+// that would otherwise wrap around and produce noise
+inline void SaturateMix( int16_t* OutputValues, const int32_t* MixedValues, int NumberOfValues )
+{
+    int i = 0;
+    
+    #if defined(SPU_MIXER_SSE2)
     
-    // finally, change buffer state
-    Buffer->State = SoundBufferStates::Filled;
-    return (alGetError() == AL_NO_ERROR);
+      for( ; i + 8 <= NumberOfValues; i += 8 )
+      {
+          __m128i MixedLow  = _mm_loadu_si128( (const __m128i*)&MixedValues[ i ] );
+          __m128i MixedHigh = _mm_loadu_si128( (const __m128i*)&MixedValues[ i + 4 ] );
+          _mm_storeu_si128( (__m128i*)&OutputValues[ i ], _mm_packs_epi32( MixedLow, MixedHigh ) );
+      }
+      
+    #elif defined(SPU_MIXER_NEON)
+    
+      for( ; i + 8 <= NumberOfValues; i += 8 )
+      {
+          int16x4_t OutputLow  = vqmovn_s32( vld1q_s32( &MixedValues[ i ] ) );
+          int16x4_t OutputHigh = vqmovn_s32( vld1q_s32( &MixedValues[ i + 4 ] ) );
+          vst1q_s16( &OutputValues[ i ], vcombine_s16( OutputLow, OutputHigh ) );
+      }
+      
+    #endif
+    
+    // remaining values
+    for( ; i < NumberOfValues; i++ )
+      OutputValues[ i ] = (int16_t)min( max( MixedValues[ i ], (int32_t)INT16_MIN ), (int32_t)INT16_MAX );
 }
 
 
 // =============================================================================
-//      VIRCON SPU: SEARCHING FOR SOUND BUFFERS
+//      VIRCON SPU: GENERATING SOUND
 // =============================================================================
 
 
-SoundBuffer& VirconSPU::FindBufferFromID( ALuint TargetID )
+// reads the samples that a channel will play in the next
+// block, advancing it; returns the number of samples read,
+// which is lower than requested if the channel stops
+int VirconSPU::ReadChannelSamples( SPUChannel& Channel, SPUSample* Samples, int NumberOfSamples )
 {
-    for( int i = 0; i < NumberOfBuffers; i++ )
-      if( OutputBuffers[ i ].BufferID == TargetID )
-        return OutputBuffers[ i ];
+    const SPUSound* Sound = Channel.CurrentSound;
+    
+    // an empty sound has nothing to play
+    if( Sound->Length <= 0 )
+    {
+        StopChannel( Channel );
+        return 0;
+    }
     
-    THROW( "Cannot find OpenAL buffer ID in SPU output buffers" );
+    // use local fixed point variables for speed; speeds
+    // are floats, so they convert to 32.32 without error
+    uint64_t LastPosition = (uint64_t)(Sound->Length - 1) << POSITION_FRACTION_BITS;
+    uint64_t LoopStart = (uint64_t)Sound->LoopStart << POSITION_FRACTION_BITS;
+    uint64_t LoopEnd = (uint64_t)Sound->LoopEnd << POSITION_FRACTION_BITS;
+    uint64_t Position = Channel.Position;
+    uint64_t Step = (uint64_t)ldexp( (double)Channel.Speed, POSITION_FRACTION_BITS );
+    int s = 0;
+    
+    while( s < NumberOfSamples )
+    {
+        // cannot perform loop with a bad loop configuration!
+        bool CanLoop = Channel.LoopEnabled && (LoopEnd > LoopStart) && (Position <= LoopEnd);
+        uint64_t Boundary = (CanLoop? LoopEnd : LastPosition);
+        
+        // find in advance how many steps will not cross the
+        // boundary; with integers this is exact, so they can
+        // be taken without any checks
+        int SafeSteps = NumberOfSamples - s;
+        
+        if( Position > Boundary )
+          SafeSteps = 0;
+        else if( Step > 0 )
+          SafeSteps = (int)min( (uint64_t)SafeSteps, (Boundary - Position) / Step );
+          
+        for( ; SafeSteps > 0; SafeSteps-- )
+        {
+            Samples[ s++ ] = Sound->SampleData[ Position >> POSITION_FRACTION_BITS ];
+            Position += Step;
+        }
+        
+        if( s >= NumberOfSamples )
+          break;
+          
+        // this step crosses the boundary
+        Samples[ s++ ] = Sound->SampleData[ Position >> POSITION_FRACTION_BITS ];
+        Position += Step;
+        
+        if( CanLoop )
+        {
+            // don't just go back to start: for high playback speeds we
+            // may have overshot the end position, so compensate the excess
+            Position = LoopStart + (Position - LoopStart) % (LoopEnd - LoopStart);
+        }
+        
+        // if the sound ends, stop the channel
+        else if( Position > LastPosition )
+        {
+            StopChannel( Channel );
+            return s;
+        }
+    }
+    
+    Channel.Position = Position;
+    return s;
 }
 
 // -----------------------------------------------------------------------------
 
-SoundBuffer* VirconSPU::FindNextBufferToPlay()
+// mixes all playing channels into the given samples
+// and advances them accordingly; each channel is
+// processed at once for the whole block of samples
+void VirconSPU::MixChannels( SPUSample* Samples, int NumberOfSamples )
 {
-    int MinimumSequenceNumber = INT_MAX;
-    SoundBuffer* NextBufferToPlay = nullptr;
+    memset( MixedValues, 0, 2 * NumberOfSamples * sizeof( int32_t ) );
     
-    for( int i = 0; i < NumberOfBuffers; i++ )
-      if( OutputBuffers[ i ].State == SoundBufferStates::Filled )
-        if( OutputBuffers[ i ].SequenceNumber <= MinimumSequenceNumber )
-        {
-            MinimumSequenceNumber = OutputBuffers[ i ].SequenceNumber;
-            NextBufferToPlay = &OutputBuffers[ i ];
-        }
+    for( int c = 0; c < Constants::SPUSoundChannels; c++ )
+    {
+        // process only playing channels
+        SPUChannel* ThisChannel = &Channels[ c ];
+        
+        if( ThisChannel->State != IOPortValues::SPUChannelState_Playing )
+          continue;
+          
+        int ReadSamples = ReadChannelSamples( *ThisChannel, ChannelSamples, NumberOfSamples );
+        float TotalVolume = GlobalVolume * ThisChannel->Volume;
+        AddToMix( MixedValues, (const int16_t*)ChannelSamples, 2 * ReadSamples, TotalVolume );
+    }
     
-    return NextBufferToPlay;
+    SaturateMix( (int16_t*)Samples, MixedValues, 2 * NumberOfSamples );
 }
 
 // -----------------------------------------------------------------------------
 
-SoundBuffer* VirconSPU::FindNextBufferToFill()
+// this function is only called from the main thread;
+// returns true if successful
+bool VirconSPU::FillNextSoundBuffer()
 {
-    // we can refill buffers in any order, so we don't
-    // need to look for the lowest sequence number here
-    for( int i = 0; i < NumberOfBuffers; i++ )
-      if( OutputBuffers[ i ].State == SoundBufferStates::ToBeFilled )
-        return &OutputBuffers[ i ];
+    // when the ring is full, sound is being generated
+    // faster than played and this block is dropped; but
+    // it is still mixed so that channels keep advancing
+    SoundBlock* Block = OutputRing.GetBlockToWrite();
+    
+    // with rate control the mix is resampled into
+    // the block; otherwise it is written there directly
+    bool RateControlActive = IsRateControlActive();
+    SPUSample* MixedSamples = ((RateControlActive || !Block)? BlockSamples : Block->Samples);
+    MixChannels( MixedSamples, BLOCK_SAMPLES );
+    
+    // speculative frames advance channels the same
+    // way, but their sound must never be heard; its
+    // block is not published, so it gets reused
+    if( OutputDiscarded )
+      return true;
+      
+    // let consumers see the output before volume control;
+    // they always get the exact sound of the frame, even
+    // if it will not be played
+    for( SoundConsumerInterface* Consumer: SoundConsumers )
+      Consumer->ProcessSound( MixedSamples, BLOCK_SAMPLES );
+      
+    if( !Block )
+    {
+        OutputRing.RegisterOverrun();
+        return false;
+    }
     
-    return nullptr;
+    if( RateControlActive )
+      Block->NumberOfSamples = Resampler.Resample( BlockSamples, BLOCK_SAMPLES, Block->Samples, MAX_BLOCK_SAMPLES, RateRatio );
+    else
+      Block->NumberOfSamples = BLOCK_SAMPLES;
+      
+    // hand the block over to the audio sink
+    Block->MixTime = Block->QueueTime = SDL_GetPerformanceCounter();
+    OutputRing.FinishWriting();
+    Sink->NotifyBlockWritten();
+    
+    // adjust the rate of the next block
+    UpdateRateControl();
+    return true;
 }
 
 
 // =============================================================================
-//      VIRCON SPU: HANDLING PLAYBACK BUFFER QUEUE
+//      VIRCON SPU: RATE CONTROL
 // =============================================================================
 
 
-int VirconSPU::GetQueuedBuffers()
+// sinks without a clock of their own take sound
+// as it is generated, so there is nothing to follow
+bool VirconSPU::IsRateControlActive()
 {
-    int QueuedBuffers = 0;
-    alGetSourcei( SoundSourceID, AL_BUFFERS_QUEUED, &QueuedBuffers );
-    
-    return max( QueuedBuffers, 0 );
+    return RateControlEnabled && Sink->FollowsDeviceClock();
 }
 
 // -----------------------------------------------------------------------------
 
-// NOTE: read the documentation for all cases regarding AL_BUFFERS_PROCESSED
-// (will only work right with source state AL_PLAYING)
-int VirconSPU::GetProcessedBuffers()
+void VirconSPU::ResetRateControl()
 {
-    // without this check, the playback thread produces "invalid operation" error on exit
-    int SourceState;
-    alGetSourcei( SoundSourceID, AL_SOURCE_STATE, &SourceState );
-    
-    if( SourceState != AL_PLAYING )
-      return 0;
-    
-    // now do the actual check for buffers
-    int ProcessedBuffers = 0;
-    alGetSourcei( SoundSourceID, AL_BUFFERS_PROCESSED, &ProcessedBuffers );
+    Resampler.Reset();
+    RateRatio = 1.0;
+    AverageFill = -1;     // no measures yet
     
-    return max( ProcessedBuffers, 0 );
+    MeasuredBlocks = 0;
+    MinFill = MaxFill = 0;
+    SumFills = 0;
+    ReportedUnderruns = 0;
+    ReportedOverruns = 0;
 }
 
 // -----------------------------------------------------------------------------
 
-// NOTE: read the documentation for alSourceUnqueueBuffers
-// (will only work right with source state AL_STOPPED)
-void VirconSPU::ClearBufferQueue()
+// Fill is measured just after each write. Blocks being
+// played still count as used, so on average the sink
+// keeps half a block more than it needed to start. But
+// a frame writes its blocks in a burst, and measures are
+// taken along it: on average they are lower by half of
+// the burst. The correction is proportional to the error.
+// Timing is measured for every sink, even when there is
+// no device clock to follow
+void VirconSPU::UpdateRateControl()
 {
-    int SourceState;
-    alGetSourcei( SoundSourceID, AL_SOURCE_STATE, &SourceState );
+    unsigned Fill = OutputRing.GetUsedBlocks();
     
-    if( SourceState != AL_STOPPED )
-      return;
-    
-    // remove all buffers from the queue
-    try
+    if( ReportEnabled )
     {
-        // obtain the number of buffers queued for play in the source
-        int QueuedBuffers = GetQueuedBuffers();
-        
-        // remove each buffer
-        while( QueuedBuffers-- )
-        {
-            ALuint QueuedBufferID = 0;
-            alSourceUnqueueBuffers( SoundSourceID, 1, &QueuedBufferID );
-        }
+        MinFill = (MeasuredBlocks? min( MinFill, Fill ) : Fill);
+        MaxFill = (MeasuredBlocks? max( MaxFill, Fill ) : Fill);
+        SumFills += Fill;
+        MeasuredBlocks++;
         
-        // update state for all buffers
-        for( int i = 0; i < NumberOfBuffers; i++ )
-          OutputBuffers[ i ].State = SoundBufferStates::ToBeFilled;
+        if( MeasuredBlocks >= AUDIO_REPORT_BLOCKS )
+          ReportAudioTiming();
     }
     
-    catch( const exception& e )
-    {
-        cout << "[Exception caught]: " << e.what() << endl;
-        cout.flush();
-    }
+    if( !IsRateControlActive() )
+      return;
+      
+    if( AverageFill < 0 )
+      AverageFill = Fill;
+    else
+      AverageFill += RATE_FILL_SMOOTHING * (Fill - AverageFill);
+      
+    double TargetFill = Sink->GetStartingBlocks() + 0.5 - (BLOCKS_PER_FRAME - 1) / 2.0;
+    double RelativeError = (TargetFill - AverageFill) / TargetFill;
+    Clamp( RelativeError, -1.0, 1.0 );
+    
+    RateRatio = 1.0 + MAX_RATE_ADJUSTMENT * RelativeError;
 }
 
-// -----------------------------------------------------------------------------
 
-void VirconSPU::InitializeBufferQueue()
+// =============================================================================
+//      VIRCON SPU: AUDIO TIMING REPORT
+// =============================================================================
+
+
+void VirconSPU::OpenTimingFile( const string& FilePath )
 {
-    // we will only fill half of the buffers
-    // (the rest are left free for later use)
-    for( int i = 0; i < NumberOfBuffers / 2 ; i++ )
-      FillNextSoundBuffer();
+    CloseTimingFile();
+    TimingFile.open( FilePath );
     
-    // as an exception, this one time we will
-    // need to call this from the main thread;
-    // but it is still safe: at this point the
-    // playback thread is paused and the sound
-    // source is stopped 
-    QueueFilledBuffers();
+    if( !TimingFile.is_open() )
+      THROW( "Cannot create audio timing file \"" + FilePath + "\"" );
+      
+    TimingFile << "average_fill,min_fill,max_fill,average_latency_ms,min_latency_ms,max_latency_ms,"
+               << "queue_delay_ms,played_blocks,underruns,overruns,rate_adjustment_percent" << endl;
 }
 
 // -----------------------------------------------------------------------------
 
-// this function is only called from the playback thread,
-// with only one exception for initial queuing on reset
-void VirconSPU::QueueFilledBuffers()
+void VirconSPU::CloseTimingFile()
 {
-    while( true )
-    {
-        SoundBuffer* BufferToPlay = FindNextBufferToPlay();
-        if( !BufferToPlay ) return;
-        
-        // put them in the source play queue 
-        alSourceQueueBuffers( SoundSourceID, 1, &BufferToPlay->BufferID );
-        BufferToPlay->State = SoundBufferStates::QueuedToPlay;
-    }
+    if( TimingFile.is_open() )
+      TimingFile.close();
 }
 
 // -----------------------------------------------------------------------------
 
-// this function is only called from the playback thread
-void VirconSPU::UnqueuePlayedBuffers()
-{
-    // state validations
-    if( !GetQueuedBuffers() )
-      return;
-    
-    // query number of queued buffers already processed
-    int ProcessedBuffers = GetProcessedBuffers();
-    
-    // unqueue every processed buffer
-    while( ProcessedBuffers-- )
-    {
-        ALuint ProcessedBufferID = 0;
-        alSourceUnqueueBuffers( SoundSourceID, 1, &ProcessedBufferID );
-        
-        // buffer is ready to be refilled
-        SoundBuffer& UnqueuedBuffer = FindBufferFromID( ProcessedBufferID );
-        UnqueuedBuffer.State = SoundBufferStates::ToBeFilled;
-    }
+// Latency goes from the moment a block is mixed until the
+// sink has played it, so it includes the length of the
+// block. Underruns and overruns count since last report
+void VirconSPU::ReportAudioTiming()
+{
+    SoundTimingStatistics Timing = OutputRing.TakeTimingStatistics();
+    unsigned Played = Timing.PlayedBlocks;
+    
+    double MeanFill = SumFills / MeasuredBlocks;
+    double AverageLatency = (Played? 1000 * Timing.SumLatency / Played : 0);
+    double MinLatency = 1000 * Timing.MinLatency;
+    double MaxLatency = 1000 * Timing.MaxLatency;
+    double QueueDelay = (Played? 1000 * Timing.SumQueueDelay / Played : 0);
+    
+    unsigned Underruns = SDL_AtomicGet( &OutputRing.Underruns );
+    unsigned Overruns = SDL_AtomicGet( &OutputRing.Overruns );
+    unsigned NewUnderruns = Underruns - ReportedUnderruns;
+    unsigned NewOverruns = Overruns - ReportedOverruns;
+    double RateAdjustment = 100 * (RateRatio - 1.0);
+    
+    LOG( "Audio buffer occupancy: average " << MeanFill << " blocks"
+         << ", min " << MinFill << ", max " << MaxFill
+         << "; latency: average " << AverageLatency << " ms"
+         << ", min " << MinLatency << " ms, max " << MaxLatency << " ms"
+         << " (" << QueueDelay << " ms until queued)"
+         << "; underruns " << NewUnderruns << ", overruns " << NewOverruns
+         << "; rate adjustment " << RateAdjustment << "%" );
+         
+    if( TimingFile.is_open() )
+      TimingFile << MeanFill << "," << MinFill << "," << MaxFill << ","
+                 << AverageLatency << "," << MinLatency << "," << MaxLatency << ","
+                 << QueueDelay << "," << Played << "," << NewUnderruns << "," << NewOverruns << ","
+                 << RateAdjustment << endl;
+                 
+    MeasuredBlocks = 0;
+    SumFills = 0;
+    ReportedUnderruns = Underruns;
+    ReportedOverruns = Overruns;
 }
 
 
@@ -770,7 +984,7 @@ void VirconSPU::UnqueuePlayedBuffers()
 void VirconSPU::SetOutputVolume( float NewVolume )
 {
     OutputVolume = NewVolume;
-    alSourcef( SoundSourceID, AL_GAIN, (Mute? 0 : OutputVolume) );
+    Sink->SetGain( Mute? 0 : OutputVolume );
 }
 
 // -----------------------------------------------------------------------------
@@ -778,5 +992,5 @@ void VirconSPU::SetOutputVolume( float NewVolume )
 void VirconSPU::SetMute( bool NewMute )
 {
     Mute = NewMute;
-    alSourcef( SoundSourceID, AL_GAIN, (Mute? 0 : OutputVolume) );
+    Sink->SetGain( Mute? 0 : OutputVolume );
 }
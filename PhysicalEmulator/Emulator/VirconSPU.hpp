@@ -8,18 +8,21 @@
     
     // include infrastructure headers
     #include "../DesktopInfrastructure/Definitions.hpp"
+    #include "../DesktopInfrastructure/SoundConsumerInterface.hpp"
+    #include "../DesktopInfrastructure/MappedFile.hpp"
+    #include "../DesktopInfrastructure/AlignedBuffer.hpp"
+    #include "../DesktopInfrastructure/SoundBlockRing.hpp"
+    #include "../DesktopInfrastructure/AudioSinkInterface.hpp"
+    #include "../DesktopInfrastructure/SoundResampler.hpp"
     
     // include project headers
     #include "VirconBuses.hpp"
+    #include "VirconJournal.hpp"
     
-    // include OpenAL headers
-    #if defined(__APPLE__)
-      #include <OpenAL/al.h>      // [ OpenAL ] Main header
-      #include <OpenAL/alc.h>     // [ OpenAL ] Audio contexts
-    #else
-      #include <AL/al.h>          // [ OpenAL ] Main header
-      #include <AL/alc.h>         // [ OpenAL ] Audio contexts
-    #endif
+    // include C/C++ headers
+    #include <string>           // [ C++ STL ] Strings
+    #include <vector>           // [ C++ STL ] Vectors
+    #include <fstream>          // [ C++ STL ] File streams
     
     // include SDL2 headers
     #define SDL_MAIN_HANDLED
@@ -48,42 +51,21 @@
 #define BYTES_PER_SAMPLE       4   // 1 sample = 2 channels with a 16-bit value each
 #define BYTES_PER_BUFFER    2940   // 735 samples * 4 bytes/sample
 
-// -----------------------------------------------------------------------------
+// the sink and the main loop never run at exactly
+// the same rate, so output is resampled by up to this
+// amount to keep the buffered sound at a stable level
+#define MAX_RATE_ADJUSTMENT  0.005
+#define RATE_FILL_SMOOTHING  0.02   // weight of each new fill measure in the average
+#define AUDIO_REPORT_BLOCKS  (600 * BLOCKS_PER_FRAME)   // audio timing is reported every 10 seconds
 
-// We will use these 3 states to handle audio buffers.
-// Thread safety is achieved by making each thread act
-// only over different sets of buffer states, so they
-// can never be operating over the same buffer at once.
-enum class SoundBufferStates
-{
-    ToBeFilled,     // only handled by the main thread
-    Filled,         // only handled by the playback thread
-    QueuedToPlay    // only handled by the playback thread
-};
+// cartridge sounds copied to memory are placed together
+// in a single arena, each one starting at a cache line
+#define SOUND_ALIGNMENT          64   // in bytes
+#define SOUND_ALIGNMENT_SAMPLES  16   // 64 bytes / 4 bytes per sample
 
-// -----------------------------------------------------------------------------
-
-// define the sound buffers used for SPU audio output
-typedef struct
-{
-    ALuint BufferID;
-    int32_t SequenceNumber;
-    SoundBufferStates State;
-    SPUSample Samples[ BUFFER_SAMPLES ];
-}
-SoundBuffer;
-
-
-// =============================================================================
-//      AUXILIARY AUDIO FUNCTIONS
-// =============================================================================
-
-// checking that OpenAL is active
-bool IsOpenALActive();
-
-// source properties
-ALenum GetSourceState( ALuint SourceID );
-bool IsSourcePlaying ( ALuint SourceID );
+// channel positions are kept as 32.32 fixed point
+// numbers, so that they advance the same on all hosts
+#define POSITION_FRACTION_BITS  32
 
 
 // =============================================================================
@@ -131,8 +113,14 @@ typedef struct
     int32_t LoopStart;
     int32_t LoopEnd;
     
-    // actual sound samples
-    std::vector< SPUSample > Samples;
+    // actual sound samples; they are a view of a part of
+    // the SPU sample arena (maybe shared with an identical
+    // sound) or of the cartridge file
+    const SPUSample* SampleData;
+    
+    // residency of sounds read from a file
+    bool Resident;
+    uint64_t LastPlayTime;
 }
 SPUSound;
 
@@ -147,21 +135,12 @@ typedef struct
     int32_t LoopEnabled;
     
     // other needed fields
-    double Position;         // we need double for extra range and precision
+    uint64_t Position;       // fixed point, with POSITION_FRACTION_BITS decimals
     SPUSound* CurrentSound;  // working pointer for speed
 }
 SPUChannel;
 
 
-// =============================================================================
-//      FUNCTIONS EXTERNAL TO THE SPU
-// =============================================================================
-
-
-// thread function for background continuous play
-int SPUPlaybackThread( void* Parameters );
-
-
 // =============================================================================
 //      VIRCON SPU CLASS
 // =============================================================================
@@ -175,6 +154,12 @@ class VirconSPU: public VirconControlInterface
         SPUSound BiosSound;
         std::vector< SPUSound > CartridgeSounds;
         
+        // samples of sounds copied to memory: all cartridge
+        // sounds share one arena, so they are allocated and
+        // freed at once and played with better locality
+        AlignedBuffer BiosSamples;
+        AlignedBuffer SampleArena;
+        
         // SPU registers
         int32_t Command;
         float GlobalVolume;
@@ -188,28 +173,65 @@ class VirconSPU: public VirconControlInterface
         // sound channels
         SPUChannel Channels[ Constants::SPUSoundChannels ];
         
-        // OpenAL mixer objects
-        ALuint SoundSourceID;
-        
         // sound buffer configuration
         int NumberOfBuffers;
-        SoundBuffer OutputBuffers[ MAX_BUFFERS ];
-        int NextBufferSequenceNumber;
         
-        // Variables for playback thread
-        friend int SPUPlaybackThread( void* );
-        SDL_Thread*  PlaybackThread;
+        // mixed sound is passed to the audio sink in a
+        // ring with a frame of blocks for each buffer;
+        // the sink releases each one once it is played
+        SoundBlockRing OutputRing;
+        AudioSinkInterface* Sink;
+        
+        // Rate control: when the sink plays on its own clock,
+        // the mix of each frame is resampled so that blocks in
+        // the ring stay at the level the sink started with.
+        // Otherwise it slowly runs dry or piles up latency
+        bool RateControlEnabled;
+        SoundResampler Resampler;
+        SPUSample BlockSamples[ BLOCK_SAMPLES ];    // mix of a block before resampling
+        double AverageFill;                         // in blocks, measured after each write
+        double RateRatio;                           // output samples per mixed sample
         
-        // variables accessed by the thread for playback control
-        std::string  ThreadErrorMessage;    // used by the playback thread to report errors on exceptions
-        bool ThreadExitFlag;                // used by the main thread to stop the playing thread
-        bool ThreadPauseFlag;               // used by the main thread to hold the playing thread on pause
+        // audio timing report: buffer occupancy is measured
+        // here, and latency of played blocks by the sink;
+        // reports go to the log and optionally to a CSV file
+        bool ReportEnabled;
+        std::ofstream TimingFile;
+        unsigned MeasuredBlocks;
+        unsigned MinFill, MaxFill;
+        double SumFills;
+        unsigned ReportedUnderruns;
+        unsigned ReportedOverruns;
         
         // external volume control
         // (used not by Vircon but by the GUI)
         float OutputVolume;
         bool Mute;
         
+        // external receivers of generated sound
+        // (called from the main thread)
+        std::vector< SoundConsumerInterface* > SoundConsumers;
+        
+        // speculative frames are mixed as usual to keep
+        // channels updated, but their sound is discarded;
+        // their writes to sounds are recorded to be undone
+        bool OutputDiscarded;
+        VirconJournal* Journal;
+        
+        // work buffers for mixing: the samples of one
+        // channel, and the sum of all of them so far
+        SPUSample ChannelSamples[ BLOCK_SAMPLES ];
+        int32_t MixedValues[ 2 * BLOCK_SAMPLES ];
+        
+        // Cartridge sounds can be read directly from the
+        // mapped cartridge file. The OS then loads them on
+        // first use, and we limit how much of them is kept
+        // in memory by releasing the least recently played
+        MappedFile* StreamingFile;
+        uint64_t MaxResidentBytes;
+        uint64_t ResidentBytes;
+        uint64_t PlayCounter;
+        
     private:
         
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -217,24 +239,22 @@ class VirconSPU: public VirconControlInterface
         // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
         
         // generate sound to play
-        bool FillNextSoundBuffer();
+        int ReadChannelSamples( SPUChannel& Channel, SPUSample* Samples, int NumberOfSamples );
+        void MixChannels( SPUSample* Samples, int NumberOfSamples );
         
-        // searching for sound buffers
-        SoundBuffer& FindBufferFromID( ALuint TargetID );
-        SoundBuffer* FindNextBufferToPlay();
-        SoundBuffer* FindNextBufferToFill();
+        // rate control
+        bool IsRateControlActive();
+        void ResetRateControl();
+        void UpdateRateControl();
         
-        // handling playback buffer queue
-        int GetQueuedBuffers();
-        int GetProcessedBuffers();
-        void UnqueuePlayedBuffers();
-        void QueueFilledBuffers();
-        void ClearBufferQueue();
-        void InitializeBufferQueue();
+        // audio timing report
+        void ReportAudioTiming();
         
-        // operating the playback thread
-        void LaunchPlaybackThread();
-        void StopPlaybackThread();
+        // residency of streamed sounds
+        void MakeSoundResident( SPUSound& TargetSound );
+        void ReleaseSound( SPUSound& TargetSound );
+        bool IsSoundInUse( const SPUSound& TargetSound );
+        bool IsSoundMapped( const SPUSound& TargetSound );
         
     public:
         
@@ -242,12 +262,23 @@ class VirconSPU: public VirconControlInterface
         VirconSPU();
        ~VirconSPU();
         
-        // handling audio objects
+        // handling audio output
         void InitializeAudio();
         void TerminateAudio();
+        void PauseAudio();
+        void ResumeAudio();
+        
+        // output of audio timing reports
+        void OpenTimingFile( const std::string& FilePath );
+        void CloseTimingFile();
         
         // handling of audio resources
-        void LoadSound( SPUSound& TargetSound, SPUSample* Samples, unsigned NumberOfSamples );
+        void LoadBiosSound( const SPUSample* Samples, unsigned NumberOfSamples );
+        void CreateSampleArena( uint64_t NumberOfSamples );
+        void ReleaseSampleArena();
+        void LoadSound( SPUSound& TargetSound, uint64_t ArenaPosition, const SPUSample* Samples, unsigned NumberOfSamples );
+        void MapSound( SPUSound& TargetSound, const SPUSample* Samples, unsigned NumberOfSamples );
+        void ShareSound( SPUSound& TargetSound, const SPUSound& SourceSound );
         void UnloadSound( SPUSound& TargetSound );
         
         // I/O bus connection
@@ -258,6 +289,10 @@ class VirconSPU: public VirconControlInterface
         void ChangeFrame();
         void Reset();
         
+        // called as the frame runs, at the end of each
+        // block, so that commands take effect within it
+        bool FillNextSoundBuffer();
+        
         // execution of GPU commands
         void PlayChannel ( SPUChannel& TargetChannel );
         void PauseChannel( SPUChannel& TargetChannel );
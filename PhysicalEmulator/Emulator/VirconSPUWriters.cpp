@@ -217,5 +217,5 @@ void WriteSPUChannelPosition( VirconSPU& SPU, VirconWord Value )
     
     // write the value as an integer
     // (decimal part will be reset to zero)
-    SPU.PointedChannel->Position = Value.AsInteger;
+    SPU.PointedChannel->Position = (uint64_t)Value.AsInteger << POSITION_FRACTION_BITS;
 }
@@ -0,0 +1,150 @@
+// *****************************************************************************
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    #include "../DesktopInfrastructure/WAVFunctions.hpp"
+    
+    // include project headers
+    #include "WAVAudioSink.hpp"
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      WAV AUDIO SINK: INSTANCE HANDLING
+// =============================================================================
+
+
+WAVAudioSink::WAVAudioSink()
+{
+    WrittenBytes = 0;
+    Ring = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+WAVAudioSink::~WAVAudioSink()
+{
+    Close();
+}
+
+
+// =============================================================================
+//      WAV AUDIO SINK: HANDLING THE OUTPUT DEVICE
+// =============================================================================
+
+
+void WAVAudioSink::Open( SoundBlockRing& SourceRing )
+{
+    Close();
+    
+    LOG( "Writing audio output to file \"" << FilePath << "\"" );
+    File.open( FilePath, ios::binary );
+    
+    if( File.fail() )
+      THROW( "Cannot open audio output file" );
+      
+    WrittenBytes = 0;
+    WriteWAVHeader( File, WrittenBytes );
+    Ring = &SourceRing;
+}
+
+// -----------------------------------------------------------------------------
+
+// now the sound size is known
+void WAVAudioSink::Close()
+{
+    if( !IsOpen() )
+      return;
+      
+    WriteWAVHeader( File, WrittenBytes );
+    File.close();
+    Ring = nullptr;
+    
+    LOG( "Audio output file closed (" << WrittenBytes << " bytes of sound)" );
+}
+
+// -----------------------------------------------------------------------------
+
+bool WAVAudioSink::IsOpen()
+{
+    return File.is_open();
+}
+
+
+// =============================================================================
+//      WAV AUDIO SINK: PLAYBACK CONTROL
+// =============================================================================
+
+
+// sound is written as it comes, so the file
+// only has the sound of frames that were run
+void WAVAudioSink::Start()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void WAVAudioSink::Stop()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void WAVAudioSink::Pause()
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void WAVAudioSink::Resume()
+{
+}
+
+
+// =============================================================================
+//      WAV AUDIO SINK: SOUND INPUT
+// =============================================================================
+
+
+// this is called from the emulation thread, which
+// then becomes the only consumer of the ring too
+void WAVAudioSink::NotifyBlockWritten()
+{
+    while( Ring->GetUsedBlocks() )
+    {
+        SoundBlock& Block = Ring->GetBlock( Ring->GetReleasedBlocks() );
+        unsigned BlockBytes = Block.NumberOfSamples * sizeof( SPUSample );
+        
+        File.write( (char*)Block.Samples, BlockBytes );
+        WrittenBytes += BlockBytes;
+        Ring->RegisterPlayedBlock( Block );
+        Ring->ReleaseBlock();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+unsigned WAVAudioSink::GetStartingBlocks()
+{
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// sound is taken as soon as it is written
+bool WAVAudioSink::FollowsDeviceClock()
+{
+    return false;
+}
+
+
+// =============================================================================
+//      WAV AUDIO SINK: OUTPUT VOLUME
+// =============================================================================
+
+
+void WAVAudioSink::SetGain( float NewGain )
+{
+}
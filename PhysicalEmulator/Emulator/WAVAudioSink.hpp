@@ -0,0 +1,70 @@
+// *****************************************************************************
+    // start include guard
+    #ifndef WAVAUDIOSINK_HPP
+    #define WAVAUDIOSINK_HPP
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/AudioSinkInterface.hpp"
+    #include "../DesktopInfrastructure/SoundBlockRing.hpp"
+    
+    // include C/C++ headers
+    #include <string>           // [ C++ STL ] Strings
+    #include <fstream>          // [ C++ STL ] File streams
+    #include <cstdint>          // [ ANSI C ] Standard integer types
+// *****************************************************************************
+
+
+// =============================================================================
+//      WAV AUDIO SINK CLASS
+// =============================================================================
+
+
+// Writes all sound to a WAV file as soon as it is written,
+// with no sound device and no threads. This allows headless
+// runs to keep the sound for comparison. Output volume is
+// not applied, so the file does not depend on GUI settings
+class WAVAudioSink: public AudioSinkInterface
+{
+    public:
+    
+        // configuration
+        std::string FilePath;
+        
+        // output file
+        std::ofstream File;
+        uint32_t WrittenBytes;
+        
+        // sound blocks to write
+        SoundBlockRing* Ring;
+        
+    public:
+    
+        // instance handling
+        WAVAudioSink();
+       ~WAVAudioSink();
+       
+        // handling the output device
+        virtual void Open( SoundBlockRing& SourceRing );
+        virtual void Close();
+        virtual bool IsOpen();
+        
+        // playback control
+        virtual void Start();
+        virtual void Stop();
+        virtual void Pause();
+        virtual void Resume();
+        
+        // sound input
+        virtual void NotifyBlockWritten();
+        virtual unsigned GetStartingBlocks();
+        virtual bool FollowsDeviceClock();
+        
+        // output volume
+        virtual void SetGain( float NewGain );
+};
+
+
+// *****************************************************************************
+    // end include guard
+    #endif
+// *****************************************************************************
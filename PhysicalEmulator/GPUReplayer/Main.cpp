@@ -0,0 +1,578 @@
+// *****************************************************************************
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/Definitions.hpp"
+    #include "../DesktopInfrastructure/LogStream.hpp"
+    #include "../DesktopInfrastructure/StopWatch.hpp"
+    #include "../DesktopInfrastructure/HashFunctions.hpp"
+    #include "../DesktopInfrastructure/Software2DContext.hpp"
+    #include "../DesktopInfrastructure/OpenGL2DContext.hpp"
+    
+    // include project headers
+    #include "../Emulator/VirconGPU.hpp"
+    #include "../Emulator/GPURecorder.hpp"
+    
+    // include C/C++ headers
+    #include <string>       // [ C++ STL ] Strings
+    #include <vector>       // [ C++ STL ] Vectors
+    #include <fstream>      // [ C++ STL ] File streams
+    #include <iostream>     // [ C++ STL ] I/O Streams
+    #include <cstring>      // [ ANSI C ] Strings
+    #include <cstdlib>      // [ ANSI C ] Standard library
+    #include <cstdio>       // [ ANSI C ] Standard I/O
+    #include <cinttypes>    // [ ANSI C ] Integer format macros
+    
+    // bug fix needed for SDL2 headers
+    #undef main
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      READING RECORDED STREAMS
+// =============================================================================
+
+
+// the whole recording is kept in memory so
+// that file accesses don't affect timing
+vector< uint8_t > RecordedStream;
+size_t StreamPosition = 0;
+
+// -----------------------------------------------------------------------------
+
+void LoadRecording( const string& FilePath )
+{
+    ifstream InputFile;
+    InputFile.open( FilePath, ios_base::binary | ios_base::ate );
+    
+    if( InputFile.fail() )
+      THROW( "Cannot open GPU recording file" );
+      
+    streamoff FileEnd = InputFile.tellg();
+    
+    if( FileEnd < 0 )
+      THROW( "Cannot get the size of GPU recording file" );
+      
+    size_t FileBytes = (size_t)FileEnd;
+    
+    if( FileBytes < sizeof(GPURecordingHeader) )
+      THROW( "Incorrect GPU recording format (file is too small)" );
+      
+    RecordedStream.resize( FileBytes );
+    InputFile.seekg( 0, ios_base::beg );
+    InputFile.read( (char*)(&RecordedStream[0]), FileBytes );
+    
+    if( InputFile.fail() )
+      THROW( "Cannot read GPU recording file" );
+      
+    // check the header
+    GPURecordingHeader Header;
+    memcpy( &Header, &RecordedStream[0], sizeof(GPURecordingHeader) );
+    
+    if( memcmp( Header.Signature, GPU_RECORDING_SIGNATURE, 8 ) )
+      THROW( "Incorrect GPU recording format (file does not have a valid signature)" );
+      
+    if( Header.Version != GPU_RECORDING_VERSION )
+      THROW( "GPU recording version is " + to_string( Header.Version ) + ", only version " + to_string( GPU_RECORDING_VERSION ) + " is supported" );
+      
+    StreamPosition = sizeof(GPURecordingHeader);
+}
+
+// -----------------------------------------------------------------------------
+
+const uint8_t* ReadBytes( unsigned Size )
+{
+    if( RecordedStream.size() - StreamPosition < Size )
+      THROW( "Incorrect GPU recording format (stream ends in the middle of an event)" );
+      
+    const uint8_t* Result = &RecordedStream[ StreamPosition ];
+    StreamPosition += Size;
+    return Result;
+}
+
+// -----------------------------------------------------------------------------
+
+int32_t ReadInteger()
+{
+    int32_t Value;
+    memcpy( &Value, ReadBytes( 4 ), 4 );
+    return Value;
+}
+
+
+// =============================================================================
+//      RENDERERS
+// =============================================================================
+
+
+// only the GPU is needed, connected
+// to a renderer that needs no window
+Software2DContext SoftwareRenderer;
+OpenGL2DContext OpenGLRenderer;
+VirconGPU SoftwareGPU;
+VirconGPU OpenGLGPU;
+
+// when renderers are compared, all of them
+// get the same events from the recording
+vector< VirconGPU* > ReplayedGPUs;
+
+
+// =============================================================================
+//      CHECKING REPLAYED FRAMES
+// =============================================================================
+
+
+// frame hashes can be saved to compare separate runs;
+// when comparing renderers, each line has both hashes
+ofstream HashesFile;
+bool ComparingRenderers = false;
+int CompareTolerance = 0;
+
+// results of comparing renderers
+unsigned DifferentFrames = 0;
+int FirstDifferentFrame = -1;
+int MaxDifference = 0;
+
+// images of the last frame, from each renderer
+vector< GPUColor > SoftwareImage( Constants::ScreenPixels );
+vector< GPUColor > OpenGLImage( Constants::ScreenPixels );
+
+// -----------------------------------------------------------------------------
+
+// the GL framebuffer has no alpha channel, so
+// alpha is ignored to compare both renderers
+void GetFrameImage( VirconGPU& GPU, vector< GPUColor >& Image )
+{
+    if( GPU.Renderer == &OpenGLRenderer )
+      OpenGLRenderer.ReadFramebuffer( &Image[ 0 ] );
+    else
+      Image = SoftwareRenderer.Framebuffer;
+      
+    for( GPUColor& Pixel: Image )
+      Pixel.A = 255;
+}
+
+// -----------------------------------------------------------------------------
+
+// returns the largest difference in any color
+// component, or 0 if both images are the same
+int CompareImages( const vector< GPUColor >& Image1, const vector< GPUColor >& Image2 )
+{
+    int Difference = 0;
+    
+    for( int i = 0; i < Constants::ScreenPixels; i++ )
+    {
+        Difference = max( Difference, abs( Image1[ i ].R - Image2[ i ].R ) );
+        Difference = max( Difference, abs( Image1[ i ].G - Image2[ i ].G ) );
+        Difference = max( Difference, abs( Image1[ i ].B - Image2[ i ].B ) );
+    }
+    
+    return Difference;
+}
+
+// -----------------------------------------------------------------------------
+
+void CheckFrame( unsigned FrameNumber )
+{
+    char Line[ 64 ];
+    uint64_t SoftwareHash = 0, OpenGLHash = 0;
+    
+    if( ReplayedGPUs[ 0 ] == &SoftwareGPU || ComparingRenderers )
+    {
+        GetFrameImage( SoftwareGPU, SoftwareImage );
+        SoftwareHash = HashXXH64( &SoftwareImage[ 0 ], Constants::ScreenPixels * sizeof( GPUColor ) );
+    }
+    
+    if( ReplayedGPUs[ 0 ] == &OpenGLGPU || ComparingRenderers )
+    {
+        GetFrameImage( OpenGLGPU, OpenGLImage );
+        OpenGLHash = HashXXH64( &OpenGLImage[ 0 ], Constants::ScreenPixels * sizeof( GPUColor ) );
+    }
+    
+    // use a fixed width format to ease comparisons
+    if( !ComparingRenderers )
+    {
+        uint64_t Hash = (ReplayedGPUs[ 0 ] == &OpenGLGPU)? OpenGLHash : SoftwareHash;
+        int Length = snprintf( Line, sizeof( Line ), "%08u %016" PRIx64 "\n", FrameNumber, Hash );
+        HashesFile.write( Line, Length );
+        return;
+    }
+    
+    if( HashesFile.is_open() )
+    {
+        int Length = snprintf( Line, sizeof( Line ), "%08u %016" PRIx64 " %016" PRIx64 "\n", FrameNumber, SoftwareHash, OpenGLHash );
+        HashesFile.write( Line, Length );
+    }
+    
+    // only when hashes differ the images are compared
+    if( SoftwareHash == OpenGLHash )
+      return;
+      
+    int Difference = CompareImages( SoftwareImage, OpenGLImage );
+    
+    if( Difference <= CompareTolerance )
+      return;
+      
+    // only the first differences are shown
+    if( DifferentFrames < 10 )
+      cout << "Frame " << FrameNumber << " differs between renderers (max difference " << Difference << ")" << endl;
+      
+    if( FirstDifferentFrame < 0 )
+      FirstDifferentFrame = FrameNumber;
+      
+    DifferentFrames++;
+    MaxDifference = max( MaxDifference, Difference );
+}
+
+
+// =============================================================================
+//      REPLAYING RECORDED EVENTS
+// =============================================================================
+
+
+// this needs to be done as the emulator does: textures
+// are loaded in sequence and unloaded all together
+void ReplayLoadTexture( VirconGPU& GPU )
+{
+    int32_t TextureNumber = ReadInteger();
+    int32_t Width = ReadInteger();
+    int32_t Height = ReadInteger();
+    
+    if( !IsBetween( Width , 0, Constants::GPUTextureSize )
+    ||  !IsBetween( Height, 0, Constants::GPUTextureSize ) )
+      THROW( "Incorrect GPU recording format (recorded texture has wrong dimensions)" );
+      
+    const uint8_t* Pixels = ReadBytes( Width * Height * 4 );
+    
+    if( TextureNumber == -1 )
+    {
+        GPU.LoadTexture( GPU.BiosTexture, (void*)Pixels, Width, Height );
+        return;
+    }
+    
+    if( TextureNumber != (int32_t)GPU.CartridgeTextures.size() )
+      THROW( "Incorrect GPU recording format (cartridge textures are not loaded in order)" );
+      
+    GPU.CartridgeTextures.emplace_back();
+    GPU.LoadTexture( GPU.CartridgeTextures.back(), (void*)Pixels, Width, Height );
+}
+
+// -----------------------------------------------------------------------------
+
+void ReplayUnloadTexture( VirconGPU& GPU )
+{
+    int32_t TextureNumber = ReadInteger();
+    
+    if( TextureNumber == -1 )
+    {
+        GPU.UnloadTexture( GPU.BiosTexture );
+        return;
+    }
+    
+    if( TextureNumber < 0 || TextureNumber >= (int32_t)GPU.CartridgeTextures.size() )
+      THROW( "Incorrect GPU recording format (unloaded texture does not exist)" );
+      
+    GPU.UnloadTexture( GPU.CartridgeTextures[ TextureNumber ] );
+    
+    // once the last texture is unloaded the cartridge is gone
+    while( !GPU.CartridgeTextures.empty() && GPU.CartridgeTextures.back().TextureID == 0 )
+      GPU.CartridgeTextures.pop_back();
+}
+
+// -----------------------------------------------------------------------------
+
+// all GPUs read the same event, so
+// the stream is rewound for each one
+void ReplayEvent( uint8_t EventCode )
+{
+    size_t EventPosition = StreamPosition;
+    
+    for( VirconGPU* GPU: ReplayedGPUs )
+    {
+        StreamPosition = EventPosition;
+        
+        // CASE 1: writes to GPU ports
+        if( EventCode <= GPU_LastPort )
+        {
+            VirconWord Value;
+            Value.AsInteger = ReadInteger();
+            GPU->WritePort( EventCode, Value );
+            continue;
+        }
+        
+        // CASE 2: other events
+        switch( (GPURecordingEvents)EventCode )
+        {
+            case GPURecordingEvents::FrameStart:
+                GPU->Renderer->RenderToFramebuffer();
+                GPU->ChangeFrame();
+                break;
+                
+            case GPURecordingEvents::Reset:
+                GPU->Reset();
+                break;
+                
+            case GPURecordingEvents::LoadTexture:
+                ReplayLoadTexture( *GPU );
+                break;
+                
+            case GPURecordingEvents::UnloadTexture:
+                ReplayUnloadTexture( *GPU );
+                break;
+                
+            default:
+                THROW( "Incorrect GPU recording format (unknown event code " + to_string( EventCode ) + ")" );
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// Replay times should only measure drawing, so the time
+// taken by texture uploads and frame checks is kept apart.
+// GL work is completed before and after them, so that
+// work from one part does not get counted in the other
+StopWatch ExcludedWatch;
+double TextureTime = 0;
+double CheckTime = 0;
+
+// -----------------------------------------------------------------------------
+
+void BeginExcludedTime()
+{
+    if( OpenGLGPU.Renderer )
+      glFinish();
+      
+    ExcludedWatch.GetStepTime();
+}
+
+// -----------------------------------------------------------------------------
+
+double EndExcludedTime()
+{
+    if( OpenGLGPU.Renderer )
+      glFinish();
+      
+    return ExcludedWatch.GetStepTime();
+}
+
+// -----------------------------------------------------------------------------
+
+void FinishFrame( unsigned FrameNumber )
+{
+    for( VirconGPU* GPU: ReplayedGPUs )
+      GPU->Renderer->FinishFrame();
+      
+    if( HashesFile.is_open() || ComparingRenderers )
+    {
+        BeginExcludedTime();
+        CheckFrame( FrameNumber );
+        CheckTime += EndExcludedTime();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// returns the number of frames drawn
+unsigned ReplayRecording()
+{
+    unsigned ReplayedFrames = 0;
+    
+    // start from the same state as a powered on console
+    for( VirconGPU* GPU: ReplayedGPUs )
+      GPU->Reset();
+      
+    while( StreamPosition < RecordedStream.size() )
+    {
+        uint8_t EventCode = *ReadBytes( 1 );
+        
+        // each frame is finished before the next one starts
+        if( EventCode == (uint8_t)GPURecordingEvents::FrameStart )
+        {
+            FinishFrame( ReplayedFrames );
+            ReplayedFrames++;
+        }
+        
+        bool IsTextureEvent = (EventCode == (uint8_t)GPURecordingEvents::LoadTexture
+                           ||  EventCode == (uint8_t)GPURecordingEvents::UnloadTexture);
+        
+        if( !IsTextureEvent )
+          ReplayEvent( EventCode );
+          
+        else
+        {
+            BeginExcludedTime();
+            ReplayEvent( EventCode );
+            TextureTime += EndExcludedTime();
+        }
+    }
+    
+    // draw the last frame
+    FinishFrame( ReplayedFrames );
+    return ReplayedFrames;
+}
+
+
+// =============================================================================
+//      MAIN FUNCTION
+// =============================================================================
+
+
+void ShowUsage()
+{
+    cout << "USAGE: GPUReplayer <GPU recording file> [options]" << endl;
+    cout << "Options:" << endl;
+    cout << "  -threads <N>  Use N worker threads in the software renderer" << endl;
+    cout << "  -opengl       Use the OpenGL renderer, with a headless context" << endl;
+    cout << "  -compare      Replay with both renderers and compare their frames" << endl;
+    cout << "  -tolerance <N>  When comparing, allow color differences up to N" << endl;
+    cout << "  -hashes <file>  Save a hash of each frame to the given file" << endl;
+}
+
+// -----------------------------------------------------------------------------
+
+int main( int NumberOfArguments, char* Arguments[] )
+{
+    if( NumberOfArguments < 2 )
+    {
+        ShowUsage();
+        return 1;
+    }
+    
+    // read options
+    int RenderThreads = 0;
+    bool UseOpenGL = false;
+    string HashesFilePath;
+    
+    for( int i = 2; i < NumberOfArguments; i++ )
+    {
+        string Option = Arguments[ i ];
+        
+        if( Option == "-opengl" )
+          UseOpenGL = true;
+          
+        else if( Option == "-compare" )
+          ComparingRenderers = true;
+          
+        else if( Option == "-tolerance" && i+1 < NumberOfArguments )
+          CompareTolerance = atoi( Arguments[ ++i ] );
+          
+        else if( Option == "-hashes" && i+1 < NumberOfArguments )
+          HashesFilePath = Arguments[ ++i ];
+          
+        else if( Option == "-threads" && i+1 < NumberOfArguments )
+          RenderThreads = atoi( Arguments[ ++i ] );
+          
+        else
+        {
+            ShowUsage();
+            return 1;
+        }
+    }
+    
+    try
+    {
+        LoadRecording( Arguments[ 1 ] );
+        
+        if( !HashesFilePath.empty() )
+        {
+            HashesFile.open( HashesFilePath );
+            
+            if( HashesFile.fail() )
+              THROW( "Cannot open frame hashes file" );
+        }
+        
+        // the software renderer is always first, so
+        // that it gets the events before OpenGL
+        if( !UseOpenGL || ComparingRenderers )
+        {
+            SoftwareRenderer.StartWorkers( RenderThreads );
+            SoftwareGPU.Renderer = &SoftwareRenderer;
+            ReplayedGPUs.push_back( &SoftwareGPU );
+        }
+        
+        if( UseOpenGL || ComparingRenderers )
+        {
+            OpenGLRenderer.CreateHeadlessContext();
+            OpenGLRenderer.InitRendering();
+            OpenGLRenderer.CreateFramebuffer();
+            glEnable( GL_BLEND );
+            OpenGLGPU.Renderer = &OpenGLRenderer;
+            ReplayedGPUs.push_back( &OpenGLGPU );
+        }
+        
+        // draw all frames as fast as possible
+        StopWatch Watch;
+        Watch.GetStepTime();
+        
+        unsigned ReplayedFrames = ReplayRecording();
+        
+        // GL commands may still be running
+        if( UseOpenGL || ComparingRenderers )
+          glFinish();
+          
+        double ElapsedTime = Watch.GetStepTime();
+        
+        // report results; frame times only count drawing
+        // (when comparing, that is for both renderers)
+        double DrawingTime = ElapsedTime - TextureTime - CheckTime;
+        cout << "Replayed frames: " << ReplayedFrames << endl;
+        cout << "Elapsed time: " << ElapsedTime << " s" << endl;
+        cout << "Texture loading time: " << TextureTime << " s" << endl;
+        
+        if( HashesFile.is_open() || ComparingRenderers )
+          cout << "Frame checking time: " << CheckTime << " s" << endl;
+          
+        cout << "Drawing time: " << DrawingTime << " s" << endl;
+        
+        if( ReplayedFrames > 0 && DrawingTime > 0 )
+        {
+            cout << "Average frame time: " << 1000.0 * DrawingTime / ReplayedFrames << " ms" << endl;
+            cout << "Frames per second: " << ReplayedFrames / DrawingTime << endl;
+        }
+        
+        if( ComparingRenderers )
+        {
+            if( DifferentFrames == 0 )
+              cout << "Both renderers produced the same frames" << endl;
+              
+            else
+            {
+                cout << "Frames that differ between renderers: " << DifferentFrames << endl;
+                cout << "First different frame: " << FirstDifferentFrame << endl;
+                cout << "Max color difference: " << MaxDifference << endl;
+            }
+        }
+        
+        // textures must be released while the renderer exists
+        for( VirconGPU* GPU: ReplayedGPUs )
+        {
+            GPU->UnloadTexture( GPU->BiosTexture );
+            
+            for( GPUTexture& T: GPU->CartridgeTextures )
+              GPU->UnloadTexture( T );
+              
+            GPU->CartridgeTextures.clear();
+        }
+        
+        SoftwareRenderer.StopWorkers();
+        OpenGLRenderer.Destroy();
+        HashesFile.close();
+        
+        // mismatches are reported as errors for scripts
+        if( DifferentFrames > 0 )
+          return 2;
+    }
+    
+    catch( const exception& e )
+    {
+        cout << "ERROR: " << e.what() << endl;
+        return 1;
+    }
+    
+    return 0;
+}
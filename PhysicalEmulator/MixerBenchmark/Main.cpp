@@ -0,0 +1,576 @@
+// *****************************************************************************
+    // include common Vircon headers
+    #include "../../VirconDefinitions/VirconDefinitions.hpp"
+    
+    // include infrastructure headers
+    #include "../DesktopInfrastructure/Definitions.hpp"
+    #include "../DesktopInfrastructure/StopWatch.hpp"
+    
+    // include project headers
+    #include "../Emulator/VirconSPU.hpp"
+    #include "../Emulator/NullAudioSink.hpp"
+    
+    // include C/C++ headers
+    #include <vector>       // [ C++ STL ] Vectors
+    #include <iostream>     // [ C++ STL ] I/O Streams
+    #include <random>       // [ C++ STL ] Random numbers
+    #include <cstdlib>      // [ ANSI C ] Standard library
+    #include <cstring>      // [ ANSI C ] Strings
+    #include <cmath>        // [ ANSI C ] Mathematics
+    
+    // bug fix needed for SDL2 headers
+    #undef main
+    
+    // declare used namespaces
+    using namespace std;
+// *****************************************************************************
+
+
+// =============================================================================
+//      BENCHMARK SCENARIO
+// =============================================================================
+
+
+// All channels play at once, which is the worst case for
+// the mixer. Sounds and channel settings are random, but
+// with a fixed seed so that every run mixes the same sound
+#define BENCHMARK_SOUNDS        8
+#define MIN_SOUND_SAMPLES    1000
+#define MAX_SOUND_SAMPLES   44100   // 1 second
+#define BENCHMARK_SEED      12345
+
+// the sink must outlive the SPU, which closes it
+NullAudioSink Sink;
+VirconSPU SPU;
+
+// -----------------------------------------------------------------------------
+
+// sounds are placed in the sample arena as the
+// cartridge loader does; half of them have loops
+void CreateSounds()
+{
+    mt19937 Generator( BENCHMARK_SEED );
+    uniform_int_distribution< int > LengthDistribution( MIN_SOUND_SAMPLES, MAX_SOUND_SAMPLES );
+    uniform_int_distribution< int > ValueDistribution( INT16_MIN, INT16_MAX );
+    
+    vector< vector< SPUSample > > SoundSamples( BENCHMARK_SOUNDS );
+    uint64_t ArenaSamples = 0;
+    
+    for( vector< SPUSample >& Samples: SoundSamples )
+    {
+        Samples.resize( LengthDistribution( Generator ) );
+        
+        for( SPUSample& Sample: Samples )
+        {
+            Sample.LeftSample = ValueDistribution( Generator );
+            Sample.RightSample = ValueDistribution( Generator );
+        }
+        
+        ArenaSamples += (Samples.size() + SOUND_ALIGNMENT_SAMPLES - 1) / SOUND_ALIGNMENT_SAMPLES * SOUND_ALIGNMENT_SAMPLES;
+    }
+    
+    SPU.CreateSampleArena( ArenaSamples );
+    SPU.CartridgeSounds.resize( BENCHMARK_SOUNDS );
+    uint64_t ArenaPosition = 0;
+    
+    for( int i = 0; i < BENCHMARK_SOUNDS; i++ )
+    {
+        SPUSound& Sound = SPU.CartridgeSounds[ i ];
+        unsigned Length = SoundSamples[ i ].size();
+        SPU.LoadSound( Sound, ArenaPosition, &SoundSamples[ i ][ 0 ], Length );
+        ArenaPosition += (Length + SOUND_ALIGNMENT_SAMPLES - 1) / SOUND_ALIGNMENT_SAMPLES * SOUND_ALIGNMENT_SAMPLES;
+        
+        if( i % 2 )
+        {
+            uniform_int_distribution< int > LoopStartDistribution( 0, Length / 2 );
+            Sound.PlayWithLoop = true;
+            Sound.LoopStart = LoopStartDistribution( Generator );
+            
+            uniform_int_distribution< int > LoopEndDistribution( Sound.LoopStart + 1, Length - 1 );
+            Sound.LoopEnd = LoopEndDistribution( Generator );
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// every measure starts from these same channels; volumes
+// are low enough that 16 channels do not clip, since the
+// old mixer could not handle that
+void SetupChannels()
+{
+    mt19937 Generator( BENCHMARK_SEED );
+    uniform_int_distribution< int > SoundDistribution( 0, BENCHMARK_SOUNDS - 1 );
+    uniform_real_distribution< float > VolumeDistribution( 0.01f, 0.06f );
+    uniform_real_distribution< float > SpeedDistribution( 0.25f, 4.0f );
+    
+    SPU.GlobalVolume = 1.0;
+    
+    for( SPUChannel& Channel: SPU.Channels )
+    {
+        Channel.AssignedSound = SoundDistribution( Generator );
+        Channel.CurrentSound = &SPU.CartridgeSounds[ Channel.AssignedSound ];
+        Channel.Volume = VolumeDistribution( Generator );
+        Channel.Speed = SpeedDistribution( Generator );
+        Channel.State = IOPortValues::SPUChannelState_Stopped;
+        SPU.PlayChannel( Channel );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// same channels, but loud enough for the mix to clip often,
+// and with speeds from stopped to many loops per sample
+void SetupClippingChannels()
+{
+    SetupChannels();
+    
+    mt19937 Generator( BENCHMARK_SEED + 1 );
+    uniform_real_distribution< float > SpeedDistribution( 0.0f, 64.0f );
+    
+    SPU.GlobalVolume = 16.0;
+    
+    for( SPUChannel& Channel: SPU.Channels )
+      Channel.Speed = SpeedDistribution( Generator );
+      
+    SPU.Channels[ 0 ].Speed = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+// channels whose sound ended are played again,
+// to keep all of them playing in every frame
+void RestartStoppedChannels()
+{
+    for( SPUChannel& Channel: SPU.Channels )
+      if( Channel.State == IOPortValues::SPUChannelState_Stopped )
+        SPU.PlayChannel( Channel );
+}
+
+
+// =============================================================================
+//      OLD PER-SAMPLE MIXER
+// =============================================================================
+
+
+// channel state as the SPU kept it before
+// positions were changed to fixed point
+typedef struct
+{
+    IOPortValues State;
+    float Volume;
+    float Speed;
+    int32_t LoopEnabled;
+    double Position;
+    const SPUSound* CurrentSound;
+}
+OldSPUChannel;
+
+OldSPUChannel OldChannels[ Constants::SPUSoundChannels ];
+SPUSample OldMixerSamples[ BLOCK_SAMPLES ];
+
+// -----------------------------------------------------------------------------
+
+void SetupOldChannels()
+{
+    SetupChannels();
+    
+    for( int c = 0; c < Constants::SPUSoundChannels; c++ )
+    {
+        OldChannels[ c ].State = SPU.Channels[ c ].State;
+        OldChannels[ c ].Volume = SPU.Channels[ c ].Volume;
+        OldChannels[ c ].Speed = SPU.Channels[ c ].Speed;
+        OldChannels[ c ].LoopEnabled = SPU.Channels[ c ].LoopEnabled;
+        OldChannels[ c ].Position = 0;
+        OldChannels[ c ].CurrentSound = SPU.Channels[ c ].CurrentSound;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// This is the loop that the SPU used to fill its buffers,
+// with only sample reading adapted to current sounds. All
+// channels are processed sample by sample, and the state,
+// loop and end of each one are checked for every sample
+void MixPerSampleOld( SPUSample* Samples, int NumberOfSamples )
+{
+    for( int s = 0; s < NumberOfSamples; s++ )
+    {
+        // use a local variable for speed
+        SPUSample ThisSample = {0,0};
+        
+        // generate sound for all channels
+        for( int c = 0; c < Constants::SPUSoundChannels; c++ )
+        {
+            // process only playing channels
+            OldSPUChannel* ThisChannel = &OldChannels[ c ];
+            
+            if( ThisChannel->State != IOPortValues::SPUChannelState_Playing )
+              continue;
+              
+            // pick sample at this position
+            SPUSample PickedSample = ThisChannel->CurrentSound->SampleData[ (int)ThisChannel->Position ];
+            
+            // mix the sample
+            float TotalVolume = SPU.GlobalVolume * ThisChannel->Volume;
+            ThisSample.LeftSample  += TotalVolume * PickedSample.LeftSample;
+            ThisSample.RightSample += TotalVolume * PickedSample.RightSample;
+            
+            // advance at current speed
+            double PreviousPosition = ThisChannel->Position;
+            ThisChannel->Position += ThisChannel->Speed;
+            
+            // if loop is enabled, check for loop boundary
+            if( ThisChannel->LoopEnabled )
+            {
+                int32_t LoopStart = ThisChannel->CurrentSound->LoopStart;
+                int32_t LoopEnd   = ThisChannel->CurrentSound->LoopEnd;
+                
+                // cannot perform loop with a bad loop configuration!
+                if( LoopEnd > LoopStart )
+                  if( PreviousPosition <= LoopEnd && ThisChannel->Position > LoopEnd )
+                  {
+                      double PartialAdvance = fmod( ThisChannel->Position - LoopStart, LoopEnd - LoopStart );
+                      ThisChannel->Position = LoopStart + PartialAdvance;
+                  }
+            }
+            
+            // if the sound ends, stop the channel
+            if( ThisChannel->Position > (ThisChannel->CurrentSound->Length - 1) )
+            {
+                ThisChannel->State = IOPortValues::SPUChannelState_Stopped;
+                ThisChannel->Position = 0;
+            }
+        }
+        
+        Samples[ s ] = ThisSample;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void RestartStoppedOldChannels()
+{
+    for( OldSPUChannel& Channel: OldChannels )
+      if( Channel.State == IOPortValues::SPUChannelState_Stopped )
+        Channel.State = IOPortValues::SPUChannelState_Playing;
+}
+
+
+// =============================================================================
+//      REFERENCE MIXER
+// =============================================================================
+
+
+// This mixer follows the same rules as the SPU, but one
+// sample at a time: positions are 32.32 fixed point, loops
+// are wrapped with an integer modulo, each channel is added
+// with truncation and the mix is saturated to 16 bits. The
+// SPU must produce exactly the same samples and channels
+SPUChannel ReferenceChannels[ Constants::SPUSoundChannels ];
+SPUSample ReferenceSamples[ BLOCK_SAMPLES ];
+
+// -----------------------------------------------------------------------------
+
+void MixPerSampleReference( SPUSample* Samples, int NumberOfSamples )
+{
+    for( int s = 0; s < NumberOfSamples; s++ )
+    {
+        int32_t MixedLeft = 0;
+        int32_t MixedRight = 0;
+        
+        for( SPUChannel& Channel: ReferenceChannels )
+        {
+            if( Channel.State != IOPortValues::SPUChannelState_Playing )
+              continue;
+              
+            // an empty sound has nothing to play
+            const SPUSound* Sound = Channel.CurrentSound;
+            
+            if( Sound->Length <= 0 )
+            {
+                Channel.State = IOPortValues::SPUChannelState_Stopped;
+                Channel.Position = 0;
+                continue;
+            }
+            
+            // pick sample at this position and mix it
+            SPUSample PickedSample = Sound->SampleData[ Channel.Position >> POSITION_FRACTION_BITS ];
+            float TotalVolume = SPU.GlobalVolume * Channel.Volume;
+            MixedLeft  = (int32_t)( (float)MixedLeft  + TotalVolume * (float)PickedSample.LeftSample  );
+            MixedRight = (int32_t)( (float)MixedRight + TotalVolume * (float)PickedSample.RightSample );
+            
+            // the loop can only be taken if it was
+            // not already passed before this step
+            uint64_t LastPosition = (uint64_t)(Sound->Length - 1) << POSITION_FRACTION_BITS;
+            uint64_t LoopStart = (uint64_t)Sound->LoopStart << POSITION_FRACTION_BITS;
+            uint64_t LoopEnd = (uint64_t)Sound->LoopEnd << POSITION_FRACTION_BITS;
+            bool CanLoop = Channel.LoopEnabled && (LoopEnd > LoopStart) && (Channel.Position <= LoopEnd);
+            
+            // advance at current speed
+            Channel.Position += (uint64_t)ldexp( (double)Channel.Speed, POSITION_FRACTION_BITS );
+            
+            if( CanLoop )
+            {
+                if( Channel.Position > LoopEnd )
+                  Channel.Position = LoopStart + (Channel.Position - LoopStart) % (LoopEnd - LoopStart);
+            }
+            
+            // if the sound ends, stop the channel
+            else if( Channel.Position > LastPosition )
+            {
+                Channel.State = IOPortValues::SPUChannelState_Stopped;
+                Channel.Position = 0;
+            }
+        }
+        
+        Samples[ s ].LeftSample  = (int16_t)min( max( MixedLeft,  (int32_t)INT16_MIN ), (int32_t)INT16_MAX );
+        Samples[ s ].RightSample = (int16_t)min( max( MixedRight, (int32_t)INT16_MIN ), (int32_t)INT16_MAX );
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// the reference starts from the current SPU channels
+void CopyChannelsToReference()
+{
+    for( int c = 0; c < Constants::SPUSoundChannels; c++ )
+      ReferenceChannels[ c ] = SPU.Channels[ c ];
+}
+
+// -----------------------------------------------------------------------------
+
+// same as playing a stopped channel in the SPU
+void RestartStoppedReferenceChannels()
+{
+    for( SPUChannel& Channel: ReferenceChannels )
+      if( Channel.State == IOPortValues::SPUChannelState_Stopped )
+      {
+          Channel.Position = 0;
+          Channel.LoopEnabled = Channel.CurrentSound->PlayWithLoop;
+          Channel.State = IOPortValues::SPUChannelState_Playing;
+      }
+}
+
+
+// =============================================================================
+//      CHECKING THE SPU MIXER
+// =============================================================================
+
+
+// keeps a copy of each block mixed by the SPU
+class MixCapture: public SoundConsumerInterface
+{
+    public:
+        
+        SPUSample Samples[ BLOCK_SAMPLES ];
+        
+        virtual void ProcessSound( const SPUSample* NewSamples, unsigned NumberOfSamples )
+        {
+            NumberOfSamples = min( NumberOfSamples, (unsigned)BLOCK_SAMPLES );
+            memcpy( Samples, NewSamples, NumberOfSamples * sizeof( SPUSample ) );
+        }
+};
+
+// -----------------------------------------------------------------------------
+
+// mixes the frames with both the SPU and the reference, starting
+// from the current SPU channels; after every block the output and
+// channels must match exactly. Returns the number of blocks that
+// did not match
+int CheckSPUMixer( int Frames )
+{
+    MixCapture Capture;
+    SPU.SoundConsumers.push_back( &Capture );
+    CopyChannelsToReference();
+    int DifferentBlocks = 0;
+    
+    for( int f = 0; f < Frames; f++ )
+    {
+        RestartStoppedChannels();
+        RestartStoppedReferenceChannels();
+        
+        for( int b = 0; b < BLOCKS_PER_FRAME; b++ )
+        {
+            SPU.FillNextSoundBuffer();
+            MixPerSampleReference( ReferenceSamples, BLOCK_SAMPLES );
+            bool BlocksMatch = !memcmp( Capture.Samples, ReferenceSamples, sizeof( ReferenceSamples ) );
+            
+            for( int c = 0; c < Constants::SPUSoundChannels; c++ )
+            {
+                BlocksMatch &= (SPU.Channels[ c ].State == ReferenceChannels[ c ].State);
+                BlocksMatch &= (SPU.Channels[ c ].Position == ReferenceChannels[ c ].Position);
+            }
+            
+            if( BlocksMatch )
+              continue;
+              
+            if( !DifferentBlocks )
+              cout << "First difference at frame " << f << ", block " << b << endl;
+              
+            DifferentBlocks++;
+        }
+    }
+    
+    SPU.SoundConsumers.clear();
+    return DifferentBlocks;
+}
+
+
+// =============================================================================
+//      MEASURING MIXERS
+// =============================================================================
+
+
+// each frame is mixed in blocks, like the emulator
+// does; returns the elapsed time in seconds
+double MeasureOldMixer( int Frames )
+{
+    SetupOldChannels();
+    
+    StopWatch Watch;
+    Watch.GetStepTime();
+    
+    for( int f = 0; f < Frames; f++ )
+    {
+        RestartStoppedOldChannels();
+        
+        for( int b = 0; b < BLOCKS_PER_FRAME; b++ )
+          MixPerSampleOld( OldMixerSamples, BLOCK_SAMPLES );
+    }
+    
+    return Watch.GetStepTime();
+}
+
+// -----------------------------------------------------------------------------
+
+double MeasureReferenceMixer( int Frames )
+{
+    SetupChannels();
+    CopyChannelsToReference();
+    
+    StopWatch Watch;
+    Watch.GetStepTime();
+    
+    for( int f = 0; f < Frames; f++ )
+    {
+        RestartStoppedReferenceChannels();
+        
+        for( int b = 0; b < BLOCKS_PER_FRAME; b++ )
+          MixPerSampleReference( ReferenceSamples, BLOCK_SAMPLES );
+    }
+    
+    return Watch.GetStepTime();
+}
+
+// -----------------------------------------------------------------------------
+
+// the SPU mixes each block as the frame runs, and
+// then hands it to the sink (which discards it)
+double MeasureSPUMixer( int Frames )
+{
+    SetupChannels();
+    
+    StopWatch Watch;
+    Watch.GetStepTime();
+    
+    for( int f = 0; f < Frames; f++ )
+    {
+        RestartStoppedChannels();
+        
+        for( int b = 0; b < BLOCKS_PER_FRAME; b++ )
+          SPU.FillNextSoundBuffer();
+    }
+    
+    return Watch.GetStepTime();
+}
+
+
+// =============================================================================
+//      MAIN FUNCTION
+// =============================================================================
+
+
+void ShowUsage()
+{
+    cout << "USAGE: MixerBenchmark [number of frames]" << endl;
+    cout << "Mixes the given frames (2000 by default) with all SPU channels" << endl;
+    cout << "playing. The SPU output is first checked against a per-sample" << endl;
+    cout << "reference mixer, and then the time of all mixers is compared" << endl;
+    cout << "Returns 2 if the SPU output differs from the reference" << endl;
+}
+
+// -----------------------------------------------------------------------------
+
+int main( int NumberOfArguments, char* Arguments[] )
+{
+    if( NumberOfArguments > 2 )
+    {
+        ShowUsage();
+        return 1;
+    }
+    
+    int Frames = 2000;
+    
+    if( NumberOfArguments == 2 )
+      Frames = atoi( Arguments[ 1 ] );
+      
+    if( Frames <= 0 )
+    {
+        ShowUsage();
+        return 1;
+    }
+    
+    try
+    {
+        // the SPU needs a sink to mix
+        SPU.Sink = &Sink;
+        SPU.InitializeAudio();
+        SPU.Reset();
+        CreateSounds();
+        
+        // timing means nothing unless the SPU mixes exactly
+        // like the reference, also when the mix clips
+        SetupChannels();
+        int DifferentBlocks = CheckSPUMixer( Frames );
+        SetupClippingChannels();
+        DifferentBlocks += CheckSPUMixer( Frames );
+        
+        if( DifferentBlocks )
+        {
+            cout << "ERROR: SPU output differs from the reference in " << DifferentBlocks << " blocks" << endl;
+            SPU.TerminateAudio();
+            return 2;
+        }
+        
+        cout << "SPU output matches the reference mixer" << endl;
+        
+        double OldTime = MeasureOldMixer( Frames );
+        double ReferenceTime = MeasureReferenceMixer( Frames );
+        double SPUTime = MeasureSPUMixer( Frames );
+        
+        // report times per frame of sound
+        cout << "Mixed frames: " << Frames << " (" << Constants::SPUSamplesPerFrame << " samples each, ";
+        cout << Constants::SPUSoundChannels << " channels playing)" << endl;
+        cout << "Old per-sample mixer: " << 1000000.0 * OldTime / Frames << " us per frame" << endl;
+        cout << "Reference per-sample mixer: " << 1000000.0 * ReferenceTime / Frames << " us per frame" << endl;
+        cout << "SPU mixer: " << 1000000.0 * SPUTime / Frames << " us per frame" << endl;
+        
+        if( SPUTime > 0 )
+        {
+            cout << "Speedup over old mixer: " << OldTime / SPUTime << "x" << endl;
+            cout << "Speedup over reference mixer: " << ReferenceTime / SPUTime << "x" << endl;
+        }
+          
+        // sounds in the arena are released with it
+        SPU.TerminateAudio();
+    }
+    
+    catch( const exception& e )
+    {
+        cout << "ERROR: " << e.what() << endl;
+        return 1;
+    }
+    
+    return 0;
+}